@@ -0,0 +1,349 @@
+// ycsb-style workload driver. it loads N records into one engine, runs a
+// ycsb core workload for a fixed duration and reports throughput, latency
+// percentiles and block transfers per operation.
+//
+// usage: cobtree-bench [--engine cobtree|cola|b+-tree|sorted-array|eytzinger]
+//   [--workload a|b|c|d|e|f] [--distribution uniform|zipfian|latest|sequential]
+//   [--records N] [--capacity N] [--duration seconds] [--cache bytes]
+//   [--seed N] [--scan-length N] [--hierarchy block:capacity,...]
+//   [--trace path] [--perf on|off]
+//
+// with --hierarchy every access is also simulated on a memory hierarchy
+// (e.g. 64:32768,64:1048576,4096:4294967296) and the run reports the
+// transfers per operation at each level. with --trace the accesses of the
+// run phase are recorded for trace-replay. with --perf on the hardware
+// counters (perf_event_open) are read around every operation and reported
+// next to the simulated transfers, and the cobtree probes are dumped.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "workload.h"
+
+using namespace cobtree;
+
+namespace {
+
+enum OpType { kRead = 0, kUpdate, kInsert, kScan, kReadModifyWrite,
+  kOpTypeCount };
+
+const char* const kOpNames[kOpTypeCount] = {"read", "update", "insert",
+  "scan", "read-modify-write"};
+
+// the proportion of each operation type, in OpType order.
+struct WorkloadMix {
+  double proportion[kOpTypeCount];
+};
+
+// ycsb core workloads a-f.
+const std::map<std::string, WorkloadMix> kWorkloads{
+  {"a", {{0.5, 0.5, 0, 0, 0}}},
+  {"b", {{0.95, 0.05, 0, 0, 0}}},
+  {"c", {{1, 0, 0, 0, 0}}},
+  {"d", {{0.95, 0, 0.05, 0, 0}}},
+  {"e", {{0, 0, 0.05, 0.95, 0}}},
+  {"f", {{0.5, 0, 0, 0, 0.5}}},
+};
+
+struct Options {
+  std::string engine = "b+-tree";
+  std::string workload = "a";
+  std::string distribution = "zipfian";
+  uint64_t records = 100000;
+  uint64_t capacity = 0; // 0 for twice the records
+  double duration = 10; // seconds
+  uint64_t cache = 1024*1024; // bytes
+  uint64_t seed = 1;
+  uint64_t scan_length = 100; // scans pick a length in [1, scan_length]
+  std::string hierarchy; // memory hierarchy levels, empty for none
+  std::string trace; // access trace file of the run, empty for none
+  bool perf = false; // measure hardware counters
+};
+
+// latencies and block transfers of one operation type.
+struct OpStats {
+  std::vector<uint64_t> latency_ns;
+  uint64_t block_transfer = 0;
+  uint64_t miss = 0; // reads of loaded records that found nothing
+  PerfCounts hardware; // summed counter deltas, with --perf on
+};
+
+void Usage(const char* program) {
+  std::cerr << "usage: " << program << " [--engine name] [--workload a-f]"
+    " [--distribution name] [--records N] [--capacity N]"
+    " [--duration seconds] [--cache bytes] [--seed N]"
+    " [--scan-length N] [--hierarchy block:capacity,...] [--trace path]"
+    " [--perf on|off]\n";
+}
+
+// return false on an unknown or incomplete flag.
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i += 2) {
+    std::string flag{argv[i]};
+    if (i + 1 >= argc) return false;
+    std::string value{argv[i + 1]};
+    if (flag == "--engine") {
+      options->engine = value;
+    } else if (flag == "--workload") {
+      options->workload = value;
+    } else if (flag == "--distribution") {
+      options->distribution = value;
+    } else if (flag == "--records") {
+      options->records = std::stoull(value);
+    } else if (flag == "--capacity") {
+      options->capacity = std::stoull(value);
+    } else if (flag == "--duration") {
+      options->duration = std::stod(value);
+    } else if (flag == "--cache") {
+      options->cache = std::stoull(value);
+    } else if (flag == "--seed") {
+      options->seed = std::stoull(value);
+    } else if (flag == "--scan-length") {
+      options->scan_length = std::stoull(value);
+    } else if (flag == "--hierarchy") {
+      options->hierarchy = value;
+    } else if (flag == "--trace") {
+      options->trace = value;
+    } else if (flag == "--perf") {
+      if ((value != "on") && (value != "off")) return false;
+      options->perf = (value == "on");
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t Percentile(const std::vector<uint64_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  auto rank = static_cast<uint64_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[rank];
+}
+
+void PrintLatency(const std::string& name, std::vector<uint64_t>* latency_ns,
+  uint64_t block_transfer) {
+  std::sort(latency_ns->begin(), latency_ns->end());
+  auto ops = latency_ns->size();
+  printf("%-18s %10lu ops  p50 %8.2f  p95 %8.2f  p99 %8.2f  p999 %8.2f us"
+    "  %8.2f transfers/op\n", name.c_str(), ops,
+    Percentile(*latency_ns, 0.5) / 1e3, Percentile(*latency_ns, 0.95) / 1e3,
+    Percentile(*latency_ns, 0.99) / 1e3, Percentile(*latency_ns, 0.999) / 1e3,
+    (ops > 0) ? (double) block_transfer / ops : 0.0);
+}
+
+// the measured counters per operation, to read next to the transfers.
+void PrintHardwareCounters(const std::string& name, const PerfCounts& counts,
+  uint64_t ops) {
+  printf("%-18s", name.c_str());
+  for (int event = 0; event < kPerfEventCount; event++) {
+    printf("  %10.2f %s/op", (ops > 0) ? (double) counts.value[event] / ops
+      : 0.0, PerfCounterGroup::EventName(PerfEvent(event)));
+  }
+  printf("\n");
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)
+    || (kWorkloads.find(options.workload) == kWorkloads.end())
+    || (options.records == 0) || (options.scan_length == 0)) {
+    Usage(argv[0]);
+    return 1;
+  }
+  const auto& mix = kWorkloads.at(options.workload);
+  // workload d reads the latest records whatever the distribution.
+  auto generator = CreateKeyGenerator((options.workload == "d")
+    ? std::string("latest") : options.distribution);
+  if (!generator) {
+    Usage(argv[0]);
+    return 1;
+  }
+  auto capacity = (options.capacity > 0) ? options.capacity
+    : 2 * options.records;
+
+  Cache cache{options.cache};
+  cache.set_block_size_for_stats(BLOCKSIZE);
+  std::unique_ptr<MemoryHierarchy> hierarchy;
+  if (!options.hierarchy.empty()) {
+    std::vector<MemoryLevelOption> levels;
+    if (!MemoryHierarchy::ParseLevels(options.hierarchy, &levels)) {
+      Usage(argv[0]);
+      return 1;
+    }
+    hierarchy.reset(new MemoryHierarchy(levels));
+    cache.set_memory_hierarchy(hierarchy.get());
+  }
+  auto engine = CreateEngine(options.engine, capacity, &cache);
+  if (!engine) {
+    Usage(argv[0]);
+    return 1;
+  }
+  std::mt19937_64 rng(options.seed);
+  using Clock = std::chrono::steady_clock;
+
+  // load phase. the records are inserted in a random order, except for the
+  // sequential distribution.
+  std::vector<uint64_t> load_order(options.records);
+  for (uint64_t i = 0; i < options.records; i++) load_order[i] = i;
+  if (options.distribution != "sequential") {
+    std::shuffle(load_order.begin(), load_order.end(), rng);
+  }
+  auto load_start = Clock::now();
+  for (auto record : load_order) {
+    if (!engine->Insert(RecordKey(record), record)) {
+      std::cerr << options.engine << " is full after loading "
+        << (&record - load_order.data()) << " records\n";
+      return 1;
+    }
+  }
+  double load_seconds = std::chrono::duration<double>(
+    Clock::now() - load_start).count();
+  printf("engine %s, %lu records, block size %d, cache %lu bytes\n",
+    options.engine.c_str(), options.records, BLOCKSIZE, options.cache);
+  printf("load: %.3f s, %.0f ops/s, %.2f transfers/op\n", load_seconds,
+    options.records / load_seconds,
+    (double) cache.recorded_block_transfer() / options.records);
+
+  // run phase.
+  OpStats stats[kOpTypeCount];
+  std::discrete_distribution<int> pick_op(mix.proportion,
+    mix.proportion + kOpTypeCount);
+  std::uniform_int_distribution<uint64_t> pick_scan_length(1,
+    options.scan_length);
+  uint64_t record_count = options.records;
+  bool full = false;
+  std::vector<L3Node> scanned;
+  cache.reset_block_transfer_stats();
+  if (hierarchy) hierarchy->ResetStats();
+  std::unique_ptr<AccessTraceWriter> trace;
+  if (!options.trace.empty()) {
+    trace.reset(new AccessTraceWriter(options.trace));
+    if (!trace->ok()) {
+      std::cerr << "cannot create trace " << options.trace << "\n";
+      return 1;
+    }
+    cache.set_access_trace(trace.get());
+  }
+  PerfProbeStats probes;
+  auto counters = PerfCounterGroup::ThisThread();
+  if (options.perf) {
+    if (!counters->ok()) {
+      std::cerr << "hardware counters unavailable, they read 0\n";
+    }
+    cache.set_perf_stats(&probes);
+  }
+  PerfCounts counts_before;
+  PerfCounts counts_after;
+  auto run_start = Clock::now();
+  auto run_end = run_start + std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(options.duration));
+  auto now = run_start;
+  while ((now < run_end) && !full) {
+    auto op = static_cast<OpType>(pick_op(rng));
+    auto key = RecordKey(generator->Next(&rng, record_count));
+    auto value = rng();
+    uint64_t found;
+    auto transfer_before = cache.recorded_block_transfer();
+    if (options.perf) counters->Read(&counts_before);
+    auto op_start = Clock::now();
+    switch (op) {
+      case kRead:
+        if (!engine->Get(key, &found)) stats[op].miss++;
+        break;
+      case kUpdate:
+        full = !engine->Insert(key, value);
+        break;
+      case kInsert:
+        full = !engine->Insert(RecordKey(record_count), value);
+        if (!full) record_count++;
+        break;
+      case kScan:
+        scanned.clear();
+        engine->Scan(key, key + pick_scan_length(rng) - 1, &scanned);
+        break;
+      case kReadModifyWrite:
+        if (!engine->Get(key, &found)) stats[op].miss++;
+        full = !engine->Insert(key, found ^ value);
+        break;
+      default:
+        assert(false);
+    }
+    now = Clock::now();
+    if (options.perf) {
+      counters->Read(&counts_after);
+      for (int event = 0; event < kPerfEventCount; event++) {
+        stats[op].hardware.value[event] += counts_after.value[event]
+          - counts_before.value[event];
+      }
+    }
+    stats[op].latency_ns.push_back(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now - op_start).count());
+    stats[op].block_transfer += cache.recorded_block_transfer()
+      - transfer_before;
+  }
+  double run_seconds = std::chrono::duration<double>(now - run_start).count();
+  cache.set_access_trace(nullptr);
+  cache.set_perf_stats(nullptr);
+  if (trace && !trace->Flush()) {
+    std::cerr << "cannot write trace " << options.trace << "\n";
+    return 1;
+  }
+  if (full) std::cerr << options.engine << " is full, run stopped early\n";
+
+  std::vector<uint64_t> all_latency_ns;
+  uint64_t all_block_transfer = 0;
+  uint64_t miss = 0;
+  PerfCounts all_hardware;
+  for (auto& op_stats : stats) {
+    for (int event = 0; event < kPerfEventCount; event++) {
+      all_hardware.value[event] += op_stats.hardware.value[event];
+    }
+    all_latency_ns.insert(all_latency_ns.end(), op_stats.latency_ns.begin(),
+      op_stats.latency_ns.end());
+    all_block_transfer += op_stats.block_transfer;
+    miss += op_stats.miss;
+  }
+  printf("run: workload %s, distribution %s, %.3f s, %.0f ops/s\n",
+    options.workload.c_str(), (options.workload == "d") ? "latest"
+    : options.distribution.c_str(), run_seconds,
+    all_latency_ns.size() / run_seconds);
+  for (int op = 0; op < kOpTypeCount; op++) {
+    if (stats[op].latency_ns.empty()) continue;
+    PrintLatency(kOpNames[op], &stats[op].latency_ns,
+      stats[op].block_transfer);
+  }
+  PrintLatency("overall", &all_latency_ns, all_block_transfer);
+  if (options.perf) {
+    for (int op = 0; op < kOpTypeCount; op++) {
+      if (stats[op].latency_ns.empty()) continue;
+      PrintHardwareCounters(kOpNames[op], stats[op].hardware,
+        stats[op].latency_ns.size());
+    }
+    PrintHardwareCounters("overall", all_hardware, all_latency_ns.size());
+    probes.Dump(&std::cout);
+  }
+  if (hierarchy) {
+    for (uint64_t level = 0; level < hierarchy->level_count(); level++) {
+      const auto& option = hierarchy->option(level);
+      printf("%s %luB/%luB: %.2f transfers/op\n", option.name.c_str(),
+        option.block_size, option.capacity,
+        (double) hierarchy->stats(level).transfer_count
+        / all_latency_ns.size());
+    }
+  }
+  if (miss > 0) {
+    std::cerr << miss << " reads did not find a loaded record\n";
+    return 1;
+  }
+  return 0;
+}
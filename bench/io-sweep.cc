@@ -0,0 +1,157 @@
+// i/o-complexity validation sweep. for every engine, record count N, block
+// size B and cache size M it loads N records in a random order and then
+// looks up loaded keys, and emits one csv row per operation with the
+// measured block transfers per operation next to the theoretical curve of
+// the engine (without constant factors). the ratio between the two should
+// stay flat along N; a slope change means the layout lost locality.
+//
+// usage: io-sweep [--engines cola,b+-tree,...] [--min-records N]
+//   [--max-records N] [--block-sizes 64,256,...] [--cache-sizes 32768,...]
+//   [--queries N] [--seed N]
+//
+// B is the block size the cache counts transfers with
+// (Cache::set_block_size_for_stats). every engine counts the blocks of B
+// holding the bytes it touches, and the B+-tree nodes take one block of B.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "workload.h"
+
+using namespace cobtree;
+
+namespace {
+
+struct Options {
+  std::vector<std::string> engines{"cola", "b+-tree", "sorted-array",
+    "eytzinger"};
+  uint64_t min_records = 1 << 10;
+  uint64_t max_records = 1 << 16;
+  std::vector<uint64_t> block_sizes{64, 256, 1024, 4096};
+  std::vector<uint64_t> cache_sizes{32*1024, 1024*1024};
+  uint64_t queries = 10000;
+  uint64_t seed = 1;
+};
+
+// return false on an unknown or incomplete flag.
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i += 2) {
+    std::string flag{argv[i]};
+    if (i + 1 >= argc) return false;
+    std::string value{argv[i + 1]};
+    if (flag == "--engines") {
+      options->engines = SplitList(value);
+    } else if (flag == "--min-records") {
+      options->min_records = std::stoull(value);
+    } else if (flag == "--max-records") {
+      options->max_records = std::stoull(value);
+    } else if (flag == "--block-sizes") {
+      options->block_sizes = SplitNumberList(value);
+    } else if (flag == "--cache-sizes") {
+      options->cache_sizes = SplitNumberList(value);
+    } else if (flag == "--queries") {
+      options->queries = std::stoull(value);
+    } else if (flag == "--seed") {
+      options->seed = std::stoull(value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the theoretical transfers of one operation on n records with b records
+// per block, up to a constant factor.
+double TheoreticalSearch(const std::string& engine, double n, double b) {
+  auto log_b = [](double x, double base) {
+    return std::max(1.0, std::log(x) / std::log(base)); };
+  if ((engine == "cobtree") || (engine == "b+-tree")) return log_b(n, b);
+  if (engine == "cola") return std::log2(n);
+  // binary searches only pay once the range is larger than a block.
+  return std::max(1.0, std::log2(n / b));
+}
+
+double TheoreticalInsert(const std::string& engine, double n, double b) {
+  if (engine == "cobtree") {
+    return TheoreticalSearch(engine, n, b) + std::log2(n) * std::log2(n) / b;
+  }
+  if (engine == "b+-tree") return TheoreticalSearch(engine, n, b);
+  if (engine == "cola") return std::log2(n) / b;
+  if (engine == "eytzinger") return n / (b * 256); // a rebuild per buffer
+  return n / b; // sorted-array shifts the tail
+}
+
+void PrintRow(const std::string& engine, const std::string& operation,
+  uint64_t records, uint64_t block_size, uint64_t cache_size, double measured,
+  double theory) {
+  printf("%s,%s,%lu,%lu,%lu,%.4f,%.4f,%.4f\n", engine.c_str(),
+    operation.c_str(), records, block_size, cache_size, measured, theory,
+    measured / theory);
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options) || (options.min_records == 0)
+    || (options.min_records > options.max_records)) {
+    std::cerr << "usage: " << argv[0] << " [--engines a,b] [--min-records N]"
+      " [--max-records N] [--block-sizes a,b] [--cache-sizes a,b]"
+      " [--queries N] [--seed N]\n";
+    return 1;
+  }
+
+  printf("engine,operation,records,block_size,cache_size,"
+    "transfers_per_op,theory,ratio\n");
+  for (const auto& name : options.engines) {
+    for (auto records = options.min_records; records <= options.max_records;
+      records *= 2) {
+      for (auto cache_size : options.cache_sizes) {
+        for (auto block_size : options.block_sizes) {
+          Cache cache{cache_size};
+          cache.set_block_size_for_stats(block_size);
+          auto engine = CreateEngine(name, records, &cache);
+          if (!engine) {
+            std::cerr << "unknown engine " << name << "\n";
+            return 1;
+          }
+          // the same keys in the same order for every configuration.
+          std::mt19937_64 rng(options.seed);
+          std::vector<uint64_t> order(records);
+          for (uint64_t i = 0; i < records; i++) order[i] = i;
+          std::shuffle(order.begin(), order.end(), rng);
+
+          for (auto record : order) {
+            if (!engine->Insert(RecordKey(record), record)) {
+              std::cerr << name << " is full at " << records << " records\n";
+              return 1;
+            }
+          }
+          double per_block = (double) block_size / sizeof(L3Node);
+          PrintRow(name, "insert", records, block_size, cache_size,
+            (double) cache.recorded_block_transfer() / records,
+            TheoreticalInsert(name, records, per_block));
+
+          cache.reset_block_transfer_stats();
+          UniformGenerator generator;
+          for (uint64_t i = 0; i < options.queries; i++) {
+            auto record = generator.Next(&rng, records);
+            uint64_t value;
+            auto found = engine->Get(RecordKey(record), &value);
+            assert(found && (value == record));
+            (void) found;
+          }
+          PrintRow(name, "search", records, block_size, cache_size,
+            (double) cache.recorded_block_transfer() / options.queries,
+            TheoreticalSearch(name, records, per_block));
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+// offline replay of an access trace (recorded with cobtree-bench --trace
+// or Cache::set_access_trace). for every cache size M and block size B it
+// emits one csv row per replacement policy with the blocks read in and the
+// dirty blocks written back, so the FIFO of Cache can be compared against
+// LRU and the optimal policy without re-running the workload.
+//
+// usage: trace-replay <trace> [--cache-sizes 32768,...]
+//   [--block-sizes 64,4096,...]
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "access_trace.h"
+#include "workload.h"
+
+using namespace cobtree;
+
+int main(int argc, char** argv) {
+  std::vector<uint64_t> cache_sizes{32*1024, 1024*1024};
+  std::vector<uint64_t> block_sizes{64, 4096};
+  bool usage_error = (argc < 2) || (argc % 2 != 0);
+  for (int i = 2; !usage_error && (i + 1 < argc); i += 2) {
+    std::string flag{argv[i]};
+    if (flag == "--cache-sizes") {
+      cache_sizes = SplitNumberList(argv[i + 1]);
+    } else if (flag == "--block-sizes") {
+      block_sizes = SplitNumberList(argv[i + 1]);
+    } else {
+      usage_error = true;
+    }
+  }
+  if (usage_error) {
+    std::cerr << "usage: " << argv[0] << " <trace> [--cache-sizes a,b]"
+      " [--block-sizes a,b]\n";
+    return 1;
+  }
+
+  std::vector<std::string> devices;
+  std::vector<AccessTraceRecord> records;
+  if (!ReadAccessTrace(argv[1], &devices, &records)) {
+    std::cerr << "cannot read trace " << argv[1] << "\n";
+    return 1;
+  }
+  std::cerr << records.size() << " accesses on " << devices.size()
+    << " devices\n";
+
+  const char* const policy_names[] = {"fifo", "lru", "belady"};
+  printf("policy,cache_size,block_size,block_accesses,misses,writebacks\n");
+  for (auto cache_size : cache_sizes) {
+    for (auto block_size : block_sizes) {
+      if ((block_size == 0) || (cache_size < block_size)) continue;
+      for (auto policy : {kReplaceFIFO, kReplaceLRU, kReplaceBelady}) {
+        auto result = ReplayAccessTrace(records, policy, cache_size,
+          block_size);
+        printf("%s,%lu,%lu,%lu,%lu,%lu\n", policy_names[policy], cache_size,
+          block_size, result.access_count, result.miss_count,
+          result.writeback_count);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,183 @@
+#ifndef COBTREE_BENCH_WORKLOAD_H_
+#define COBTREE_BENCH_WORKLOAD_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "baseline.h"
+#include "cobtree.h"
+#include "cola.h"
+#include "engine.h"
+
+// key generators, engine construction and flag parsing shared by the
+// benchmarks.
+// records are numbered 0..count-1 and record i has key i+1 (key 0 is the
+// dummy record of CoBtree).
+
+namespace cobtree {
+
+inline uint64_t RecordKey(uint64_t record) { return record + 1; }
+
+// 64-bit fnv-1a of the record number, to spread popular records over the
+// key space like ycsb does.
+inline uint64_t ScrambleRecord(uint64_t record) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= (record >> (i * 8)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// picks a record among the count records inserted so far.
+class KeyGenerator {
+ public:
+  virtual ~KeyGenerator() = default;
+  virtual uint64_t Next(std::mt19937_64* rng, uint64_t count) = 0;
+};
+
+class UniformGenerator : public KeyGenerator {
+ public:
+  uint64_t Next(std::mt19937_64* rng, uint64_t count) override {
+    return std::uniform_int_distribution<uint64_t>(0, count - 1)(*rng);
+  }
+};
+
+// walks the records in order and wraps around.
+class SequentialGenerator : public KeyGenerator {
+ public:
+  SequentialGenerator() : next_(0) {}
+  uint64_t Next(std::mt19937_64*, uint64_t count) override {
+    if (next_ >= count) next_ = 0;
+    return next_++;
+  }
+
+ private:
+  uint64_t next_;
+};
+
+/**
+ * @brief zipfian ranks (Gray et al., "Quickly generating billion-record
+ *  synthetic databases"), as in ycsb. rank 0 is the most popular. zeta(n)
+ *  is extended incrementally when the record count grows, so a growing
+ *  count costs one term per new record.
+ */
+class ZipfianRank {
+ public:
+  explicit ZipfianRank(double theta = 0.99)
+    : theta_(theta), zeta2_(1 + std::pow(0.5, theta)),
+    alpha_(1 / (1 - theta)), count_(0), zetan_(0) {}
+
+  uint64_t Next(std::mt19937_64* rng, uint64_t count) {
+    assert(count > 0);
+    while (count_ < count) zetan_ += 1 / std::pow(++count_, theta_);
+    // shrinking counts are not expected, recompute if it happens.
+    if (count_ > count) {
+      count_ = 0;
+      zetan_ = 0;
+      while (count_ < count) zetan_ += 1 / std::pow(++count_, theta_);
+    }
+    auto eta = (1 - std::pow(2.0 / count, 1 - theta_))
+      / (1 - zeta2_ / zetan_);
+    auto u = std::uniform_real_distribution<double>(0, 1)(*rng);
+    auto uz = u * zetan_;
+    if (uz < 1) return 0;
+    if (uz < zeta2_) return std::min<uint64_t>(1, count - 1);
+    auto rank = static_cast<uint64_t>(count
+      * std::pow(eta * u - eta + 1, alpha_));
+    return std::min(rank, count - 1);
+  }
+
+ private:
+  const double theta_;
+  const double zeta2_;
+  const double alpha_;
+  uint64_t count_; // the count zetan_ is computed for
+  double zetan_;
+};
+
+// popular records are scattered over the key space.
+class ZipfianGenerator : public KeyGenerator {
+ public:
+  uint64_t Next(std::mt19937_64* rng, uint64_t count) override {
+    return ScrambleRecord(rank_.Next(rng, count)) % count;
+  }
+
+ private:
+  ZipfianRank rank_;
+};
+
+// the most recently inserted records are the most popular.
+class LatestGenerator : public KeyGenerator {
+ public:
+  uint64_t Next(std::mt19937_64* rng, uint64_t count) override {
+    return count - 1 - rank_.Next(rng, count);
+  }
+
+ private:
+  ZipfianRank rank_;
+};
+
+// return nullptr for an unknown distribution.
+inline std::unique_ptr<KeyGenerator> CreateKeyGenerator(
+  const std::string& distribution) {
+  std::unique_ptr<KeyGenerator> generator;
+  if (distribution == "uniform") {
+    generator.reset(new UniformGenerator());
+  } else if (distribution == "zipfian") {
+    generator.reset(new ZipfianGenerator());
+  } else if (distribution == "latest") {
+    generator.reset(new LatestGenerator());
+  } else if (distribution == "sequential") {
+    generator.reset(new SequentialGenerator());
+  }
+  return generator;
+}
+
+// the non-empty items of a comma-separated list.
+inline std::vector<std::string> SplitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream{list};
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) items.push_back(item);
+  }
+  return items;
+}
+
+inline std::vector<uint64_t> SplitNumberList(const std::string& list) {
+  std::vector<uint64_t> numbers;
+  for (const auto& item : SplitList(list)) numbers.push_back(std::stoull(item));
+  return numbers;
+}
+
+// return nullptr for an unknown engine. capacity is the number of records
+// the engine is sized for.
+inline std::unique_ptr<Engine> CreateEngine(const std::string& name,
+  uint64_t capacity, Cache* cache) {
+  std::unique_ptr<Engine> engine;
+  if (name == "cobtree") {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    // the level 1 vEB tree needs more than ten leaves per segment.
+    engine.reset(new CoBtree(4, std::max<uint64_t>(capacity, 1024*1024),
+      1.2, 1.2, 1.2, name, density, density, density, cache));
+  } else if (name == "cola") {
+    engine.reset(new Cola(name, capacity, cache));
+  } else if (name == "b+-tree") {
+    engine.reset(new BPlusTree(name, capacity, cache));
+  } else if (name == "sorted-array") {
+    engine.reset(new SortedArray(name, capacity, cache));
+  } else if (name == "eytzinger") {
+    engine.reset(new EytzingerArray(name, capacity, 256, cache));
+  }
+  return engine;
+}
+
+}  // namespace cobtree
+#endif  // COBTREE_BENCH_WORKLOAD_H_
@@ -0,0 +1,85 @@
+#ifndef COBTREE_ACCESS_TRACE_H_
+#define COBTREE_ACCESS_TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cobtree {
+
+// one access of a device (a PMA level, a baseline engine, the value log).
+// the segment is the PMA segment holding offset, for other devices the
+// BLOCKSIZE block.
+struct AccessTraceRecord {
+  uint32_t device; // index into the device names of the trace
+  bool write;
+  uint64_t segment_id;
+  uint64_t offset; // bytes from the start of the device
+  uint64_t len;
+};
+
+/**
+ * @brief appends accesses to a compact binary trace file. the file is the
+ *  magic followed by LEB128 varints: a tag (device << 2 | kind), then for
+ *  an access (kind 0 read, 1 write) the segment id, offset and length,
+ *  and for a device definition (kind 2, written before its first access)
+ *  the name length and the name bytes. records are buffered and written
+ *  in large chunks, the file is complete once the writer is closed.
+ */
+class AccessTraceWriter {
+ public:
+  AccessTraceWriter() = delete;
+  explicit AccessTraceWriter(const std::string& path);
+  ~AccessTraceWriter();
+
+  AccessTraceWriter(const AccessTraceWriter&) = delete;
+  AccessTraceWriter& operator=(const AccessTraceWriter&) = delete;
+
+  inline bool ok() const { return fd_ >= 0; }
+
+  // a no-op if the file could not be opened.
+  void Record(const std::string& device, bool write, uint64_t segment_id,
+    uint64_t offset, uint64_t len);
+
+  // write out the buffered records. return false on io error.
+  bool Flush();
+
+  inline uint64_t record_count() const { return record_count_; }
+
+ private:
+  void PutVarint(uint64_t value);
+
+  int fd_;
+  std::string buffer_;
+  std::unordered_map<std::string, uint32_t> devices_;
+  uint64_t record_count_;
+};
+
+// read a whole trace file. return false if it cannot be read or is not a
+// trace. a truncated last record is ignored.
+bool ReadAccessTrace(const std::string& path,
+  std::vector<std::string>* devices, std::vector<AccessTraceRecord>* records);
+
+enum ReplacementPolicy {
+  kReplaceFIFO = 0,
+  kReplaceLRU = 1,
+  kReplaceBelady = 2, // evict the block used the furthest in the future
+};
+
+struct ReplayResult {
+  uint64_t access_count; // blocks accessed
+  uint64_t miss_count; // blocks read in
+  uint64_t writeback_count; // dirty blocks written back on eviction
+};
+
+/**
+ * @brief replay a trace on a cache of cache_size bytes made of blocks of
+ *  block_size bytes. belady's policy is optimal for the misses (OPT); the
+ *  write backs it causes are counted but not minimized.
+ */
+ReplayResult ReplayAccessTrace(const std::vector<AccessTraceRecord>& records,
+  ReplacementPolicy policy, uint64_t cache_size, uint64_t block_size);
+
+}  // namespace cobtree
+#endif  // COBTREE_ACCESS_TRACE_H_
@@ -0,0 +1,120 @@
+#ifndef COBTREE_ASYNC_GET_H_
+#define COBTREE_ASYNC_GET_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cobtree.h"
+
+namespace cobtree {
+
+// a device completing reads asynchronously. a read is identified by the
+// token it was submitted with.
+class AsyncReadDevice {
+ public:
+  virtual ~AsyncReadDevice() = default;
+
+  virtual void Submit(uint64_t token) = 0;
+
+  // block until a submitted read completes and return its token.
+  virtual uint64_t WaitCompletion() = 0;
+};
+
+/**
+ * @brief stand-in for a disk: worker threads complete each read after a
+ *  fixed latency. the data itself lives in memory, only the wait is
+ *  simulated.
+ */
+class ThreadPoolReadDevice : public AsyncReadDevice {
+ public:
+  ThreadPoolReadDevice() = delete;
+  ThreadPoolReadDevice(uint64_t thread_count, uint64_t latency_us);
+  ~ThreadPoolReadDevice();
+
+  ThreadPoolReadDevice(const ThreadPoolReadDevice&) = delete;
+  ThreadPoolReadDevice& operator=(const ThreadPoolReadDevice&) = delete;
+
+  void Submit(uint64_t token) override;
+  uint64_t WaitCompletion() override;
+
+ private:
+  void Work();
+
+  const uint64_t latency_us_;
+  std::mutex mu_;
+  std::condition_variable request_cv_;
+  std::condition_variable completion_cv_;
+  std::deque<uint64_t> requests_;
+  std::deque<uint64_t> completions_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+};
+
+enum AsyncGetStage {
+  kAsyncGetStart = 0,
+  kAsyncGetL1, // descending the vEB tree
+  kAsyncGetL2,
+  kAsyncGetL3,
+  kAsyncGetDone,
+};
+
+// the progress of one lookup, advanced by CoBtree::AdvanceAsyncGet.
+struct AsyncGetState {
+  uint64_t key;
+  AsyncGetStage stage;
+  uint64_t address; // the next vEB node
+  uint64_t segment_id; // the next l2 or l3 segment
+  uint64_t sequence; // the tree write sequence the lookup started at
+  bool read_done; // the block waited for was read, load it
+  bool found;
+  uint64_t value;
+};
+
+typedef std::function<void(uint64_t key, bool found, uint64_t value)>
+  AsyncGetCallback;
+
+/**
+ * @brief runs many Get on one thread. a lookup runs until the next node or
+ *  segment it needs is not in the Cache, then it is suspended while the
+ *  read is on the device and the other lookups proceed; it resumes when
+ *  the read completes. a lookup overtaken by an insert restarts from the
+ *  root. the tree stays usable from other threads.
+ */
+class AsyncGetScheduler {
+ public:
+  AsyncGetScheduler() = delete;
+  AsyncGetScheduler(CoBtree* tree, AsyncReadDevice* device)
+    : tree_(tree), device_(device), suspend_count_(0), restart_count_(0),
+    max_in_flight_(0) {}
+
+  AsyncGetScheduler(const AsyncGetScheduler&) = delete;
+  AsyncGetScheduler& operator=(const AsyncGetScheduler&) = delete;
+
+  // queue a lookup. the callback runs on the thread calling Run.
+  void Submit(uint64_t key, AsyncGetCallback callback);
+
+  // run until every submitted lookup has completed.
+  void Run();
+
+  inline uint64_t suspend_count() const { return suspend_count_; }
+  inline uint64_t restart_count() const { return restart_count_; }
+  // the most reads outstanding at once.
+  inline uint64_t max_in_flight() const { return max_in_flight_; }
+
+ private:
+  CoBtree* tree_;
+  AsyncReadDevice* device_;
+  std::vector<AsyncGetState> lookups_;
+  std::vector<AsyncGetCallback> callbacks_;
+  std::deque<uint64_t> ready_; // lookups that can advance
+  uint64_t suspend_count_;
+  uint64_t restart_count_;
+  uint64_t max_in_flight_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_ASYNC_GET_H_
@@ -0,0 +1,148 @@
+#ifndef COBTREE_BASELINE_H_
+#define COBTREE_BASELINE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "block_device.h"
+#include "cache.h"
+#include "engine.h"
+
+// standard-layout engines measured on the same BlockDevice/Cache
+// simulation as CoBtree. they know the block size, which CoBtree does not.
+// like the PMA, they count the transfers of the blocks (of the cache stats
+// block size) holding the bytes they touch.
+
+namespace cobtree {
+
+struct BPlusTreeNodeHeader {
+  uint64_t leaf; // 1 for a leaf node
+  uint64_t count; // number of entries
+  uint64_t next; // the next leaf in key order, UINT64_MAX if none
+};
+
+// after the header a node is an array of {key, value} pairs in key order.
+// in an internal node the value is the child node id and the key is the
+// smallest key routed to the child (the first child also takes the keys
+// smaller than every separator).
+class BPlusTree : public Engine {
+ public:
+  BPlusTree() = delete;
+  // each node takes exactly one block of the cache stats block size (at
+  // least 4 entries).
+  BPlusTree(const std::string& id, uint64_t estimated_record_count,
+    Cache* cache);
+  ~BPlusTree() = default;
+
+  bool Get(uint64_t key, uint64_t* value) override;
+  bool Insert(uint64_t key, uint64_t value) override;
+  uint64_t Scan(uint64_t start_key, uint64_t end_key,
+    std::vector<L3Node>* records) override;
+
+  inline uint64_t node_capacity() const { return node_capacity_; }
+  inline uint64_t node_count() const { return node_count_; }
+  inline uint64_t height() const { return height_; }
+
+ private:
+  // fetch a node through the cache.
+  char* LoadNode(uint64_t node_id) const;
+
+  inline static BPlusTreeNodeHeader* header(char* node) {
+    return reinterpret_cast<BPlusTreeNodeHeader*>(node);
+  }
+  inline static L3Node* entries(char* node) {
+    return reinterpret_cast<L3Node*>(node + sizeof(BPlusTreeNodeHeader));
+  }
+
+  // descend to the leaf key is routed to. the visited internal nodes are
+  // appended to path if given.
+  uint64_t FindLeaf(uint64_t key, std::vector<uint64_t>* path) const;
+
+  const std::string id_;
+  Cache* cache_;
+  const uint64_t node_size_; // the block size
+  const uint64_t node_capacity_; // entries per node
+  const uint64_t max_node_count_;
+  std::unique_ptr<BlockDevice> storage_;
+  uint64_t node_count_;
+  uint64_t root_;
+  uint64_t height_;
+};
+
+// records in key order in one array. search is a binary search, an
+// insertion shifts every record after it.
+class SortedArray : public Engine {
+ public:
+  SortedArray() = delete;
+  SortedArray(const std::string& id, uint64_t estimated_record_count,
+    Cache* cache);
+  ~SortedArray() = default;
+
+  bool Get(uint64_t key, uint64_t* value) override;
+  bool Insert(uint64_t key, uint64_t value) override;
+  uint64_t Scan(uint64_t start_key, uint64_t end_key,
+    std::vector<L3Node>* records) override;
+
+  inline uint64_t size() const { return size_; }
+
+ private:
+  // fetch count records from pos through the cache.
+  L3Node* Load(uint64_t pos, uint64_t count) const;
+
+  // the position of the first record with a key not smaller than key.
+  uint64_t LowerBound(uint64_t key) const;
+
+  const std::string id_;
+  Cache* cache_;
+  const uint64_t capacity_; // in records
+  std::unique_ptr<BlockDevice> storage_;
+  uint64_t size_;
+};
+
+/**
+ * @brief static search tree in Eytzinger (breadth-first) order: the
+ *  children of position i are 2i and 2i+1 (1-based), so the top levels of
+ *  every search share the first blocks. the layout cannot be updated in
+ *  place: insertions are buffered in memory and merged by rebuilding the
+ *  array once the buffer is full. the buffer is not on the device, but the
+ *  rebuilds are.
+ */
+class EytzingerArray : public Engine {
+ public:
+  EytzingerArray() = delete;
+  EytzingerArray(const std::string& id, uint64_t estimated_record_count,
+    uint64_t buffer_capacity, Cache* cache);
+  ~EytzingerArray() = default;
+
+  bool Get(uint64_t key, uint64_t* value) override;
+  bool Insert(uint64_t key, uint64_t value) override;
+  uint64_t Scan(uint64_t start_key, uint64_t end_key,
+    std::vector<L3Node>* records) override;
+
+  // merge the buffer into the array.
+  // return false if the array is full.
+  bool Rebuild();
+
+  inline uint64_t size() const { return size_; }
+
+ private:
+  // fetch count records from (1-based) position pos through the cache.
+  L3Node* Load(uint64_t pos, uint64_t count) const;
+
+  // the position following pos in key order, 0 after the last one.
+  uint64_t Successor(uint64_t pos) const;
+
+  const std::string id_;
+  Cache* cache_;
+  const uint64_t capacity_; // in records
+  const uint64_t buffer_capacity_;
+  std::unique_ptr<BlockDevice> storage_;
+  uint64_t size_; // records in the array
+  std::map<uint64_t, uint64_t> buffer_; // records not yet in the array
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_BASELINE_H_
@@ -16,12 +16,18 @@ class BlockDevice {
   BlockDevice(uint64_t size) 
     : block_size_(BLOCKSIZE),
     buffer_size_(AdjustForBlockSize(BLOCKSIZE, size)),
-    buffer_(new char[buffer_size_]) {}
+    buffer_(new char[buffer_size_]), data_(buffer_.get()) {}
 
   BlockDevice(uint64_t block_size, uint64_t size) 
     : block_size_(block_size),
     buffer_size_(AdjustForBlockSize(block_size, size)),
-    buffer_(new char[buffer_size_]) {}
+    buffer_(new char[buffer_size_]), data_(buffer_.get()) {}
+
+  // place the device on external memory not owned by the device 
+  // (e.g. a mapped checkpoint file).
+  BlockDevice(uint64_t block_size, char* buffer, uint64_t size) 
+    : block_size_(block_size), buffer_size_(size), buffer_(), 
+    data_(buffer) {}
 
   ~BlockDevice() = default;
   
@@ -41,7 +47,28 @@ class BlockDevice {
   const uint64_t block_size_;
   // std::set<uint64_t> in_memory_;
   const uint64_t buffer_size_;
-  std::unique_ptr<char[]> buffer_;
+  std::unique_ptr<char[]> buffer_; // empty on external memory
+  char* data_;
+};
+
+// a private read-write mapping of a whole file. pages are faulted in on 
+// first access and modifications are never written back to the file.
+class MappedFile {
+ public:
+  MappedFile() = delete;
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  inline bool ok() const { return data_ != nullptr; }
+  inline char* data() const { return data_; }
+  inline uint64_t size() const { return size_; }
+
+ private:
+  char* data_;
+  uint64_t size_;
 };
 
 }  // namespace cobtree
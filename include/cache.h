@@ -7,7 +7,13 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include "access_trace.h"
+#include "event_trace.h"
+#include "memory_hierarchy.h"
+#include "perf_counters.h"
 
 namespace cobtree {
 
@@ -32,25 +38,48 @@ class CacheBlock {
 class Cache {
  public:
   Cache() = delete;
-  Cache(uint64_t size) : size_(size), usage_(0), 
-    block_transfer_count_(0) {}
+  Cache(uint64_t size) : size_(size), pinned_capacity_(0), usage_(0), 
+    block_transfer_count_(0), hierarchy_(nullptr), trace_(nullptr),
+    tracer_(nullptr), tracer_generation_(0), perf_stats_(nullptr) {}
   ~Cache() = default;
 
   void Add(const std::string& id, char* src, uint64_t len);
 
   inline bool Exist(const std::string& id) const { 
-    return contents_.find(id) != contents_.end(); 
+    return (contents_.find(id) != contents_.end()) 
+      || (!pinned_.empty() && (pinned_.find(id) != pinned_.end()));
   }
   
   char* Get(const std::string& id) { 
-    return (Exist(id)) ? contents_[id].data() : nullptr;
+    auto it = contents_.find(id);
+    return (it != contents_.end()) ? it->second.data() : nullptr;
   }
 
+  // set aside bytes of the cache for pinned blocks (see PinBlock), the 
+  // FIFO gets the rest. the blocks the FIFO holds beyond its new size are
+  // evicted. the pinned blocks are released.
+  void ReservePinned(uint64_t bytes);
+  inline uint64_t pinned_capacity() const { return pinned_capacity_; }
+  inline uint64_t pinned_block_count() const { return pinned_.size(); }
+
+  // keep the block (of the stats block size) of a device resident until 
+  // it is unpinned. it is counted as a transfer if it is not in the cache
+  // yet, and taken out of the FIFO if it is. return false if the reserved
+  // space is full.
+  bool PinBlock(const std::string& device, uint64_t block_id);
+
+  // release a pinned block, or all the pinned blocks of a device. they are
+  // counted as evicted.
+  void UnpinBlock(const std::string& device, uint64_t block_id);
+  void UnpinDevice(const std::string& device);
+
   // inform cache the block size to count number of transfer
   // the content added to cache can be multiple block size
   inline void set_block_size_for_stats(uint64_t block_size) {
     block_transfer_size_=block_size;
   } 
+  inline uint64_t block_size_for_stats() const { 
+    return block_transfer_size_; }
 
   // output the counted block transfer
   inline uint64_t recorded_block_transfer() const { return block_transfer_count_; }
@@ -58,13 +87,83 @@ class Cache {
   // reset the counted block transfer to 0
   inline void reset_block_transfer_stats() { block_transfer_count_ = 0; }
 
+  // also simulate every access on a memory hierarchy (nullptr to stop).
+  // the hierarchy is not owned.
+  inline void set_memory_hierarchy(MemoryHierarchy* hierarchy) {
+    hierarchy_ = hierarchy;
+  }
+  inline MemoryHierarchy* memory_hierarchy() const { return hierarchy_; }
+
+  // count the transfers of the blocks (of the stats block size) holding
+  // [offset, offset+len) of a device that are not in the cache yet, and
+  // keep them in the cache. the cache holds no content for them.
+  void AccessRange(const std::string& device, uint64_t offset, uint64_t len);
+
+  // if all the blocks holding [offset, offset+len) of a device are in the
+  // cache. nothing is accounted for.
+  bool Resident(const std::string& device, uint64_t offset, 
+    uint64_t len) const;
+
+  static std::string CreateRangeCacheKey(const std::string& device,
+    uint64_t block_id) {
+    return device + "@" + std::to_string(block_id);
+  }
+
+  // also record every access to a trace (nullptr to stop). the trace is
+  // not owned.
+  inline void set_access_trace(AccessTraceWriter* trace) { trace_ = trace; }
+  inline AccessTraceWriter* access_trace() const { return trace_; }
+
+  // record rebalance, split and eviction events of the structures using
+  // this cache (nullptr to stop). the tracer is not owned.
+  inline void set_event_tracer(EventTracer* tracer) {
+    tracer_ = tracer;
+    tracer_generation_++;
+    trace_devices_.clear();
+  }
+  inline EventTracer* event_tracer() const { return tracer_; }
+  // changes with the tracer, the device ids interned before are stale.
+  inline uint64_t event_tracer_generation() const {
+    return tracer_generation_; }
+
+  // the id of a device on the attached tracer, interned on first use.
+  uint32_t TraceDevice(const std::string& device);
+
+  // bracket the operations of the structures using this cache with the
+  // hardware counters of the calling thread (nullptr to stop). the stats
+  // are not owned.
+  inline void set_perf_stats(PerfProbeStats* stats) { perf_stats_ = stats; }
+  inline PerfProbeStats* perf_stats() const { return perf_stats_; }
+
+  // report an access of len bytes at offset of a device, in the given
+  // segment (a PMA segment or a device block), whether or not it hits the
+  // cache. a write follows the read of the same bytes, so only reads are
+  // simulated on the memory hierarchy.
+  inline void RecordAccess(const std::string& device, uint64_t segment_id,
+    uint64_t offset, uint64_t len, bool write) {
+    if (hierarchy_ && !write) hierarchy_->Access(device, offset, len);
+    if (trace_) trace_->Record(device, write, segment_id, offset, len);
+  }
+
  private:
+  // evict from the FIFO until len more bytes fit.
+  void EvictFor(uint64_t len);
+
   const uint64_t size_; // M bytes
+  uint64_t pinned_capacity_; // bytes of size_ reserved for pinned blocks
+  std::set<std::string> pinned_; // cache keys of the pinned blocks
   uint64_t usage_; // bytes used
   std::map <std::string, CacheBlock> contents_;
   std::list<std::string> fifo_list_; // can be extended to other replacement policy
   uint64_t block_transfer_size_; // block size for us to count block transfer
   uint64_t block_transfer_count_; // +1 when a block sized content added to/evicted from cache
+  MemoryHierarchy* hierarchy_;
+  AccessTraceWriter* trace_;
+  EventTracer* tracer_;
+  uint64_t tracer_generation_; // see event_tracer_generation
+  // device ids of the blocks evicted under the tracer.
+  std::unordered_map<std::string, uint32_t> trace_devices_;
+  PerfProbeStats* perf_stats_;
 };
 
 }  // namespace cobtree
@@ -1,17 +1,56 @@
 #ifndef COBTREE_COBTREE_H_
 #define COBTREE_COBTREE_H_
 
+#include <map>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "cache.h"
+#include "engine.h"
+#include "latency_stats.h"
+#include "learned_index.h"
 #include "type.h"
 #include "vebtree.h"
 #include "pma.h"
+#include "value_log.h"
+#include "wal.h"
 
 namespace cobtree {
 
-class CoBtree {
+struct SnapshotHeader;
+struct AsyncGetState;
+class AsyncGetScheduler;
+class CoBtree;
+
+// a consistent view of the records at the time it was created, for long 
+// scans running alongside writers. writers are not blocked: a level 3 
+// segment they modify is copied first while a snapshot still sees it. the
+// view is released when the handle is destroyed, which must happen before
+// the tree is destroyed.
+class ReadSnapshot {
+ public:
+  ReadSnapshot() = delete;
+  ~ReadSnapshot();
+
+  ReadSnapshot(const ReadSnapshot&) = delete;
+  ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+
+  inline uint64_t epoch() const { return epoch_; }
+
+ private:
+  friend class CoBtree;
+  ReadSnapshot(CoBtree* tree, uint64_t epoch, uint64_t last_segment)
+    : tree_(tree), epoch_(epoch), last_segment_(last_segment) {}
+
+  CoBtree* tree_;
+  const uint64_t epoch_;
+  const uint64_t last_segment_; // the last non-empty level 3 segment
+  std::vector<L3Node> buffered_; // the insert buffer in key order
+};
+
+class CoBtree : public Engine {
  public:
   CoBtree() = delete;
 
@@ -24,12 +63,17 @@ class CoBtree {
       item_count_l2(std::ceil(record_count_l3 / std::log2(record_count_l3))
         * pma_redundancy_factor_l2),
       leaf_count_l1(std::ceil(item_count_l2 / std::log2(item_count_l2))),
+      snapshot_(),
       tree_(veb_fanout, leaf_count_l1, pma_redundancy_factor_l1, 
         CreateUid(), pma_density_l1, cache_),
       pma_index_(CreateUid(), sizeof(L2Node), item_count_l2, 
         pma_density_l2, cache_),
       pma_data_(CreateUid(), sizeof(L3Node), record_count_l3,
-        pma_density_l3, cache_) {
+        pma_density_l3, cache_), value_log_gc_batch_(0), wal_(nullptr),
+      checkpoint_interval_(0), record_since_checkpoint_(0),
+      checkpoint_slot_(1), checkpoint_sequence_(0),
+      checkpoint_version_{{0, 0, 0}, {0, 0, 0}}, 
+      checkpoint_full_{false, false}, recovery_lsn_(0) {
     // add some dummy node to intialize the structure
     L3Node record{0,0};
     PMAUpdateContext ctx;
@@ -52,16 +96,202 @@ class CoBtree {
   ~CoBtree() = default;
 
   // return if the value is found. if found, value store in value.
-  bool Get(uint64_t key, uint64_t* value);
+  bool Get(uint64_t key, uint64_t* value) override;
+
+  // look up the keys in groups, each level of the three advanced for the
+  // whole group with the next node or segment prefetched (see
+  // vEBTree::GetBatch).
+  uint64_t GetBatch(const uint64_t* keys, uint64_t count, uint64_t* values,
+    bool* found) override;
 
   // return false if insertion failed due to any level pma full.
-  bool Insert(uint64_t key, uint64_t value);
+  bool Insert(uint64_t key, uint64_t value) override;
+
+  /**
+   * @brief buffer insertions in memory and merge them into level 3 in 
+   *  sorted batches once capacity records are buffered. all the records 
+   *  routed to a segment are merged with one descent and one rebalance.
+   *  Get and Scan see the buffered records.
+   * 
+   * @param capacity the number of buffered records triggering a flush. 
+   *  0 disables the buffer after flushing it.
+   */
+  void EnableInsertBuffer(uint64_t capacity);
+
+  /**
+   * @brief reserve bytes of the cache to keep the top levels of the vEB 
+   *  tree resident (see vEBTree::PinTop). the root and the levels below it
+   *  are visited by every operation; in the FIFO they are evicted by cold
+   *  level 3 segments and transferred again and again. a few blocks are 
+   *  enough: a sixteenth of the cache is plenty.
+   * 
+   * @param bytes the pinned space, 0 to stop pinning
+   */
+  void PinVEBTreeTop(uint64_t bytes);
+
+  /**
+   * @brief train a learned index over the first keys of the level 2 
+   *  segments (see LearnedSegmentIndex). Get predicts the level 2 segment 
+   *  from it and skips the vEB descent, reading one level 2 and one level 3
+   *  segment; a miss descends the vEB tree as before. the models are 
+   *  retrained on the level 2 segments an insertion changes.
+   * 
+   * @param max_error the most segments a prediction may be off by
+   */
+  void EnableLearnedIndex(uint64_t max_error);
+
+  // nullptr if the learned index is not enabled.
+  inline const LearnedSegmentIndex* learned_index() const {
+    return learned_index_.get(); }
+
+  /**
+   * @brief keep a hash table from key to the level 3 slot of its record. 
+   *  an exact-match Get that finds the key there reads one level 3 segment
+   *  instead of descending the three levels. an entry is added by the Get
+   *  descending for the key and checked against the key in the slot before
+   *  use: a record moved by a rebalance is found by the descent again. 
+   *  ordered operations do not use it.
+   * 
+   * @param capacity the most entries kept, 0 disables the table
+   */
+  void EnableHashIndex(uint64_t capacity);
+
+  inline uint64_t hash_index_hit_count() const { return hash_index_hit_; }
+  // entries found pointing to a slot the record has moved out of.
+  inline uint64_t hash_index_stale_count() const { 
+    return hash_index_stale_; }
+
+  // pin a read snapshot of the current records.
+  std::unique_ptr<ReadSnapshot> CreateReadSnapshot();
+
+  /**
+   * @brief append the records with start_key <= key <= end_key to records 
+   *  in key order. the tree lock is only held while a segment is copied, 
+   *  so writers proceed between segments. in value log mode the values are
+   *  log offsets.
+   * 
+   * @param start_key the smallest key to return
+   * @param end_key the largest key to return
+   * @param records output
+   * @param snapshot the view to scan. nullptr scans a view of the current
+   *  records pinned for the duration of the scan.
+   * @return uint64_t the number of records appended
+   */
+  uint64_t Scan(uint64_t start_key, uint64_t end_key, 
+    std::vector<L3Node>* records, const ReadSnapshot* snapshot);
+
+  // scan a view of the current records.
+  uint64_t Scan(uint64_t start_key, uint64_t end_key, 
+    std::vector<L3Node>* records) override {
+    return Scan(start_key, end_key, records, nullptr);
+  }
+
+  /**
+   * @brief switch to value log mode: values given to Put are appended to a 
+   *  separate log and the bottom level only stores (key, log offset). 
+   *  rebalances then move 16 bytes per record regardless of value size.
+   * 
+   * @param log_capacity bytes of the circular value log
+   */
+  void EnableValueLog(uint64_t log_capacity);
+
+  // value log mode only. return false if the log is full of live values,
+  //  the insertion failed or key is 0 (reserved).
+  bool Put(uint64_t key, const std::string& value);
+
+  // value log mode only. return if a value Put for the key is found.
+  bool Get(uint64_t key, std::string* value);
+
+  // nullptr if not in value log mode.
+  inline const ValueLog* value_log() const { return value_log_.get(); }
+
+  /**
+   * @brief relocate the live values among the oldest bytes of the value log
+   *  to its tail, patch their offsets in level 3 in one batch and reclaim
+   *  the space. 
+   * 
+   * @param max_bytes the number of log bytes to examine at most
+   * @return uint64_t the number of log bytes freed
+   */
+  uint64_t CollectValueLogGarbage(uint64_t max_bytes);
+
+  /**
+   * @brief log every insertion to wal before applying it. concurrent 
+   *  inserters are serialized on the tree but share the log flush (group 
+   *  commit). the value log is not covered by the log.
+   * 
+   * @param wal the log, owned by the caller
+   * @param image_path the checkpoint image used by periodic checkpoints
+   * @param checkpoint_interval checkpoint after this many logged records. 
+   *  0 disables periodic checkpoints.
+   */
+  void AttachWriteAheadLog(WriteAheadLog* wal, const std::string& image_path,
+    uint64_t checkpoint_interval);
+
+  /**
+   * @brief write a snapshot of the three levels, then truncate the log.
+   *  a snapshot file is page-aligned: a header page followed by the 
+   *  metadata arrays and raw segment arrays of l1, l2, l3, each starting on
+   *  a page boundary. two snapshot files (<path>.0 and <path>.1) are used
+   *  alternately and only the segments modified since a file was last 
+   *  written are rewritten. the header is written last, so a crash during
+   *  checkpoint leaves the previous snapshot intact.
+   * 
+   * @param path path prefix of the snapshot files
+   * @return bool false on io error
+   */
+  bool Checkpoint(const std::string& path);
+
+  /**
+   * @brief open the latest snapshot written by Checkpoint. the file is 
+   *  mapped privately and used in place: nothing is read or deserialized 
+   *  until pages are first accessed, and modifications are not written back
+   *  to the file.
+   * 
+   * @param path path prefix of the snapshot files
+   * @param uid the uid prefix, must outlive the tree
+   * @param cache the cache to go through
+   * @return std::unique_ptr<CoBtree> nullptr if no valid snapshot exists
+   */
+  static std::unique_ptr<CoBtree> Open(const std::string& path,
+    const std::string& uid, Cache* cache);
+
+  // replay the log tail after the snapshot the tree was opened from (the 
+  // whole log for a tree that was constructed). call after attaching the 
+  // log. return the number of records replayed.
+  uint64_t Recover();
+
+  /**
+   * @brief record the latency of every Get, Insert and Scan from now on in 
+   *  histograms. an insert is tagged with the most expensive step it took 
+   *  (see LatencyPath) and the rebalance window height of each level it 
+   *  rebalanced. calling it again clears the histograms; it must not race
+   *  with running operations.
+   */
+  void EnableLatencyStats();
+
+  // nullptr until EnableLatencyStats is called.
+  inline const OpLatencyStats* latency_stats() const {
+    return latency_stats_.get(); }
+
+  // print the non-empty latency histograms.
+  void DumpLatencyStats(std::ostream* out) const;
 
   std::string CreateUid() {
     return uid_prefix_ + std::to_string(uid_seqeunce_number_++);
   }
 
  private:
+  friend class ReadSnapshot;
+  friend class AsyncGetScheduler;
+
+  // unpin a read snapshot, called when its handle is destroyed.
+  void ReleaseReadSnapshot(uint64_t epoch);
+
+  // create the tree over a mapped snapshot, used by Open.
+  CoBtree(const std::string& uid, Cache* cache, const SnapshotHeader& header,
+    std::unique_ptr<MappedFile> snapshot);
+
   /**
    * @brief update the second level down pointer and separator keys. 
    *  (potentially add new item in second level if new segments are 
@@ -83,6 +313,54 @@ class CoBtree {
   // return false if l1 leaf insertion failed.
   bool L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
     const PMAUpdateContext& l2_update_ctx);
+
+  // apply the insertion to the three levels (or the insert buffer) 
+  // without logging.
+  bool InsertRecord(uint64_t key, uint64_t value);
+
+  // log the insertion to the wal if set and apply it, holding mu_. lsn 
+  // and checkpoint_due are passed to CommitInsert once mu_ is released.
+  bool LogAndInsertRecord(uint64_t key, uint64_t value, uint64_t* lsn,
+    bool* checkpoint_due);
+
+  // wait until the insertion logged at lsn is durable, checkpoint if due.
+  // return false if the wal failed.
+  bool CommitInsert(uint64_t lsn, bool checkpoint_due);
+
+  // CollectValueLogGarbage holding mu_.
+  uint64_t ReclaimValueLog(uint64_t max_bytes);
+
+  // Get and Scan without latency recording.
+  bool GetRecord(uint64_t key, uint64_t* value);
+  uint64_t ScanRecords(uint64_t start_key, uint64_t end_key, 
+    std::vector<L3Node>* records, const ReadSnapshot* snapshot);
+
+  // advance a lookup until it completes (return true) or the next node or
+  // segment it needs is not in the cache (return false). a lookup that 
+  // was overtaken by an insert restarts, counted in restart_count.
+  bool AdvanceAsyncGet(AsyncGetState* lookup, uint64_t* restart_count);
+
+  // start timing an operation: reset its path and the rebalance heights.
+  // return the start time, 0 if latency stats are disabled.
+  uint64_t BeginLatency();
+  // record the latency of the operation started by BeginLatency.
+  void EndLatency(LatencyOp op, uint64_t start);
+  inline void NoteLatencyPath(LatencyPath path) {
+    if (path > op_path_) op_path_ = path;
+  }
+
+  // update level 2 and level 1 after the level 3 segment rebalanced.
+  // return false if an upper level is full.
+  bool PropagateL3Update(uint64_t vebleaf_address, uint64_t l2_segment_id,
+    uint64_t l2_item_pos, uint64_t l3_segment_id, 
+    const PMAUpdateContext& ctx);
+
+  // merge the insert buffer into level 3. return false if a level is full.
+  bool FlushInsertBuffer();
+
+  // descend the three levels to the position of key in level 3.
+  // return if the record at the position has the same key.
+  bool Locate(uint64_t key, uint64_t* l3_segment_id, uint64_t* pos);
   
   const std::string& uid_prefix_;
   uint64_t uid_seqeunce_number_;
@@ -93,9 +371,57 @@ class CoBtree {
   uint64_t item_count_l2;
   uint64_t leaf_count_l1;
 
+  // set if the tree was opened from a snapshot. the levels live on it.
+  std::unique_ptr<MappedFile> snapshot_;
+
   vEBTree tree_;
   PMA pma_index_;
   PMA pma_data_;
+
+  // only set in value log mode. level 3 values are offsets into it.
+  std::unique_ptr<ValueLog> value_log_;
+  uint64_t value_log_gc_batch_; // log bytes examined per garbage collection
+
+  // only set once EnableLearnedIndex is called.
+  std::unique_ptr<LearnedSegmentIndex> learned_index_;
+
+  // the level 3 slot last seen holding a key, see EnableHashIndex.
+  struct L3Slot {
+    uint64_t segment_id;
+    uint64_t pos;
+  };
+  std::unordered_map<uint64_t, L3Slot> hash_index_;
+  uint64_t hash_index_capacity_ = 0; // 0 if the table is disabled
+  uint64_t hash_index_hit_ = 0;
+  uint64_t hash_index_stale_ = 0;
+
+  // records inserted but not yet merged into level 3.
+  std::map<uint64_t, uint64_t> insert_buffer_;
+  uint64_t insert_buffer_capacity_ = 0; // 0 if the buffer is disabled
+  // incremented by every insertion and buffer flush, see AdvanceAsyncGet.
+  uint64_t write_sequence_ = 0;
+
+  // mu_ serializes the tree operations.
+  std::mutex mu_;
+  WriteAheadLog* wal_;
+  std::string checkpoint_image_path_;
+  uint64_t checkpoint_interval_;
+  uint64_t record_since_checkpoint_;
+  // the snapshot slot the last checkpoint wrote to and, for each slot, the 
+  // version of the l1, l2, l3 pma when it was last written. a slot whose
+  // content is unknown to this instance needs a full write.
+  std::string checkpoint_path_;
+  uint64_t checkpoint_slot_;
+  uint64_t checkpoint_sequence_;
+  uint64_t checkpoint_version_[2][3];
+  bool checkpoint_full_[2];
+  uint64_t recovery_lsn_; // log records up to it are in the opened snapshot
+  // latency recording, see EnableLatencyStats. the path and the vEB split 
+  // counts are those of the operation being timed.
+  std::unique_ptr<OpLatencyStats> latency_stats_;
+  LatencyPath op_path_ = kPathRead;
+  uint64_t op_node_split_count_ = 0;
+  uint64_t op_root_split_count_ = 0;
   // we do not have up pointers. as we insert, we store the address of item in the upper level that should be updated.
 };
 }  // namespace cobtree
@@ -0,0 +1,95 @@
+#ifndef COBTREE_COLA_H_
+#define COBTREE_COLA_H_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "block_device.h"
+#include "cache.h"
+#include "engine.h"
+
+namespace cobtree {
+
+enum ColaEntryType : uint64_t {
+  kColaRecord = 0,
+  kColaLookahead = 1, // value is the position of key in the next level
+};
+
+// an entry of a cola level. besides records, a level holds lookahead
+// entries sampling every kColaLookaheadStride-th entry of the next level.
+// every entry duplicates the closest lookahead at or before it, so a
+// search narrows the next level to one stride without scanning for it.
+struct ColaEntry {
+  uint64_t key;
+  uint64_t value;
+  uint64_t type;
+  uint64_t left_lookahead; // position in the next level, UINT64_MAX if none
+};
+
+const uint64_t kColaLookaheadStride = 8;
+
+/**
+ * @brief cache-oblivious lookahead array. level k holds at most 2^k records
+ *  in key order and is either empty of records or the result of one merge.
+ *  an insertion merges the new record with the levels above the first
+ *  level without records (newer records win) into the smallest of these 
+ *  levels that holds the merged records, so an update does not take up 
+ *  capacity and each record is rewritten O(log N) times in sequential 
+ *  passes. a search visits
+ *  O(1) blocks per level thanks to the lookahead entries (fractional
+ *  cascading).
+ *  level k reserves 2^(k+1) entries on the device: 2^k for records and
+ *  at most 2^(k-1) for lookahead entries.
+ */
+class Cola : public Engine {
+ public:
+  Cola() = delete;
+  Cola(const std::string& id, uint64_t estimated_record_count, Cache* cache);
+  ~Cola() = default;
+
+  // return if the value is found. if found, value store in value.
+  bool Get(uint64_t key, uint64_t* value) override;
+
+  // return false if insertion failed due to the levels being full (the 
+  // distinct keys exceed the capacity).
+  bool Insert(uint64_t key, uint64_t value) override;
+
+  // every level is searched for start_key, then the levels are merged 
+  // (newer records win).
+  uint64_t Scan(uint64_t start_key, uint64_t end_key,
+    std::vector<L3Node>* records) override;
+
+  inline uint64_t level_count() const { return level_size_.size(); }
+  inline uint64_t level_size(uint64_t level) const {
+    return level_size_[level]; }
+  inline uint64_t level_record_count(uint64_t level) const {
+    return level_record_count_[level]; }
+
+ private:
+  // the device offset of an entry.
+  inline uint64_t EntryOffset(uint64_t level, uint64_t pos) const {
+    // levels before k reserve 2^(k+1) - 2 entries in total.
+    return (((1ULL << (level + 1)) - 2) + pos) * sizeof(ColaEntry);
+  }
+
+  // fetch count entries of a level, the blocks touched are counted.
+  const ColaEntry* Load(uint64_t level, uint64_t pos, uint64_t count) const;
+
+  // write the entries of a level through the cache.
+  void Store(uint64_t level, const std::vector<ColaEntry>& entries);
+
+  // rebuild the level from its records and the samples of the next level.
+  void Build(uint64_t level, const std::vector<ColaEntry>& records);
+
+  const std::string id_;
+  Cache* cache_;
+  const uint64_t max_level_count_;
+  std::unique_ptr<BlockDevice> storage_;
+  std::vector<uint64_t> level_size_; // entries, records and lookaheads
+  std::vector<uint64_t> level_record_count_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_COLA_H_
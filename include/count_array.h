@@ -0,0 +1,52 @@
+#ifndef COBTREE_COUNT_ARRAY_H_
+#define COBTREE_COUNT_ARRAY_H_
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+namespace cobtree {
+
+// a fixed-size array of per-segment counters. it either owns zero
+// initialized memory or is placed on external memory (a mapped checkpoint)
+// so that opening a checkpoint does not copy the metadata.
+// owned memory comes from calloc: large arrays get lazily zeroed pages.
+class CountArray {
+ public:
+  CountArray() = delete;
+  explicit CountArray(uint64_t size)
+    : owned_(static_cast<uint64_t*>(std::calloc(size, sizeof(uint64_t)))),
+    data_(owned_), size_(size) {
+      assert(owned_ || size == 0);
+    }
+
+  CountArray(uint64_t* external, uint64_t size)
+    : owned_(nullptr), data_(external), size_(size) {}
+
+  ~CountArray() { std::free(owned_); }
+
+  CountArray(const CountArray&) = delete;
+  CountArray& operator=(const CountArray&) = delete;
+
+  inline uint64_t& operator[](uint64_t idx) {
+    assert(idx < size_);
+    return data_[idx];
+  }
+
+  inline const uint64_t& operator[](uint64_t idx) const {
+    assert(idx < size_);
+    return data_[idx];
+  }
+
+  inline uint64_t size() const { return size_; }
+  inline uint64_t* data() { return data_; }
+  inline const uint64_t* data() const { return data_; }
+
+ private:
+  uint64_t* owned_; // nullptr if placed on external memory
+  uint64_t* data_;
+  uint64_t size_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_COUNT_ARRAY_H_
@@ -0,0 +1,43 @@
+#ifndef COBTREE_ENGINE_H_
+#define COBTREE_ENGINE_H_
+
+#include <cstdint>
+#include <vector>
+#include "type.h"
+
+namespace cobtree {
+
+// the operations shared by the key-value engines (CoBtree, Cola and the 
+// baselines), so that they run the same workloads. an engine goes through
+// the Cache it is given, which counts its block transfers.
+class Engine {
+ public:
+  virtual ~Engine() = default;
+
+  // return if the value is found. if found, value store in value.
+  virtual bool Get(uint64_t key, uint64_t* value) = 0;
+
+  // look up count keys. found[i] is set if values[i] holds the value of 
+  // keys[i]. return the number of keys found. engines may overlap the 
+  // lookups, by default they run one after another.
+  virtual uint64_t GetBatch(const uint64_t* keys, uint64_t count, 
+    uint64_t* values, bool* found) {
+    uint64_t found_count = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      found[i] = Get(keys[i], &values[i]);
+      if (found[i]) found_count++;
+    }
+    return found_count;
+  }
+
+  // insert or update. return false if the engine is full.
+  virtual bool Insert(uint64_t key, uint64_t value) = 0;
+
+  // append the records with start_key <= key <= end_key to records in key
+  // order. return the number of records appended.
+  virtual uint64_t Scan(uint64_t start_key, uint64_t end_key, 
+    std::vector<L3Node>* records) = 0;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_ENGINE_H_
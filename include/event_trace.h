@@ -0,0 +1,139 @@
+#ifndef COBTREE_EVENT_TRACE_H_
+#define COBTREE_EVENT_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cobtree {
+
+enum TraceEventType : uint32_t {
+  kTracePMARebalance = 0, // segment, window height, left, right
+  kTracePMARebalanceRange, // left, right, items moved, bytes copied
+  kTraceNodeSplit, // node address, height
+  kTraceMoveSubtree, // root address, height, new address, bytes copied
+  kTraceL2Update, // l2 segment, l3 segments updated, l2 segments updated
+  kTraceL1Update, // leaf address, l2 segments updated
+  kTraceCacheEvict, // bytes evicted, bytes used after
+  kTraceEventTypeCount
+};
+
+struct TraceEvent {
+  uint64_t start_ns;
+  uint64_t duration_ns; // 0 for an instant event
+  TraceEventType type;
+  uint32_t device; // index into the device names of the tracer
+  uint32_t thread;
+  uint64_t args[4];
+};
+
+/**
+ * @brief keeps the last capacity events in a ring buffer. an event is a
+ *  fixed-size record claimed with one atomic increment. the trace points
+ *  pass the device id, interned once by its owner with DeviceId (see
+ *  PMA::trace_device and Cache::TraceDevice). the trace points compile to
+ *  nothing unless
+ *  COBTREE_EVENT_TRACE is defined and cost a null check when no tracer is
+ *  attached (see Cache::set_event_tracer). export when no traced operation
+ *  is running.
+ */
+class EventTracer {
+ public:
+  EventTracer() = delete;
+  explicit EventTracer(uint64_t capacity);
+
+  EventTracer(const EventTracer&) = delete;
+  EventTracer& operator=(const EventTracer&) = delete;
+
+  // the id of a device name, taking a lock. call it once per device and
+  // tracer, not per event.
+  uint32_t DeviceId(const std::string& device);
+
+  void Record(TraceEventType type, uint32_t device, uint64_t start_ns,
+    uint64_t duration_ns, const uint64_t* args);
+
+  // the retained events, oldest first.
+  std::vector<TraceEvent> Events() const;
+
+  // the events recorded so far, including the overwritten ones.
+  inline uint64_t recorded_count() const {
+    return next_.load(std::memory_order_relaxed); }
+
+  inline const std::string& device_name(uint32_t device) const {
+    return devices_[device]; }
+
+  /**
+   * @brief write the retained events in the chrome trace event format
+   *  (load it in chrome://tracing or perfetto). timed events are complete
+   *  ("X") events, instant events "i" events.
+   */
+  void ExportChromeTrace(std::ostream* out) const;
+
+  static const char* EventName(TraceEventType type);
+
+  static uint64_t NowNs();
+
+ private:
+  std::vector<TraceEvent> events_;
+  std::atomic<uint64_t> next_; // slot of the next event, mod capacity
+  std::mutex devices_mu_;
+  std::unordered_map<std::string, uint32_t> device_ids_;
+  std::vector<std::string> devices_;
+};
+
+// times the enclosing scope as one event on a tracer (nullptr for none).
+class TraceScope {
+ public:
+  TraceScope(EventTracer* tracer, TraceEventType type, uint32_t device)
+    : tracer_(tracer), type_(type),
+    device_(device), start_ns_(tracer ? EventTracer::NowNs() : 0),
+    args_{0, 0, 0, 0} {}
+
+  ~TraceScope() {
+    if (tracer_) {
+      tracer_->Record(type_, device_, start_ns_,
+        EventTracer::NowNs() - start_ns_, args_);
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  inline void set_arg(int index, uint64_t value) { args_[index] = value; }
+
+ private:
+  EventTracer* tracer_;
+  TraceEventType type_;
+  uint32_t device_;
+  uint64_t start_ns_;
+  uint64_t args_[4];
+};
+
+}  // namespace cobtree
+
+#ifdef COBTREE_EVENT_TRACE
+#define COBTREE_TRACE_SCOPE(scope, tracer, type, device) \
+  cobtree::TraceScope scope((tracer), (type), (device))
+#define COBTREE_TRACE_ARG(scope, index, value) \
+  (scope).set_arg((index), (value))
+#define COBTREE_TRACE_INSTANT(tracer, type, device, arg0, arg1) \
+  do { \
+    auto trace_tracer_ = (tracer); \
+    if (trace_tracer_) { \
+      uint64_t trace_args_[4] = {(arg0), (arg1), 0, 0}; \
+      trace_tracer_->Record((type), (device), \
+        cobtree::EventTracer::NowNs(), 0, trace_args_); \
+    } \
+  } while (0)
+#else
+#define COBTREE_TRACE_SCOPE(scope, tracer, type, device) do {} while (0)
+#define COBTREE_TRACE_ARG(scope, index, value) do {} while (0)
+#define COBTREE_TRACE_INSTANT(tracer, type, device, arg0, arg1) \
+  do {} while (0)
+#endif  // COBTREE_EVENT_TRACE
+
+#endif  // COBTREE_EVENT_TRACE_H_
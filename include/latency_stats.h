@@ -0,0 +1,127 @@
+#ifndef COBTREE_LATENCY_STATS_H_
+#define COBTREE_LATENCY_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace cobtree {
+
+/**
+ * @brief a log-linear (HDR-style) histogram of latencies in nanoseconds.
+ *  values below 2^kSubBucketBits are counted exactly, larger ones in
+ *  2^(kSubBucketBits-1) buckets per power of two, a relative error under
+ *  1/64. Record is a few shifts and one relaxed atomic add, so it can be
+ *  called from concurrent operations.
+ */
+class LatencyHistogram {
+ public:
+  static const int kSubBucketBits = 7;
+  static const int kMaxValueBits = 40; // larger values (18 min) are clamped
+
+  LatencyHistogram();
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Record(uint64_t value);
+
+  // add the samples of other.
+  void Merge(const LatencyHistogram& other);
+
+  void Reset();
+
+  inline uint64_t count() const {
+    return count_.load(std::memory_order_relaxed); }
+  inline uint64_t min() const {
+    return (count() > 0) ? min_.load(std::memory_order_relaxed) : 0; }
+  inline uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  double mean() const;
+
+  // the smallest recorded value (up to the bucket precision) that
+  // percentile percent of the samples do not exceed. 0 if empty.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+ private:
+  static uint64_t BucketIndex(uint64_t value);
+  // the largest value counted in the bucket.
+  static uint64_t BucketValue(uint64_t index);
+
+  std::vector<std::atomic<uint64_t>> buckets_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> min_;
+  std::atomic<uint64_t> max_;
+};
+
+enum LatencyOp {
+  kLatencyGet = 0,
+  kLatencyInsert = 1,
+  kLatencyScan = 2,
+  kLatencyOpCount
+};
+
+// what an operation did, in increasing order of cost. an operation is
+// tagged with the most expensive step it took.
+enum LatencyPath {
+  kPathRead = 0, // Get and Scan
+  kPathBuffered, // insert held by the insert buffer
+  kPathUpdate, // fast path: the key existed, updated in place
+  kPathL3Insert, // level 3 insert without rebalance
+  kPathL2Update, // level 3 rebalanced, level 2 updated
+  kPathL1Update, // level 2 rebalanced, the vEB tree updated
+  kPathNodeSplit, // a vEB node was split
+  kPathRootSplit, // the vEB root was split
+  kLatencyPathCount
+};
+
+/**
+ * @brief latency histograms of the tree operations, one per operation and
+ *  path, and for each pma level (0 the vEB tree, 1 level 2, 2 level 3) one
+ *  per rebalance window height (the levels of the implicit pma tree the
+ *  rebalanced range spans) of the operations that rebalanced it.
+ */
+class OpLatencyStats {
+ public:
+  static const int kLevelCount = 3;
+
+  // max_height[level] bounds the rebalance window height of each level.
+  explicit OpLatencyStats(const std::vector<int>& max_height);
+
+  // rebalance_height[level] is 0 if the level was not rebalanced.
+  void Record(LatencyOp op, LatencyPath path, const int* rebalance_height,
+    uint64_t latency_ns);
+
+  inline const LatencyHistogram& histogram(LatencyOp op,
+    LatencyPath path) const { return op_[op][path]; }
+  // nullptr if height exceeds the bound of the level.
+  const LatencyHistogram* rebalance_histogram(int level, int height) const;
+
+  void Reset();
+
+  /**
+   * @brief print one line per non-empty histogram: count, mean,
+   *  percentiles and max in microseconds.
+   */
+  void Dump(std::ostream* out) const;
+
+  static const char* OpName(LatencyOp op);
+  static const char* PathName(LatencyPath path);
+
+ private:
+  LatencyHistogram op_[kLatencyOpCount][kLatencyPathCount];
+  // indexed by height - 1.
+  std::vector<std::unique_ptr<LatencyHistogram>> rebalance_[kLevelCount];
+};
+
+// nanoseconds since an arbitrary epoch, for latency measurement.
+inline uint64_t LatencyNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace cobtree
+#endif  // COBTREE_LATENCY_STATS_H_
@@ -0,0 +1,104 @@
+#ifndef COBTREE_LEARNED_INDEX_H_
+#define COBTREE_LEARNED_INDEX_H_
+
+#include <cstdint>
+#include <vector>
+#include "pma.h"
+
+namespace cobtree {
+
+/**
+ * @brief a learned index over the first keys of the level 2 segments:
+ *  piecewise linear models map a key to a segment id within max_error,
+ *  the few candidate first keys around the prediction are then searched.
+ *  it finds the last segment whose first key is not larger than the key,
+ *  which is the segment the vEB tree descent ends in.
+ *
+ *  the segments hold consecutive key ranges in segment id order, so the
+ *  first keys are non-decreasing in segment id. an empty segment takes the
+ *  first key of the next non-empty one and is never returned. the models
+ *  are fit greedily: a model grows while a line within max_error of all its
+ *  points exists. Update only refits the models covering the changed
+ *  segments.
+ *
+ *  the level 2 pma keeps its keys in descending order of segment id (a 
+ *  rebalance moves the smallest keys to the last segments of its range), 
+ *  so Refresh and FindSegment index its segments in reverse: segment s of
+ *  level 2 is segment segment_count - 1 - s here.
+ */
+class LearnedSegmentIndex {
+ public:
+  LearnedSegmentIndex() = delete;
+  LearnedSegmentIndex(uint64_t segment_count, uint64_t max_error);
+
+  LearnedSegmentIndex(const LearnedSegmentIndex&) = delete;
+  LearnedSegmentIndex& operator=(const LearnedSegmentIndex&) = delete;
+
+  /**
+   * @brief set the first keys of consecutive segments and retrain.
+   *
+   * @param first_segment the id of the first segment to set
+   * @param first_keys the first key of each segment, UINT64_MAX if empty
+   */
+  void Update(uint64_t first_segment, const std::vector<uint64_t>& first_keys);
+
+  // Update with the first keys of the level 2 segments in [first, last].
+  // the index has as many segments as level 2.
+  void Refresh(const PMA& level2, uint64_t first, uint64_t last);
+
+  /**
+   * @brief Refresh after an insertion into level 3 below the level 2 
+   *  segment l2_segment_id rebalanced. the walks over level 2 rewrite the
+   *  first keys of the neighbouring segments, at most one segment per level
+   *  3 segment moved, and the level 2 rebalance moves the segments of its 
+   *  context.
+   *
+   * @param level2 the level 2 pma (L2Node items)
+   * @param l2_segment_id the level 2 segment of the insertion
+   * @param l3_ctx the level 3 rebalance context
+   * @param l2_ctx the level 2 rebalance context, empty if none
+   */
+  void Refresh(const PMA& level2, uint64_t l2_segment_id, 
+    const PMAUpdateContext& l3_ctx, const PMAUpdateContext& l2_ctx);
+
+  // return false if the key cannot be placed (smaller than every first
+  // key), the caller then falls back to the vEB tree.
+  bool Find(uint64_t key, uint64_t* segment_id);
+
+  // Find the level 2 segment of key, see Refresh.
+  bool FindSegment(uint64_t key, uint64_t* l2_segment_id);
+
+  inline uint64_t model_count() const { return models_.size(); }
+  inline uint64_t max_error() const { return max_error_; }
+  inline uint64_t hit_count() const { return hit_count_; }
+  inline uint64_t miss_count() const { return miss_count_; }
+
+ private:
+  struct Model {
+    uint64_t first_key;
+    uint64_t first_segment;
+    uint64_t end_segment; // one past the last segment covered
+    double slope; // segments per key
+  };
+
+  // fit the models of the segments in [begin, end).
+  void Fit(uint64_t begin, uint64_t end, std::vector<Model>* models) const;
+
+  // the index of the model covering segment_id, models_.size() if none.
+  uint64_t ModelOf(uint64_t segment_id) const;
+
+  // the index segment of a level 2 segment id, and the reverse.
+  inline uint64_t mirror(uint64_t segment_id) const {
+    return first_keys_.size() - 1 - segment_id; }
+
+  const uint64_t max_error_;
+  std::vector<uint64_t> first_keys_; // UINT64_MAX for an empty segment
+  std::vector<uint64_t> keys_; // the first keys with the empty ones filled
+  uint64_t size_; // one past the last non-empty segment
+  std::vector<Model> models_; // in segment order
+  uint64_t hit_count_;
+  uint64_t miss_count_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_LEARNED_INDEX_H_
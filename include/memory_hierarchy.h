@@ -0,0 +1,85 @@
+#ifndef COBTREE_MEMORY_HIERARCHY_H_
+#define COBTREE_MEMORY_HIERARCHY_H_
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cobtree {
+
+struct MemoryLevelOption {
+  std::string name;
+  uint64_t block_size; // bytes
+  uint64_t capacity; // bytes
+};
+
+struct MemoryLevelStats {
+  uint64_t access_count; // blocks looked up in the level
+  uint64_t transfer_count; // blocks brought in from the level below
+};
+
+/**
+ * @brief a stack of caches between the cpu and the devices, from the
+ *  smallest (e.g. 64B/32KB) to the largest (e.g. 4KB/4GB) level. each level
+ *  has its own block size and capacity and evicts the least recently used
+ *  block. an access is looked up level by level: the byte ranges a level
+ *  misses are looked up in the next one, so a single run reports the
+ *  transfers across every boundary of the hierarchy at once.
+ *  the hierarchy only simulates placement and counts, it holds no data.
+ */
+class MemoryHierarchy {
+ public:
+  MemoryHierarchy() = delete;
+  explicit MemoryHierarchy(const std::vector<MemoryLevelOption>& options);
+  ~MemoryHierarchy() = default;
+
+  // parse levels given as block_size:capacity pairs separated by commas,
+  // e.g. "64:32768,64:1048576,4096:4294967296".
+  // return false and leave options untouched on a malformed description.
+  static bool ParseLevels(const std::string& description,
+    std::vector<MemoryLevelOption>* options);
+
+  // read len bytes at offset of the device.
+  void Access(const std::string& device, uint64_t offset, uint64_t len);
+
+  inline uint64_t level_count() const { return levels_.size(); }
+  inline const MemoryLevelOption& option(uint64_t level) const {
+    return levels_[level].option; }
+  inline const MemoryLevelStats& stats(uint64_t level) const {
+    return levels_[level].stats; }
+
+  void ResetStats();
+
+ private:
+  // a block of a device, the device is interned to a number.
+  typedef std::pair<uint64_t, uint64_t> BlockId;
+  struct BlockIdHash {
+    size_t operator()(const BlockId& id) const {
+      return std::hash<uint64_t>()(id.first * 0x9e3779b97f4a7c15ULL
+        ^ id.second);
+    }
+  };
+
+  struct Level {
+    explicit Level(const MemoryLevelOption& _option)
+      : option(_option), stats{0, 0} {}
+    MemoryLevelOption option;
+    MemoryLevelStats stats;
+    std::list<BlockId> lru_list; // most recently used first
+    std::unordered_map<BlockId, std::list<BlockId>::iterator, BlockIdHash>
+      blocks;
+  };
+
+  // return the ranges [begin, end) of the blocks the level missed.
+  std::vector<std::pair<uint64_t, uint64_t>> AccessLevel(Level* level,
+    uint64_t device, uint64_t begin, uint64_t end);
+
+  std::vector<Level> levels_;
+  std::unordered_map<std::string, uint64_t> devices_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_MEMORY_HIERARCHY_H_
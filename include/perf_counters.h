@@ -0,0 +1,123 @@
+#ifndef COBTREE_PERF_COUNTERS_H_
+#define COBTREE_PERF_COUNTERS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace cobtree {
+
+enum PerfEvent {
+  kPerfCacheMiss = 0, // last level cache misses
+  kPerfTLBMiss, // data TLB read misses
+  kPerfBranchMiss,
+  kPerfInstruction,
+  kPerfEventCount
+};
+
+struct PerfCounts {
+  uint64_t value[kPerfEventCount];
+
+  PerfCounts() : value{0, 0, 0, 0} {}
+};
+
+/**
+ * @brief hardware counters of the calling thread (user space only), opened
+ *  with perf_event_open as one group so they are read together with one
+ *  read call. the counters the kernel or the cpu do not provide read 0;
+ *  ok() is false if none could be opened (no pmu, perf_event_paranoid).
+ */
+class PerfCounterGroup {
+ public:
+  PerfCounterGroup();
+  ~PerfCounterGroup();
+
+  PerfCounterGroup(const PerfCounterGroup&) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+  inline bool ok() const { return leader_fd_ >= 0; }
+  inline bool available(PerfEvent event) const { return fd_[event] >= 0; }
+
+  // the counts since the group was opened. return false if not ok.
+  bool Read(PerfCounts* counts) const;
+
+  // the group of the calling thread, opened on first use.
+  static PerfCounterGroup* ThisThread();
+
+  static const char* EventName(PerfEvent event);
+
+ private:
+  int leader_fd_;
+  int fd_[kPerfEventCount];
+  int position_[kPerfEventCount]; // index of the event in a group read
+  int opened_count_;
+};
+
+// the code regions bracketed with hardware counters.
+enum PerfProbe {
+  kProbeCoBtreeGet = 0,
+  kProbeCoBtreeInsert,
+  kProbeVEBTreeGet,
+  kProbePMARebalanceRange,
+  kPerfProbeCount
+};
+
+/**
+ * @brief the counter deltas accumulated over every execution of each probe
+ *  (an enclosing probe includes the nested ones). attach it with
+ *  Cache::set_perf_stats, the probes are skipped otherwise. each bracket
+ *  costs two counter reads (system calls), so it is meant for measurement
+ *  runs.
+ */
+class PerfProbeStats {
+ public:
+  PerfProbeStats();
+
+  PerfProbeStats(const PerfProbeStats&) = delete;
+  PerfProbeStats& operator=(const PerfProbeStats&) = delete;
+
+  void Add(PerfProbe probe, const PerfCounts& begin, const PerfCounts& end);
+
+  inline uint64_t call_count(PerfProbe probe) const {
+    return calls_[probe].load(std::memory_order_relaxed); }
+  inline uint64_t count(PerfProbe probe, PerfEvent event) const {
+    return counts_[probe][event].load(std::memory_order_relaxed); }
+
+  void Reset();
+
+  // print the calls and the counts per call of the probes that ran.
+  void Dump(std::ostream* out) const;
+
+  static const char* ProbeName(PerfProbe probe);
+
+ private:
+  std::atomic<uint64_t> calls_[kPerfProbeCount];
+  std::atomic<uint64_t> counts_[kPerfProbeCount][kPerfEventCount];
+};
+
+// brackets the enclosing scope on the counters of the calling thread.
+class PerfScope {
+ public:
+  PerfScope(PerfProbeStats* stats, PerfProbe probe) : stats_(stats),
+    probe_(probe) {
+    if (stats_) PerfCounterGroup::ThisThread()->Read(&begin_);
+  }
+
+  ~PerfScope() {
+    if (!stats_) return;
+    PerfCounts end;
+    PerfCounterGroup::ThisThread()->Read(&end);
+    stats_->Add(probe_, begin_, end);
+  }
+
+  PerfScope(const PerfScope&) = delete;
+  PerfScope& operator=(const PerfScope&) = delete;
+
+ private:
+  PerfProbeStats* stats_;
+  PerfProbe probe_;
+  PerfCounts begin_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_PERF_COUNTERS_H_
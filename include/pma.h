@@ -3,10 +3,13 @@
 
 #include <cassert>
 #include <cmath>
+#include <memory>
+#include <set>
 #include <vector>
 #include <unordered_map>
 #include "block_device.h"
 #include "cache.h"
+#include "count_array.h"
 
 namespace cobtree {
 
@@ -17,6 +20,52 @@ struct PMASegment {
   uint64_t num_item;
 };
 
+class PMA;
+
+// a segment whose bytes are accounted for on demand: only the byte ranges
+// loaded through the view count as transfers, at the block size of the
+// cache. a search that touches a few items of a segment pays for the
+// blocks holding them instead of the whole segment.
+class PMASegmentView {
+ public:
+  PMASegmentView() = delete;
+  PMASegmentView(const PMA* pma, uint64_t segment_id, char* content,
+    uint64_t len, uint64_t num_item)
+    : pma_(pma), segment_id_(segment_id), content_(content), len_(len),
+    num_item_(num_item) {}
+
+  // account for [offset, offset+len) of the segment and return it.
+  char* Load(uint64_t offset, uint64_t len) const;
+
+  // account for the item at pos and return it.
+  char* LoadItem(uint64_t pos) const;
+
+  // hint the cpu to fetch [offset, offset+len) ahead of its loads. not an
+  // access: nothing is accounted for.
+  void Prefetch(uint64_t offset, uint64_t len) const;
+
+  // prefetch what a search from the end of the segment reads: the items 
+  // and the slot before them.
+  void PrefetchItems() const;
+
+  // if [offset, offset+len) is in the cache. nothing is accounted for.
+  bool Resident(uint64_t offset, uint64_t len) const;
+
+  // if the range PrefetchItems covers is in the cache.
+  bool ItemsResident() const;
+
+  inline uint64_t segment_id() const { return segment_id_; }
+  inline uint64_t len() const { return len_; }
+  inline uint64_t num_item() const { return num_item_; }
+
+ private:
+  const PMA* pma_;
+  uint64_t segment_id_;
+  char* content_;
+  uint64_t len_;
+  uint64_t num_item_;
+};
+
 struct PMASegmentCopy {
   uint64_t segment_id;
   std::unique_ptr<char[]> content;
@@ -24,6 +73,14 @@ struct PMASegmentCopy {
   uint64_t num_item;
 };
 
+// an image of a segment kept for the read snapshots that saw it: the ones
+// pinned at an epoch in [from_epoch, to_epoch).
+struct PMASegmentVersion {
+  uint64_t from_epoch;
+  uint64_t to_epoch;
+  PMASegmentCopy copy;
+};
+
 struct SegmentInfo {
   SegmentInfo() = delete;
   SegmentInfo(uint64_t _segment_id, uint64_t _num_count)
@@ -62,6 +119,16 @@ struct PMADensityOption {
   double lower_density_base_lower; // rho_d
 };
 
+// the geometry and state of a pma kept in a checkpoint, enough to 
+// re-create the pma over the mapped segment array.
+struct PMALayout {
+  uint64_t item_size;
+  uint64_t segment_size;
+  uint64_t segment_count;
+  uint64_t last_non_empty_segment;
+  PMADensityOption option;
+};
+
 class PMA {
  public:
   PMA() = delete;
@@ -73,25 +140,38 @@ class PMA {
       + 1) >> 1 << 1), // make sure even number of segment count
     height_(std::ceil(std::log2(segment_count_))), cache_(cache),
     storage_(new BlockDevice(segment_count_*segment_size_*item_size_)),
-    last_non_empty_segment_(0), item_count_(segment_count_, 0),
-    option_(option) {
+    last_non_empty_segment_(0), item_count_(segment_count_),
+    version_(0), segment_version_(segment_count_),
+    epoch_(0), segment_epoch_(segment_count_), option_(option) {
       assert(cache_);
       assert(segment_count_ * segment_size_ > estimated_item_count);
-#ifndef NDEBUG
-    printf("Debug print: The PMA contains %lu segment, each size of %lu. \
-      each item has size %lu\n", segment_count_, segment_size_, item_size_);
-#endif // NDEBUG
   }
 
-  ~PMA() = default;
-
-  static std::string CreatePMACacheKey(const std::string& id, uint64_t segment_id) {
-    return id + std::to_string(segment_id);
+  // re-create a pma over the segment array and item counts of a mapped 
+  // checkpoint. nothing is read until segments are accessed.
+  PMA(const std::string& id, const PMALayout& layout, char* segments, 
+    uint64_t* item_count, Cache* cache)
+    : id_(id), item_size_(layout.item_size), 
+    segment_size_(layout.segment_size), segment_count_(layout.segment_count),
+    height_(std::ceil(std::log2(segment_count_))), cache_(cache),
+    storage_(new BlockDevice(BLOCKSIZE, segments, 
+      segment_count_*segment_size_*item_size_)),
+    last_non_empty_segment_(layout.last_non_empty_segment), 
+    item_count_(item_count, segment_count_),
+    version_(0), segment_version_(segment_count_),
+    epoch_(0), segment_epoch_(segment_count_), option_(layout.option) {
+      assert(cache_);
   }
 
+  ~PMA() = default;
+
   // the user will obtain the segment and perform get logic and additional rebalance (example vEBtree node rearrage).
+  // the whole segment is accounted for.
   PMASegment Get(uint64_t segment_id) const;
 
+  // a view of the segment, nothing is accounted for until loaded.
+  PMASegmentView GetView(uint64_t segment_id) const;
+
   PMASegmentCopy GetCopy(uint64_t segment_id) const;
 
   // This when rewrite the segment will put the item at pos.
@@ -100,10 +180,102 @@ class PMA {
   bool Add(const char* item, uint64_t segment_id, uint64_t pos, 
     PMAUpdateContext* ctx);
 
+  /**
+   * @brief replace the content of a segment, then rebalance once. used to 
+   *  merge a sorted batch into a segment, so that one rebalance is 
+   *  amortized over the batch.
+   * 
+   * @param segment_id the segment to rewrite
+   * @param items the new items in segment order, they are right-aligned
+   * @param num_item the number of items, smaller than the segment size
+   * @param ctx update context of the rebalance
+   * @return bool false if full. true otherwise
+   */
+  bool Rewrite(uint64_t segment_id, const char* items, uint64_t num_item,
+    PMAUpdateContext* ctx);
+
+  // a writer that modifies a segment in place (instead of through Add)
+  // reports it here before the modification, so that a read snapshot still
+  // seeing the segment gets a copy first and the segment is picked up by
+  // the next checkpoint. the write is recorded in the access trace.
+  inline void MarkModified(uint64_t segment_id) {
+    MarkModified(segment_id, 0, segment_size_ * item_size_);
+  }
+
+  // the same, when only [offset, offset+len) of the segment is modified.
+  inline void MarkModified(uint64_t segment_id, uint64_t offset,
+    uint64_t len) {
+    assert(segment_id < segment_count_);
+    assert(offset + len <= segment_size_ * item_size_);
+    if (!read_snapshots_.empty() && (segment_epoch_[segment_id] < epoch_)) {
+      PreserveSegment(segment_id);
+    }
+    segment_epoch_[segment_id] = epoch_;
+    segment_version_[segment_id] = ++version_;
+    cache_->RecordAccess(id_, segment_id,
+      segment_id * segment_size_ * item_size_ + offset, len, true);
+  }
+
+  // pin a read snapshot of the current state and return its epoch. 
+  // the pma must be at an operation boundary (no Add in progress).
+  inline uint64_t PinSnapshot() {
+    auto epoch = epoch_++;
+    read_snapshots_.insert(epoch);
+    return epoch;
+  }
+
+  // unpin a read snapshot and reclaim the segment images no other pinned
+  // snapshot needs.
+  void ReleaseSnapshot(uint64_t epoch);
+
+  // copy of the segment as seen by the read snapshot pinned at epoch.
+  PMASegmentCopy GetSnapshotCopy(uint64_t segment_id, uint64_t epoch) const;
+
+  // bytes held by segment images kept for read snapshots.
+  inline uint64_t retained_bytes() const { return retained_bytes_; }
+
+  // the version is increased on every modification of a segment.
+  inline uint64_t version() const { return version_; }
+
+  /**
+   * @brief write the segments modified after since_version to a file.
+   * 
+   * @param fd file to write to
+   * @param file_offset the offset in the file where the segment array starts
+   * @param since_version segments with a larger version are written
+   * @param flush_all write every segment regardless of its version
+   * @return bool false on io error
+   */
+  bool FlushModifiedSegments(int fd, uint64_t file_offset, 
+    uint64_t since_version, bool flush_all = false) const;
+
+  inline PMALayout layout() const {
+    return PMALayout{item_size_, segment_size_, segment_count_, 
+      last_non_empty_segment_, option_};
+  }
+
+  inline const CountArray& item_count() const { return item_count_; }
+  inline uint64_t segment_bytes() const { return segment_size_ * item_size_; }
+  inline uint64_t item_size() const { return item_size_; }
   inline uint64_t segment_size() const { return segment_size_; }
   inline uint64_t segment_count() const { return segment_count_; }
   inline uint64_t last_non_empty_segment() const {
     return last_non_empty_segment_; }
+  inline const std::string& id() const { return id_; }
+  inline int height() const { return height_; }
+  inline Cache* cache() const { return cache_; }
+  inline EventTracer* event_tracer() const { return cache_->event_tracer(); }
+  // the id of the pma on the attached tracer, interned once per tracer.
+  uint32_t trace_device() const;
+  inline PerfProbeStats* perf_stats() const { return cache_->perf_stats(); }
+
+  // the largest rebalance window height (2 for a segment and its neighbor,
+  // at most height() + 1) since the last call, 0 if nothing was rebalanced.
+  inline int TakeMaxRebalanceHeight() {
+    auto height = max_rebalance_height_;
+    max_rebalance_height_ = 0;
+    return height;
+  }
 
   // this function shall be deleted in the future. 
   // it is only used by vebtree to update the first segment count to 2.
@@ -114,6 +286,19 @@ class PMA {
   }
 
  private:
+  friend PMASegmentView;
+
+  // account for the access of [offset, offset+len) of the segment in the
+  // cache (at its block size) and in its memory hierarchy.
+  void AccessRange(uint64_t segment_id, uint64_t offset, uint64_t len) const;
+
+  // if [offset, offset+len) of the segment is in the cache.
+  bool RangeResident(uint64_t segment_id, uint64_t offset, 
+    uint64_t len) const;
+
+  // keep an image of the segment before it is modified for the read 
+  // snapshots that see it.
+  void PreserveSegment(uint64_t segment_id);
 
   // helper function
   inline int depth(int height) const { return height_ - height; }
@@ -167,7 +352,25 @@ class PMA {
   std::unique_ptr<BlockDevice> storage_; // total allocated space is segment_count_*segment_size_*unit_size_.
   uint64_t last_non_empty_segment_;
   // in practise this information can be kept in a header in the segment or separately. requiring at most 1 more IO to retrieve.
-  std::vector<uint64_t> item_count_;
+  CountArray item_count_;
+  int max_rebalance_height_ = 0; // see TakeMaxRebalanceHeight
+  // see trace_device
+  mutable uint64_t trace_generation_ = 0;
+  mutable uint32_t trace_device_ = 0;
+  // modification tracking for checkpoints
+  uint64_t version_;
+  CountArray segment_version_; // version of the last modification
+
+  // copy-on-write for read snapshots. a write stamps the segment with the 
+  // current epoch; a snapshot pinned at epoch e sees the stamps <= e. the 
+  // image a write replaces is kept while a snapshot needs it.
+  uint64_t epoch_;
+  CountArray segment_epoch_; // epoch of the last modification
+  std::multiset<uint64_t> read_snapshots_; // epochs of pinned snapshots
+  // for each segment, the retained images in epoch order.
+  std::unordered_map<uint64_t, std::vector<PMASegmentVersion>> 
+    retained_versions_;
+  uint64_t retained_bytes_ = 0;
 
   // parameters controlling split, merge, and reallocate
   const PMADensityOption option_;
@@ -1,29 +1,60 @@
 #ifndef COBTREE_TYPE_H_
 #define COBTREE_TYPE_H_
 
+#include <cassert>
 #include <cstdint>
 #include <limits>
 #include <string>
 
 namespace cobtree {
 
+// a pma address of a vEB node in 32 bits. the level 1 pma holds one node
+// per level 2 segment (plus the inner nodes), far fewer than 2^31. reads
+// and writes as a uint64_t, UINT64_MAX standing for no node as before. 
+// the value is sign extended: the offsets a subtree copy stores in place of 
+// addresses can wrap below 0 and must come back unchanged.
+class NodeAddress {
+ public:
+  NodeAddress() : addr_(UINT32_MAX) {}
+  NodeAddress(uint64_t addr) { *this = addr; }
+
+  NodeAddress& operator=(uint64_t addr) {
+    assert((int64_t(addr) >= INT32_MIN) && (int64_t(addr) <= INT32_MAX));
+    addr_ = uint32_t(addr);
+    return *this;
+  }
+
+  operator uint64_t() const { return uint64_t(int64_t(int32_t(addr_))); }
+
+ private:
+  uint32_t addr_;
+};
+
+// the nodes are packed to 4 bytes: an entry is 12 bytes instead of 16, 
+// the header 8 instead of 16 (with fanout 4 a node takes 56 bytes, fits a
+// cache line). the keys are read unaligned on 4 bytes.
+#pragma pack(push, 4)
 struct NodeEntry{
   bool empty() const { return (key == UINT64_MAX) && (addr == UINT64_MAX); }
   uint64_t key = UINT64_MAX;
-  uint64_t addr = UINT64_MAX; // children are stated as the unit idx of PMA.
+  NodeAddress addr; // children are stated as the unit idx of PMA.
 };
 
+// the height of an unused node.
+const uint8_t kNullHeight = UINT8_MAX;
+
 struct Node {
 
   // to be handled by vEBTree.
   // // compare against the keys then find the output the correct address
   // uint64_t NextPos(uint64_t key, uint64_t children_count, bool* is_leaf);
 
-  uint64_t parent_addr = UINT64_MAX;
-  uint64_t height = UINT64_MAX; // store tree height makes us decideing whether it is a leaf in recursive tree context easier.
+  NodeAddress parent_addr;
+  uint8_t height = kNullHeight; // store tree height makes us decideing whether it is a leaf in recursive tree context easier.
   // after this struct a node has 4d addresses preallocated to hold children space. for leaf node, the first key is the value (in cobtree the index pma segment id).
   // NodeEntry* children; 
 };
+#pragma pack(pop)
 
 struct L2Node {
   uint64_t key;
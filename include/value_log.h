@@ -0,0 +1,104 @@
+#ifndef COBTREE_VALUE_LOG_H_
+#define COBTREE_VALUE_LOG_H_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "block_device.h"
+#include "cache.h"
+
+namespace cobtree {
+
+// every value in the log is prefixed by this header.
+// a header with len set to UINT64_MAX pads the log until the end of the
+// circular buffer (a record never wraps around).
+struct ValueLogRecordHeader {
+  uint64_t key;
+  uint64_t len;
+};
+
+// an append-only log of values stored on a circular block device.
+// offsets exposed to the user are logical (monotonically increasing); the
+// physical position is offset % capacity. records between head and tail are
+// kept, everything before head has been reclaimed by garbage collection.
+class ValueLog {
+ public:
+  ValueLog() = delete;
+  ValueLog(const std::string& id, uint64_t capacity, Cache* cache)
+    : id_(id), cache_(cache),
+    storage_(new BlockDevice(capacity)),
+    capacity_(BlockDevice::AdjustForBlockSize(BLOCKSIZE, capacity)),
+    head_(0), tail_(0), garbage_bytes_(0) {
+      assert(cache_);
+      assert(capacity_ > sizeof(ValueLogRecordHeader));
+    }
+
+  ~ValueLog() = default;
+
+  static std::string CreateValueLogCacheKey(const std::string& id,
+    uint64_t block_id) {
+    return id + "-vlog" + std::to_string(block_id);
+  }
+
+  // the number of bytes a value of len bytes takes in the log.
+  static uint64_t RecordSize(uint64_t len) {
+    return sizeof(ValueLogRecordHeader) + len;
+  }
+
+  // append the value at the tail. the logical offset of the record is
+  // returned in offset.
+  // return false if there is not enough free space in the log.
+  bool Append(uint64_t key, const std::string& value, uint64_t* offset);
+
+  // read the record at logical offset.
+  // return false if offset is not in [head, tail).
+  bool Read(uint64_t offset, uint64_t* key, std::string* value) const;
+
+  // return the number of value bytes of the record at logical offset.
+  uint64_t ValueLength(uint64_t offset) const;
+
+  // return the logical offset of the oldest record (tail if log is empty).
+  uint64_t FirstRecord() const { return SkipPadding(head_); }
+
+  // return the logical offset of the record following the one at offset.
+  // padding records are skipped.
+  uint64_t NextRecord(uint64_t offset) const;
+
+  // reclaim all the space before new_head. reclaimed_garbage is the number
+  // of garbage bytes the caller found in [head, new_head).
+  void Trim(uint64_t new_head, uint64_t reclaimed_garbage);
+
+  // inform the log that a record of len value bytes is no longer referenced.
+  inline void MarkGarbage(uint64_t len) {
+    garbage_bytes_ += RecordSize(len);
+  }
+
+  inline uint64_t head() const { return head_; }
+  inline uint64_t tail() const { return tail_; }
+  inline uint64_t capacity() const { return capacity_; }
+  inline uint64_t used_bytes() const { return tail_ - head_; }
+  inline uint64_t garbage_bytes() const { return garbage_bytes_; }
+
+ private:
+  // fetch the byte range of the log through the cache, returning the
+  // position in the device buffer. the range must not wrap around.
+  char* Load(uint64_t offset, uint64_t len) const;
+
+  // skip the padding at offset if any.
+  // return the offset of the next real record.
+  uint64_t SkipPadding(uint64_t offset) const;
+
+  const std::string id_;
+  Cache* cache_;
+  std::unique_ptr<BlockDevice> storage_;
+  const uint64_t capacity_; // bytes of the circular buffer
+  uint64_t head_; // logical offset of the oldest record kept
+  uint64_t tail_; // logical offset where the next record is appended
+  // bytes held by records that were overwritten, reclaimed by garbage
+  // collection when it passes them.
+  uint64_t garbage_bytes_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_VALUE_LOG_H_
@@ -13,100 +13,187 @@ struct TreeCopy {
   std::unique_ptr<char[]> tree;
 };
 
-// helper class 
-class vEBTreeForwardIterator;
-class vEBTreeBackwardIterator;
+// the tree state kept in a checkpoint next to the pma layout.
+struct vEBTreeLayout {
+  uint64_t fanout;
+  uint64_t root_address;
+  uint64_t root_height;
+};
 
-class vEBTree {
- public:
-  vEBTree() = delete;
-  vEBTree(uint64_t fanout, uint64_t estimated_unit_count, double pma_redundancy_factor, 
-    const std::string& uid, const PMADensityOption& pma_options, Cache* cache)
-    : fanout_(fanout), node_size_(sizeof(Node) + sizeof(NodeEntry) * fanout_),
-      root_height_(2), // one leaf and one root will be created
-      pma_(uid, node_size_, std::ceil(estimated_unit_count 
-        * pma_redundancy_factor), pma_options, cache),
-      item_per_segment(pma_.segment_size()),
-      root_address_(item_per_segment - 1), // the initial root is at the end of the first segment
-      segment_element_count(pma_.segment_count(), 0) {
-      assert(pma_.segment_size() > 10); // a segment needs to be reasonably large
-      // create the fist leaf
-      std::unique_ptr<char[]> first_leaf_buffer{ new char[node_size_] };
-      std::memset(first_leaf_buffer.get(), -1, node_size_);
-      Node* first_leaf = reinterpret_cast<Node*>(first_leaf_buffer.get());
-      first_leaf->parent_addr = root_address_;
-      first_leaf->height = 1;
-      get_children(first_leaf)->key = 0;
-      auto segment = pma_.Get(0);
-      std::memcpy((segment.content + (item_per_segment - 2) * node_size_),
-        first_leaf_buffer.get(), node_size_);
-
-      // create the root
-      std::unique_ptr<char[]> first_root_buffer{ new char[node_size_] };
-      std:memset(first_root_buffer.get(), -1, node_size_);
-      Node* first_root = reinterpret_cast<Node*>(first_root_buffer.get());
-      first_root->height = 2;
-      auto child = get_children(first_root);
-      child->key = 0; // in out fixed key range of uint64_t 0 is the smallest key.
-      child->addr = item_per_segment - 2;
-      std::memcpy((segment.content + (item_per_segment - 1) * node_size_),
-        first_root_buffer.get(), node_size_);
-      
-      // set the first segment item count to 2;
-      segment_element_count[0] = 2;
-      pma_.vebtree_init_first_segment_count();
-    }
+// a new separator key for a leaf, see vEBTree::UpdateLeafKeys.
+struct LeafKeyUpdate {
+  uint64_t leaf_address;
+  uint64_t parent_address;
+  uint64_t new_key;
+};
 
-  /**
-   * @brief perfrom get in van Emde Boas layout tree. The value returned 
-   *  is from the leaf value that has the largest key smaller than the 
-   *  lookup key.
-   * 
-   * @param key search key 
-   * @param pma_address address in the PMA where vEB Tree is stored
-   * @param match_key if the value returned from a leaf node 
-   *  with matching key
-   * @return uint64_t leaf value
-   */
-  uint64_t Get(uint64_t key, uint64_t* pma_address, 
-    bool* match_key = nullptr);
+// helper class 
+class vEBTreeLeafIterator;
 
-  // first level PMA rebalance can trigger update on the nodes key 
-  //  and its parents separator keys.
-  // an API to return the node is helpful.
+// the state of the tree and the operations that do not depend on the 
+// fanout. the ones walking the children of a node are in vEBTreeImpl.
+class vEBTreeBase {
+ public:
+  vEBTreeBase() = delete;
+  vEBTreeBase(uint64_t fanout, uint64_t estimated_unit_count, 
+    double pma_redundancy_factor, const std::string& uid, 
+    const PMADensityOption& pma_options, Cache* cache);
+  vEBTreeBase(const std::string& uid, const vEBTreeLayout& layout, 
+    const PMALayout& pma_layout, char* segments, uint64_t* item_count,
+    uint64_t* element_count, Cache* cache);
+  virtual ~vEBTreeBase() = default;
+
+  // see vEBTree.
+  virtual uint64_t Get(uint64_t key, uint64_t* pma_address, 
+    bool* match_key) = 0;
+  virtual void GetBatch(const uint64_t* keys, uint64_t count, 
+    uint64_t* values, uint64_t* pma_addresses) = 0;
+  virtual uint64_t GetStep(uint64_t address, uint64_t key, bool* leaf) = 0;
+  virtual bool Insert(uint64_t key, uint64_t value) = 0;
+  virtual void UpdateLeafKeys(const std::vector<LeafKeyUpdate>& updates) = 0;
+
+  inline uint64_t root_address() const { return root_address_; }
+  bool NodeResident(uint64_t address) const;
   Node* GetNode(uint64_t address);
- 
-  bool Insert(uint64_t key, uint64_t value);
+  void PinTop(bool enable);
+  inline uint64_t fanout() const { return fanout_; }
+  inline uint64_t pinned_levels() const { return pinned_levels_; }
+  inline uint64_t repin_count() const { return repin_count_; }
+  inline uint64_t node_split_count() const { return node_split_count_; }
+  inline uint64_t root_split_count() const { return root_split_count_; }
+  inline PMA& pma() { return pma_; }
+  inline const PMA& pma() const { return pma_; }
+  inline vEBTreeLayout layout() const {
+    return vEBTreeLayout{fanout_, root_address_, root_height_};
+  }
+  inline const CountArray& element_count() const {
+    return segment_element_count; }
+
+  void DebugPrintNode(const Node* it) const;
+  void DebugPrintAsPMA() const;
+  void DebugPrintDFS();
 
-  // potentially update its predecessors' keys;
-  void UpdateLeafKey(uint64_t leaf_address, uint64_t parent_address,
-    uint64_t new_key);
-  
   static NodeEntry* get_children(Node* node) {
     return reinterpret_cast<NodeEntry*>(node + 1);
   }
 
-  inline uint64_t fanout() const { return fanout_; }
+  static const NodeEntry* get_children(const Node* node) {
+    return reinterpret_cast<const NodeEntry*>(node + 1);
+  }
 
-  void DebugPrintNode(const Node* it) const;
-  /**
-   * @brief print out the veb tree in the pma layout order to the terminal.
-   * 
-   */
-  void DebugPrintAsPMA() const;
-  
-  /**
-   * @brief print out the veb tree in DFS order to the terminal.
-   * 
-   */
-  void DebugPrintDFS();
+ protected:
+  friend vEBTreeLeafIterator;
+
+  // the address of the node stored right before (lower address) or after
+  // the node at address, skipping the empty slots between segments.
+  uint64_t PrevNodeAddress(uint64_t address) const;
+  uint64_t NextNodeAddress(uint64_t address) const;
+  // the number of nodes stored from address up to from (address <= from),
+  // and the address of the node offset nodes below from.
+  uint64_t NodeOffsetBelow(uint64_t from, uint64_t address) const;
+  uint64_t NodeAddressBelow(uint64_t from, uint64_t offset) const;
+
+  // GetNode for reading only, the node is not marked modified.
+  const Node* LoadNode(uint64_t address) const;
+
+  void PrefetchNode(uint64_t address) const;
+
+  // pin the levels below the root that fit, see PinTop.
+  virtual void RepinTop() = 0;
+
+  // the nodes of the segments in [first_segment, last_segment] were 
+  // shifted: the top is pinned again after the insertion if a pinned block
+  // is among them.
+  void NoteNodesShifted(uint64_t first_segment, uint64_t last_segment);
+
+  // calculate the subtree height for a node at this height in a vEBTree.
+  uint64_t SubtreeHeight(uint64_t height) const ;
+
+  // this essentially move the node stored immediately before this node.
+  inline Node* get_next_node_in_segment(Node* node) const {
+    return reinterpret_cast<Node*>(reinterpret_cast<char*>(node) 
+      - node_size_);
+  }  
+
+  uint64_t fanout_; // 4d
+  // store the parent address and (key and address) of at most 4d children
+  uint64_t node_size_; // 4d * (address size + key size) + address size )
+  uint64_t root_height_; // the height of root node in pma.
+  PMA pma_;
+  uint64_t item_per_segment; // cached pma segment size, in #item
+  uint64_t root_address_; // the position of root node in pma.
+
+  // the segment_element_count can be stored at the leading space in a segment
+  // or we can store it elsewhere and retrieve it with O(1) cost (reading of such information of adjacent segments can amortize cost).
+  // here we store it in memory for simplicity and do not account for the cost of retrieving such information in simulation. (in analysis of the paper, this is not from the dominant term)
+  CountArray segment_element_count;
+
+  bool pin_top_ = false;
+  uint64_t pinned_levels_ = 0;
+  std::set<uint64_t> pinned_blocks_; // pma blocks pinned in the cache
+  // the root when the blocks were pinned, and whether a pinned block was 
+  // shifted since.
+  uint64_t pinned_root_address_ = UINT64_MAX;
+  uint64_t pinned_root_height_ = 0;
+  bool pinned_shifted_ = false;
+  uint64_t repin_count_ = 0;
+
+  uint64_t node_split_count_ = 0;
+  uint64_t root_split_count_ = 0;
+};
+
+// the number of nodes in a complete subtree of height.
+constexpr uint64_t SubtreeNodeCount(uint64_t fanout, uint64_t height) {
+  return (height == 0) ? 0 : 1 + fanout * SubtreeNodeCount(fanout, height - 1);
+}
+
+/**
+ * @brief the insertion and the lookups of the tree, with the fanout known at
+ *  compile time: the loops over the children of a node have a fixed trip 
+ *  count (unrolled into branch free compares for the search) and the 
+ *  subtree sizes are a constant table. kFanout = 0 reads the fanout of the
+ *  tree at runtime, for the fanouts not instantiated (see vEBTree).
+ * 
+ * @tparam kFanout the number of children of a node, 0 if not fixed
+ */
+template <uint64_t kFanout>
+class vEBTreeImpl : public vEBTreeBase {
+ public:
+  using vEBTreeBase::vEBTreeBase;
+
+  uint64_t Get(uint64_t key, uint64_t* pma_address, 
+    bool* match_key) override;
+  void GetBatch(const uint64_t* keys, uint64_t count, uint64_t* values,
+    uint64_t* pma_addresses) override;
+  uint64_t GetStep(uint64_t address, uint64_t key, bool* leaf) override;
+  bool Insert(uint64_t key, uint64_t value) override;
+  void UpdateLeafKeys(const std::vector<LeafKeyUpdate>& updates) override;
+
+ protected:
+  void RepinTop() override;
 
  private:
-  friend vEBTreeForwardIterator;
-  friend vEBTreeBackwardIterator;
   //  TODO: for some helper function, the leaf in overall vEBTree might need special treatment while they are leaf in a context of recursive subtree. needs to check through.
 
+  inline uint64_t fanout() const { 
+    return (kFanout > 0) ? kFanout : fanout_; }
+
+  // the node count of the complete subtrees, by the log2 of their height
+  // (the recursive subtree heights are powers of two).
+  static constexpr uint64_t kSubtreeNodeCount[] = {
+    SubtreeNodeCount(kFanout, 1), SubtreeNodeCount(kFanout, 2),
+    SubtreeNodeCount(kFanout, 4), SubtreeNodeCount(kFanout, 8),
+    SubtreeNodeCount(kFanout, 16), SubtreeNodeCount(kFanout, 32)};
+
+  inline uint64_t subtree_node_count(uint64_t subtree_height) const {
+    if (kFanout == 0) return SubtreeNodeCount(fanout_, subtree_height);
+    assert(__builtin_popcountll(subtree_height) == 1);
+    assert(__builtin_ctzll(subtree_height) < 6);
+    return kSubtreeNodeCount[__builtin_ctzll(subtree_height)];
+  }
+
   // return number of nodes of moved tree. facilitate calculation of the end address.
+  // the nodes are moved in place, the space should have been left for them.
   uint64_t MoveSubtree(uint64_t subtree_root_address, uint64_t height, uint64_t new_address);
 
   // The top part only allows us to differentiate between leaf tree and top part trees during a node split, because this function is used in MoveSubtree as well.
@@ -137,9 +224,6 @@ class vEBTree {
   // return false if pma no space
   bool AddChildToNode(uint64_t node_address, uint64_t child_address, uint64_t child_key);
 
-  // calculate the subtree height for a node at this height in a vEBTree.
-  uint64_t SubtreeHeight(uint64_t height) const ;
-
   // get the children of leaf node of the recursive subtree rooted at node.
   // return empty vector for node at height 1 (leaf of vEBTree) and 2.
   std::vector<uint64_t> GetLeafAddresses(Node* node, uint64_t height);
@@ -152,23 +236,16 @@ class vEBTree {
   // return false if no more space
   bool AddNewRoot(Node* old_root);
 
-
-  inline const NodeEntry* get_children(const Node* node) const {
-    return reinterpret_cast<const NodeEntry*>(node + 1);
-  }
-
-  // this essentially move the node stored immediately before this node.
-  inline Node* get_next_node_in_segment(Node* node) const {
-    return reinterpret_cast<Node*>(reinterpret_cast<char*>(node) 
-      - node_size_);
-  }  
-
   // check whether all node entries are full.
   inline bool children_exceeds_threshold(const Node* node) const {
-    return (get_children(node)+fanout_-1)->addr != UINT64_MAX;
+    return (get_children(node)+fanout()-1)->addr != UINT64_MAX;
   }
 
-  inline uint64_t child_to_search(const Node* node, uint64_t key, bool* match_key = nullptr) {
+  // search the children of a node for the last one with a key not larger
+  // than key. the children are sorted and the empty ones at the end, so 
+  // it is the count of the valid children (after the first) not larger 
+  // than key.
+  inline uint64_t child_to_search(const Node* node, uint64_t key, bool* match_key = nullptr) const {
     // we should not call child_to_search on leaf nodes
     assert(node->height != 1);
 
@@ -178,83 +255,226 @@ class vEBTree {
     // the first child should have a smaller than or equal to the search key
     // by logic of search.s
     assert(child->key <= key);
-    auto it = child;
-    for (; it < child + fanout_; it++) {
-      // next children has larger key or no more nodes
-      if ((it->key > key) || (it->addr == UINT64_MAX)) break;
+    uint64_t idx = 0;
+    for (uint64_t i = 1; i < fanout(); i++) {
+      idx += (child[i].key <= key) & (child[i].addr != UINT64_MAX);
     }
-    // return the child key and address
-    it--;
-    if (match_key) (*match_key) = (key == it->key);
-    return it->addr;
+    if (match_key) (*match_key) = (key == child[idx].key);
+    return child[idx].addr;
   }
-
-  uint64_t fanout_; // 4d
-  // store the parent address and (key and address) of at most 4d children
-  uint64_t node_size_; // 4d * (address size + key size) + address size )
-  uint64_t root_height_; // the height of root node in pma.
-  PMA pma_;
-  uint64_t item_per_segment; // cached pma segment size, in #item
-  uint64_t root_address_; // the position of root node in pma.
-
-  // the segment_element_count can be stored at the leading space in a segment
-  // or we can store it elsewhere and retrieve it with O(1) cost (reading of such information of adjacent segments can amortize cost).
-  // here we store it in memory for simplicity and do not account for the cost of retrieving such information in simulation. (in analysis of the paper, this is not from the dominant term)
-  std::vector<uint64_t> segment_element_count;
 };
 
-class vEBTreeBackwardIterator {
+template <uint64_t kFanout>
+constexpr uint64_t vEBTreeImpl<kFanout>::kSubtreeNodeCount[];
+
+class vEBTree {
  public:
-  vEBTreeBackwardIterator(vEBTree* tree, uint64_t leaf_address)
-    : valid_(true), curr_address_(leaf_address), tree_(tree), 
-    curr_(tree_->GetNode(leaf_address)),
-    curr_parent_address_(curr_->parent_addr) {}
-  
-  bool valid() const { return valid_ && (curr_->height == 1); }
+  vEBTree() = delete;
+  vEBTree(uint64_t fanout, uint64_t estimated_unit_count, double pma_redundancy_factor, 
+    const std::string& uid, const PMADensityOption& pma_options, Cache* cache)
+    : impl_(NewImpl(fanout, estimated_unit_count, pma_redundancy_factor, 
+        uid, pma_options, cache)) {}
 
-  // move to the previous leaf node
-  void Prev();
+  // re-create the tree over the node array and metadata of a mapped 
+  // checkpoint.
+  vEBTree(const std::string& uid, const vEBTreeLayout& layout, 
+    const PMALayout& pma_layout, char* segments, uint64_t* item_count,
+    uint64_t* element_count, Cache* cache)
+    : impl_(NewImpl(uid, layout, pma_layout, segments, item_count, 
+        element_count, cache)) {}
+
+  /**
+   * @brief perfrom get in van Emde Boas layout tree. The value returned 
+   *  is from the leaf value that has the largest key smaller than the 
+   *  lookup key.
+   * 
+   * @param key search key 
+   * @param pma_address address in the PMA where vEB Tree is stored
+   * @param match_key if the value returned from a leaf node 
+   *  with matching key
+   * @return uint64_t leaf value
+   */
+  inline uint64_t Get(uint64_t key, uint64_t* pma_address, 
+    bool* match_key = nullptr) {
+    return impl_->Get(key, pma_address, match_key);
+  }
+
+  /**
+   * @brief Get for count keys. the lookups advance one level at a time in
+   *  groups and the next node of each is prefetched while the others are
+   *  searched, so the cache misses of a group overlap instead of stalling 
+   *  one after another.
+   * 
+   * @param keys search keys
+   * @param count number of keys
+   * @param values leaf values, as returned by Get
+   * @param pma_addresses leaf addresses, as returned by Get
+   */
+  inline void GetBatch(const uint64_t* keys, uint64_t count, 
+    uint64_t* values, uint64_t* pma_addresses) {
+    impl_->GetBatch(keys, count, values, pma_addresses);
+  }
+
+  // Get one node at a time, for lookups that suspend between nodes (see 
+  // AsyncGetScheduler). start at root_address().
+  inline uint64_t root_address() const { return impl_->root_address(); }
+  // if the node at address is in the cache.
+  inline bool NodeResident(uint64_t address) const {
+    return impl_->NodeResident(address); }
+  // load the node at address and return the child to search for key, or
+  // for a leaf its value with leaf set.
+  inline uint64_t GetStep(uint64_t address, uint64_t key, bool* leaf) {
+    return impl_->GetStep(address, key, leaf); }
+
+  // first level PMA rebalance can trigger update on the nodes key 
+  //  and its parents separator keys.
+  // an API to return the node is helpful.
+  inline Node* GetNode(uint64_t address) { return impl_->GetNode(address); }
+ 
+  inline bool Insert(uint64_t key, uint64_t value) {
+    return impl_->Insert(key, value); }
+
+  // potentially update its predecessors' keys;
+  void UpdateLeafKey(uint64_t leaf_address, uint64_t parent_address,
+    uint64_t new_key);
+
+  /**
+   * @brief UpdateLeafKey for many leaves, e.g. all the level 2 segments of
+   *  a rebalance. the updates are applied one level at a time from the 
+   *  leaves up: each ancestor is loaded once for all the leaves below it, 
+   *  and its separator in its own parent is updated once if its first key 
+   *  changed.
+   * 
+   * @param updates the leaves and their new keys, in any order (the last
+   *  one wins for a leaf listed twice)
+   */
+  inline void UpdateLeafKeys(const std::vector<LeafKeyUpdate>& updates) {
+    impl_->UpdateLeafKeys(updates); }
   
-  // check valid() first
-  Node* node() { return curr_; }
+  static NodeEntry* get_children(Node* node) {
+    return vEBTreeBase::get_children(node);
+  }
 
-  uint64_t parent_address() const { return curr_parent_address_; }
+  static const NodeEntry* get_children(const Node* node) {
+    return vEBTreeBase::get_children(node);
+  }
 
-  uint64_t leaf_address() const { return curr_address_; }
+  inline uint64_t fanout() const { return impl_->fanout(); }
+
+  /**
+   * @brief keep the top of the tree (every node of the first levels below
+   *  the root, as many whole levels as fit) pinned in the space the cache 
+   *  reserved with Cache::ReservePinned, so that the nodes every lookup 
+   *  visits do not compete with the lower levels in the FIFO. the pinned 
+   *  blocks are re-evaluated after an insertion that moved or replaced the
+   *  root or shifted the nodes of a pinned block.
+   * 
+   * @param enable false releases the pinned blocks
+   */
+  inline void PinTop(bool enable) { impl_->PinTop(enable); }
+  // the number of pinned levels, 0 if none.
+  inline uint64_t pinned_levels() const { return impl_->pinned_levels(); }
+  // the number of times the pinned blocks were re-evaluated.
+  inline uint64_t repin_count() const { return impl_->repin_count(); }
+
+  // the number of node splits (the root splits included) and of root 
+  // splits since the tree was created.
+  inline uint64_t node_split_count() const { 
+    return impl_->node_split_count(); }
+  inline uint64_t root_split_count() const { 
+    return impl_->root_split_count(); }
+
+  // see PMA::TakeMaxRebalanceHeight.
+  inline int TakeMaxRebalanceHeight() {
+    return impl_->pma().TakeMaxRebalanceHeight(); }
+
+  // checkpoint support. the node array is persisted through the pma.
+  inline const PMA& pma() const { return impl_->pma(); }
+  inline vEBTreeLayout layout() const { return impl_->layout(); }
+  inline const CountArray& element_count() const {
+    return impl_->element_count(); }
+
+  inline void DebugPrintNode(const Node* it) const { 
+    impl_->DebugPrintNode(it); }
+  /**
+   * @brief print out the veb tree in the pma layout order to the terminal.
+   * 
+   */
+  inline void DebugPrintAsPMA() const { impl_->DebugPrintAsPMA(); }
+  
+  /**
+   * @brief print out the veb tree in DFS order to the terminal.
+   * 
+   */
+  inline void DebugPrintDFS() { impl_->DebugPrintDFS(); }
 
  private:
-  bool valid_;
-  uint64_t curr_address_;
-  vEBTree* tree_;
-  Node* curr_;
-  uint64_t curr_parent_address_;
+  friend vEBTreeLeafIterator;
+
+  // the vEBTreeImpl for the fanout: 4, 8 and 16 are instantiated, the 
+  // others take the fanout at runtime.
+  static std::unique_ptr<vEBTreeBase> NewImpl(uint64_t fanout, 
+    uint64_t estimated_unit_count, double pma_redundancy_factor, 
+    const std::string& uid, const PMADensityOption& pma_options, 
+    Cache* cache);
+  static std::unique_ptr<vEBTreeBase> NewImpl(const std::string& uid, 
+    const vEBTreeLayout& layout, const PMALayout& pma_layout, char* segments,
+    uint64_t* item_count, uint64_t* element_count, Cache* cache);
+
+  std::unique_ptr<vEBTreeBase> impl_;
 };
 
-class vEBTreeForwardIterator {
+// walks the leaves of the tree in key order. it keeps the path from the
+// root (the child taken in each ancestor), so a step climbs only to the 
+// nearest ancestor with a child on that side and descends from there: a
+// walk over n leaves loads O(n) nodes, the ancestors being shared.
+class vEBTreeLeafIterator {
  public:
-  vEBTreeForwardIterator(vEBTree* tree, uint64_t leaf_address)
-    : valid_(true), curr_address_(leaf_address), tree_(tree), 
-    curr_(tree_->GetNode(leaf_address)),
-    curr_parent_address_(curr_->parent_addr) {}
+  vEBTreeLeafIterator(vEBTree* tree, uint64_t leaf_address);
   
   bool valid() const { return valid_ && (curr_->height == 1); }
 
-  // move to the next leaf node
-  void Next();
-
   // check valid() first
-  Node* node() { return curr_; }
+  const Node* node() const { return curr_; }
+
+  uint64_t parent_address() const { return ancestors_.back().address; }
 
-  uint64_t parent_address() const { return curr_parent_address_; }
-  
   uint64_t leaf_address() const { return curr_address_; }
 
+ protected:
+  // move to the next (forward) or the previous leaf. the iterator becomes 
+  // invalid past the last or the first leaf.
+  void Step(bool forward);
+
  private:
+  struct Ancestor {
+    uint64_t address;
+    uint64_t child_idx; // the child on the path to the current leaf
+  };
+
   bool valid_;
   uint64_t curr_address_;
-  vEBTree* tree_;
-  Node* curr_;
-  uint64_t curr_parent_address_;
+  const vEBTreeBase* tree_;
+  const Node* curr_;
+  std::vector<Ancestor> ancestors_; // from the root to the leaf parent
+};
+
+class vEBTreeBackwardIterator : public vEBTreeLeafIterator {
+ public:
+  vEBTreeBackwardIterator(vEBTree* tree, uint64_t leaf_address)
+    : vEBTreeLeafIterator(tree, leaf_address) {}
+
+  // move to the previous leaf node
+  void Prev() { Step(false); }
+};
+
+class vEBTreeForwardIterator : public vEBTreeLeafIterator {
+ public:
+  vEBTreeForwardIterator(vEBTree* tree, uint64_t leaf_address)
+    : vEBTreeLeafIterator(tree, leaf_address) {}
+
+  // move to the next leaf node
+  void Next() { Step(true); }
 };
 
 }  // namespace cobtree
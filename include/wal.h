@@ -0,0 +1,101 @@
+#ifndef COBTREE_WAL_H_
+#define COBTREE_WAL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cobtree {
+
+enum WALRecordType : uint64_t {
+  kWALInsert = 1,
+  kWALDelete = 2,
+  kWALCheckpoint = 3, // all records up to lsn are covered by a checkpoint
+};
+
+// fixed size logical record. checksum covers the other fields so that a
+// torn write at the tail of the log is detected and ignored on replay.
+struct WALRecord {
+  uint64_t lsn;
+  uint64_t type;
+  uint64_t key;
+  uint64_t value;
+  uint64_t checksum;
+};
+
+// append-only log file of logical operations.
+// Append only buffers the record in memory. Commit makes every record up to
+// an lsn durable; concurrent committers are grouped so that one writer
+// (the leader) issues a single write and fsync for all of them.
+class WriteAheadLog {
+ public:
+  WriteAheadLog() = delete;
+  // open the log at path, creating it if it does not exist. the next lsn
+  // continues after the last valid record in the file.
+  explicit WriteAheadLog(const std::string& path);
+  ~WriteAheadLog();
+
+  WriteAheadLog(const WriteAheadLog&) = delete;
+  WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+  inline bool ok() const { return fd_ >= 0; }
+
+  // buffer a record and return its lsn.
+  uint64_t Append(WALRecordType type, uint64_t key, uint64_t value);
+
+  // block until every record up to lsn is durable.
+  // return false on io error.
+  bool Commit(uint64_t lsn);
+
+  // drop all records and restart the file with a checkpoint record at
+  // checkpoint_lsn. the caller guarantees that no record with a larger
+  // lsn has been appended.
+  // return false on io error.
+  bool Truncate(uint64_t checkpoint_lsn);
+
+  /**
+   * @brief replay the records following the last checkpoint record whose
+   *  lsn is larger than from_lsn, in lsn order. replay stops at the first
+   *  torn record.
+   *
+   * @param from_lsn records with lsn <= from_lsn are skipped
+   * @param apply called for every replayed record
+   * @return uint64_t number of records replayed
+   */
+  uint64_t Replay(uint64_t from_lsn,
+    const std::function<void(const WALRecord&)>& apply) const;
+
+  inline uint64_t last_lsn() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return next_lsn_ - 1;
+  }
+
+  // number of fsync issued. with group commit it is smaller than the
+  // number of commits.
+  inline uint64_t sync_count() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return sync_count_;
+  }
+
+  static uint64_t Checksum(const WALRecord& record);
+
+ private:
+  // read all the valid records in the file.
+  std::vector<WALRecord> ReadAll() const;
+
+  const std::string path_;
+  int fd_;
+  std::mutex mu_;
+  std::condition_variable flushed_cv_;
+  std::vector<WALRecord> pending_; // appended but not yet written
+  uint64_t next_lsn_;
+  uint64_t durable_lsn_;
+  bool flushing_; // a leader is writing a group
+  uint64_t sync_count_;
+};
+
+}  // namespace cobtree
+#endif  // COBTREE_WAL_H_
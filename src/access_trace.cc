@@ -0,0 +1,221 @@
+#include "access_trace.h"
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <list>
+#include <set>
+#include <unistd.h>
+#include <utility>
+
+namespace cobtree {
+
+namespace {
+
+const char kAccessTraceMagic[8] = {'C', 'O', 'B', 'T', 'R', 'A', 'C', 'E'};
+const uint64_t kAccessTraceBufferSize = 1 << 20;
+
+enum AccessTraceKind : uint64_t {
+  kTraceRead = 0,
+  kTraceWrite = 1,
+  kTraceDevice = 2,
+};
+
+// return false at the end of the data or on a truncated varint.
+bool GetVarint(const std::string& data, uint64_t* pos, uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; (shift < 64) && (*pos < data.size()); shift += 7) {
+    auto byte = static_cast<uint8_t>(data[(*pos)++]);
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+AccessTraceWriter::AccessTraceWriter(const std::string& path)
+  : fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+  record_count_(0) {
+  buffer_.reserve(kAccessTraceBufferSize);
+  buffer_.append(kAccessTraceMagic, sizeof(kAccessTraceMagic));
+}
+
+AccessTraceWriter::~AccessTraceWriter() {
+  if (fd_ < 0) return;
+  Flush();
+  ::close(fd_);
+}
+
+void AccessTraceWriter::PutVarint(uint64_t value) {
+  while (value >= 0x80) {
+    buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  buffer_.push_back(static_cast<char>(value));
+}
+
+void AccessTraceWriter::Record(const std::string& device, bool write,
+  uint64_t segment_id, uint64_t offset, uint64_t len) {
+  // nowhere to write, do not buffer the records forever.
+  if (!ok()) return;
+  auto it = devices_.find(device);
+  if (it == devices_.end()) {
+    it = devices_.emplace(device, devices_.size()).first;
+    PutVarint((static_cast<uint64_t>(it->second) << 2) | kTraceDevice);
+    PutVarint(device.size());
+    buffer_.append(device);
+  }
+  PutVarint((static_cast<uint64_t>(it->second) << 2)
+    | (write ? kTraceWrite : kTraceRead));
+  PutVarint(segment_id);
+  PutVarint(offset);
+  PutVarint(len);
+  record_count_++;
+  if (buffer_.size() >= kAccessTraceBufferSize) Flush();
+}
+
+bool AccessTraceWriter::Flush() {
+  if (fd_ < 0) return false;
+  uint64_t done = 0;
+  while (done < buffer_.size()) {
+    auto written = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+    if (written < 0) return false;
+    done += written;
+  }
+  buffer_.clear();
+  return true;
+}
+
+bool ReadAccessTrace(const std::string& path,
+  std::vector<std::string>* devices, std::vector<AccessTraceRecord>* records) {
+  assert(devices);
+  assert(records);
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  std::string data;
+  char chunk[1 << 16];
+  ssize_t read_len;
+  while ((read_len = ::read(fd, chunk, sizeof(chunk))) > 0) {
+    data.append(chunk, read_len);
+  }
+  ::close(fd);
+  if ((read_len < 0) || (data.size() < sizeof(kAccessTraceMagic))
+    || (std::memcmp(data.data(), kAccessTraceMagic,
+      sizeof(kAccessTraceMagic)) != 0)) {
+    return false;
+  }
+
+  uint64_t pos = sizeof(kAccessTraceMagic);
+  uint64_t tag;
+  while (GetVarint(data, &pos, &tag)) {
+    auto device = tag >> 2;
+    if ((tag & 3) == kTraceDevice) {
+      uint64_t name_len;
+      if (!GetVarint(data, &pos, &name_len)
+        || (pos + name_len > data.size())) break;
+      if (device != devices->size()) return false; // defined out of order
+      devices->push_back(data.substr(pos, name_len));
+      pos += name_len;
+      continue;
+    }
+    AccessTraceRecord record;
+    record.device = device;
+    record.write = ((tag & 3) == kTraceWrite);
+    if (!GetVarint(data, &pos, &record.segment_id)
+      || !GetVarint(data, &pos, &record.offset)
+      || !GetVarint(data, &pos, &record.len)) break;
+    if (device >= devices->size()) return false;
+    records->push_back(record);
+  }
+  return true;
+}
+
+ReplayResult ReplayAccessTrace(const std::vector<AccessTraceRecord>& records,
+  ReplacementPolicy policy, uint64_t cache_size, uint64_t block_size) {
+  assert(block_size > 0);
+  auto capacity = cache_size / block_size;
+  assert(capacity > 0);
+
+  // expand the accesses to blocks, the device in the top 16 bits.
+  std::vector<std::pair<uint64_t, bool>> blocks;
+  for (const auto& record : records) {
+    if (record.len == 0) continue;
+    auto last = (record.offset + record.len - 1) / block_size;
+    for (auto block = record.offset / block_size; block <= last; block++) {
+      assert(block < (1ULL << 48));
+      blocks.emplace_back((static_cast<uint64_t>(record.device) << 48)
+        | block, record.write);
+    }
+  }
+
+  ReplayResult result{blocks.size(), 0, 0};
+  std::unordered_map<uint64_t, bool> dirty; // the resident blocks
+  auto evict = [&](uint64_t block) {
+    auto it = dirty.find(block);
+    assert(it != dirty.end());
+    if (it->second) result.writeback_count++;
+    dirty.erase(it);
+  };
+
+  if (policy == kReplaceBelady) {
+    // the position of the next access of the same block.
+    std::vector<uint64_t> next_use(blocks.size());
+    std::unordered_map<uint64_t, uint64_t> upcoming;
+    for (auto i = blocks.size(); i > 0; i--) {
+      auto found = upcoming.find(blocks[i - 1].first);
+      next_use[i - 1] = (found == upcoming.end()) ? UINT64_MAX
+        : found->second;
+      upcoming[blocks[i - 1].first] = i - 1;
+    }
+    // the resident blocks by their next access, the furthest last.
+    std::set<std::pair<uint64_t, uint64_t>> by_next_use;
+    for (uint64_t i = 0; i < blocks.size(); i++) {
+      auto block = blocks[i].first;
+      if (dirty.count(block) > 0) {
+        // it was keyed by this access.
+        by_next_use.erase(std::make_pair(i, block));
+      } else {
+        result.miss_count++;
+        if (dirty.size() == capacity) {
+          auto victim = std::prev(by_next_use.end());
+          evict(victim->second);
+          by_next_use.erase(victim);
+        }
+        dirty[block] = false;
+      }
+      dirty[block] = dirty[block] || blocks[i].second;
+      by_next_use.emplace(next_use[i], block);
+    }
+  } else {
+    // the resident blocks in eviction order, the next victim first.
+    std::list<uint64_t> order;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> position;
+    for (const auto& access : blocks) {
+      auto block = access.first;
+      auto found = position.find(block);
+      if (found != position.end()) {
+        if (policy == kReplaceLRU) {
+          order.splice(order.end(), order, found->second);
+        }
+      } else {
+        result.miss_count++;
+        if (position.size() == capacity) {
+          evict(order.front());
+          position.erase(order.front());
+          order.pop_front();
+        }
+        position[block] = order.insert(order.end(), block);
+        dirty[block] = false;
+      }
+      dirty[block] = dirty[block] || access.second;
+    }
+  }
+  return result;
+}
+
+}  // namespace cobtree
@@ -0,0 +1,96 @@
+#include "async_get.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace cobtree {
+
+ThreadPoolReadDevice::ThreadPoolReadDevice(uint64_t thread_count,
+  uint64_t latency_us) : latency_us_(latency_us), stop_(false) {
+  assert(thread_count > 0);
+  for (uint64_t i = 0; i < thread_count; i++) {
+    workers_.emplace_back(&ThreadPoolReadDevice::Work, this);
+  }
+}
+
+ThreadPoolReadDevice::~ThreadPoolReadDevice() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  request_cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPoolReadDevice::Submit(uint64_t token) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    requests_.push_back(token);
+  }
+  request_cv_.notify_one();
+}
+
+uint64_t ThreadPoolReadDevice::WaitCompletion() {
+  std::unique_lock<std::mutex> lock(mu_);
+  completion_cv_.wait(lock, [this] { return !completions_.empty(); });
+  auto token = completions_.front();
+  completions_.pop_front();
+  return token;
+}
+
+void ThreadPoolReadDevice::Work() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    request_cv_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+    if (stop_) return;
+    auto token = requests_.front();
+    requests_.pop_front();
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::microseconds(latency_us_));
+    lock.lock();
+    completions_.push_back(token);
+    completion_cv_.notify_one();
+  }
+}
+
+void AsyncGetScheduler::Submit(uint64_t key, AsyncGetCallback callback) {
+  AsyncGetState lookup;
+  lookup.key = key;
+  lookup.stage = kAsyncGetStart;
+  lookup.read_done = false;
+  lookup.found = false;
+  lookup.value = 0;
+  ready_.push_back(lookups_.size());
+  lookups_.push_back(lookup);
+  callbacks_.push_back(std::move(callback));
+}
+
+void AsyncGetScheduler::Run() {
+  uint64_t in_flight = 0;
+  while (!ready_.empty() || (in_flight > 0)) {
+    while (!ready_.empty()) {
+      auto id = ready_.front();
+      ready_.pop_front();
+      auto& lookup = lookups_[id];
+      if (tree_->AdvanceAsyncGet(&lookup, &restart_count_)) {
+        callbacks_[id](lookup.key, lookup.found, lookup.value);
+        continue;
+      }
+      // suspended on a missing block.
+      device_->Submit(id);
+      suspend_count_++;
+      in_flight++;
+      max_in_flight_ = std::max(max_in_flight_, in_flight);
+    }
+    if (in_flight == 0) break;
+    auto id = device_->WaitCompletion();
+    in_flight--;
+    lookups_[id].read_done = true;
+    ready_.push_back(id);
+  }
+  lookups_.clear();
+  callbacks_.clear();
+}
+
+}  // namespace cobtree
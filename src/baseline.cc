@@ -0,0 +1,361 @@
+#include "baseline.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace cobtree {
+
+namespace {
+
+// report the access of [offset, offset+len) of the device id and count
+// the transfers of the blocks (of the stats block size) holding it, then
+// return the position in the device buffer.
+char* LoadRange(BlockDevice* storage, Cache* cache, uint64_t offset,
+  uint64_t len, const std::string& id) {
+  auto block_size = cache->block_size_for_stats();
+  cache->RecordAccess(id, offset / block_size, offset, len, false);
+  cache->AccessRange(id, offset, len);
+  char* ptr;
+  storage->Read(offset, len, &ptr);
+  return ptr;
+}
+
+// the position of the last entry with a key not larger than key, 0 if
+// every key is larger. (for internal nodes: the child to descend to)
+uint64_t FindChild(const L3Node* entries, uint64_t count, uint64_t key) {
+  auto it = std::upper_bound(entries, entries + count, key,
+    [](uint64_t k, const L3Node& e) { return k < e.key; });
+  return (it == entries) ? 0 : (it - entries) - 1;
+}
+
+}  // anonymous namespace
+
+BPlusTree::BPlusTree(const std::string& id, uint64_t estimated_record_count,
+  Cache* cache)
+  : id_(id), cache_(cache),
+  node_size_(std::max<uint64_t>(cache->block_size_for_stats(),
+    sizeof(BPlusTreeNodeHeader) + 4 * sizeof(L3Node))),
+  node_capacity_((node_size_ - sizeof(BPlusTreeNodeHeader)) / sizeof(L3Node)),
+  // nodes are at least half full: leaves and, with a fanout of at least
+  // half the capacity, fewer internal nodes than leaves.
+  max_node_count_(4 * (estimated_record_count / (node_capacity_ / 2) + 1)),
+  storage_(new BlockDevice(node_size_, max_node_count_ * node_size_)),
+  node_count_(1), root_(0), height_(1) {
+  assert(cache_);
+  assert(node_capacity_ >= 4);
+  auto root = LoadNode(root_);
+  *header(root) = BPlusTreeNodeHeader{1, 0, UINT64_MAX};
+}
+
+char* BPlusTree::LoadNode(uint64_t node_id) const {
+  assert(node_id < max_node_count_);
+  return LoadRange(storage_.get(), cache_, node_id * node_size_,
+    node_size_, id_);
+}
+
+uint64_t BPlusTree::FindLeaf(uint64_t key,
+  std::vector<uint64_t>* path) const {
+  auto node_id = root_;
+  auto node = LoadNode(node_id);
+  while (!header(node)->leaf) {
+    if (path) path->push_back(node_id);
+    auto pos = FindChild(entries(node), header(node)->count, key);
+    node_id = entries(node)[pos].value;
+    node = LoadNode(node_id);
+  }
+  return node_id;
+}
+
+bool BPlusTree::Get(uint64_t key, uint64_t* value) {
+  assert(value);
+  auto leaf = LoadNode(FindLeaf(key, nullptr));
+  auto count = header(leaf)->count;
+  auto begin = entries(leaf);
+  auto it = std::lower_bound(begin, begin + count, key,
+    [](const L3Node& e, uint64_t k) { return e.key < k; });
+  if ((it == begin + count) || (it->key != key)) return false;
+  *value = it->value;
+  return true;
+}
+
+bool BPlusTree::Insert(uint64_t key, uint64_t value) {
+  std::vector<uint64_t> path;
+  auto node_id = FindLeaf(key, &path);
+  L3Node item{key, value};
+  while (true) {
+    auto node = LoadNode(node_id);
+    auto count = header(node)->count;
+    auto begin = entries(node);
+    auto it = std::lower_bound(begin, begin + count, item.key,
+      [](const L3Node& e, uint64_t k) { return e.key < k; });
+    if (header(node)->leaf && (it != begin + count) && (it->key == key)) {
+      it->value = value; // update in place
+      return true;
+    }
+    if (count < node_capacity_) {
+      std::memmove(it + 1, it, (begin + count - it) * sizeof(L3Node));
+      *it = item;
+      header(node)->count++;
+      return true;
+    }
+
+    // split: the upper half moves to a new right sibling.
+    if (node_count_ == max_node_count_) {
+      printf("b+-tree full");
+      return false;
+    }
+    std::vector<L3Node> merged(begin, begin + count);
+    merged.insert(merged.begin() + (it - begin), item);
+    auto right_id = node_count_++;
+    auto right = LoadNode(right_id);
+    node = LoadNode(node_id); // may have been evicted, reload it
+    auto left_count = merged.size() / 2;
+    auto right_count = merged.size() - left_count;
+    *header(right) = BPlusTreeNodeHeader{header(node)->leaf, right_count,
+      header(node)->next};
+    std::memcpy(entries(right), merged.data() + left_count,
+      right_count * sizeof(L3Node));
+    header(node)->count = left_count;
+    if (header(node)->leaf) header(node)->next = right_id;
+    std::memcpy(entries(node), merged.data(), left_count * sizeof(L3Node));
+    item = L3Node{entries(right)[0].key, right_id};
+
+    if (path.empty()) {
+      // the root split, grow the tree by one level.
+      if (node_count_ == max_node_count_) {
+        printf("b+-tree full");
+        return false;
+      }
+      auto root_id = node_count_++;
+      auto root = LoadNode(root_id);
+      *header(root) = BPlusTreeNodeHeader{0, 2, UINT64_MAX};
+      // the first child takes every key smaller than the separator. its
+      // smallest key would go stale once smaller keys are inserted.
+      entries(root)[0] = L3Node{0, node_id};
+      entries(root)[1] = item;
+      root_ = root_id;
+      height_++;
+      return true;
+    }
+    node_id = path.back();
+    path.pop_back();
+  }
+}
+
+uint64_t BPlusTree::Scan(uint64_t start_key, uint64_t end_key,
+  std::vector<L3Node>* records) {
+  assert(records);
+  uint64_t count = 0;
+  auto node_id = FindLeaf(start_key, nullptr);
+  while (node_id != UINT64_MAX) {
+    auto leaf = LoadNode(node_id);
+    for (uint64_t i = 0; i < header(leaf)->count; i++) {
+      auto& record = entries(leaf)[i];
+      if (record.key < start_key) continue;
+      if (record.key > end_key) return count;
+      records->push_back(record);
+      count++;
+    }
+    node_id = header(leaf)->next;
+  }
+  return count;
+}
+
+SortedArray::SortedArray(const std::string& id,
+  uint64_t estimated_record_count, Cache* cache)
+  : id_(id), cache_(cache), capacity_(estimated_record_count),
+  storage_(new BlockDevice(capacity_ * sizeof(L3Node))), size_(0) {
+  assert(cache_);
+}
+
+L3Node* SortedArray::Load(uint64_t pos, uint64_t count) const {
+  return reinterpret_cast<L3Node*>(LoadRange(storage_.get(), cache_,
+    pos * sizeof(L3Node), count * sizeof(L3Node), id_));
+}
+
+uint64_t SortedArray::LowerBound(uint64_t key) const {
+  uint64_t left = 0;
+  uint64_t right = size_;
+  while (left < right) {
+    auto mid = left + (right - left) / 2;
+    if (Load(mid, 1)->key < key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+bool SortedArray::Get(uint64_t key, uint64_t* value) {
+  assert(value);
+  auto pos = LowerBound(key);
+  if (pos == size_) return false;
+  auto record = Load(pos, 1);
+  if (record->key != key) return false;
+  *value = record->value;
+  return true;
+}
+
+bool SortedArray::Insert(uint64_t key, uint64_t value) {
+  auto pos = LowerBound(key);
+  if (pos < size_) {
+    auto record = Load(pos, 1);
+    if (record->key == key) {
+      record->value = value;
+      return true;
+    }
+  }
+  if (size_ == capacity_) {
+    printf("sorted array full");
+    return false;
+  }
+  // every block from the insertion point to the end is rewritten.
+  auto tail = Load(pos, size_ + 1 - pos);
+  std::memmove(tail + 1, tail, (size_ - pos) * sizeof(L3Node));
+  *tail = L3Node{key, value};
+  size_++;
+  return true;
+}
+
+uint64_t SortedArray::Scan(uint64_t start_key, uint64_t end_key,
+  std::vector<L3Node>* records) {
+  assert(records);
+  uint64_t count = 0;
+  for (auto pos = LowerBound(start_key); pos < size_; pos++) {
+    auto record = Load(pos, 1);
+    if (record->key > end_key) break;
+    records->push_back(*record);
+    count++;
+  }
+  return count;
+}
+
+EytzingerArray::EytzingerArray(const std::string& id,
+  uint64_t estimated_record_count, uint64_t buffer_capacity, Cache* cache)
+  : id_(id), cache_(cache), capacity_(estimated_record_count),
+  buffer_capacity_(std::max<uint64_t>(buffer_capacity, 1)),
+  // position 0 is unused.
+  storage_(new BlockDevice((capacity_ + 1) * sizeof(L3Node))), size_(0) {
+  assert(cache_);
+}
+
+L3Node* EytzingerArray::Load(uint64_t pos, uint64_t count) const {
+  return reinterpret_cast<L3Node*>(LoadRange(storage_.get(), cache_,
+    pos * sizeof(L3Node), count * sizeof(L3Node), id_));
+}
+
+uint64_t EytzingerArray::Successor(uint64_t pos) const {
+  if (2 * pos + 1 <= size_) {
+    // the leftmost position in the right subtree
+    pos = 2 * pos + 1;
+    while (2 * pos <= size_) pos = 2 * pos;
+    return pos;
+  }
+  // up to the first ancestor we are in the left subtree of
+  while (pos & 1) pos >>= 1;
+  return pos >> 1;
+}
+
+bool EytzingerArray::Get(uint64_t key, uint64_t* value) {
+  assert(value);
+  auto buffered = buffer_.find(key);
+  if (buffered != buffer_.end()) {
+    *value = buffered->second;
+    return true;
+  }
+  uint64_t pos = 1;
+  while (pos <= size_) {
+    auto record = Load(pos, 1);
+    if (record->key == key) {
+      *value = record->value;
+      return true;
+    }
+    pos = 2 * pos + (record->key < key);
+  }
+  return false;
+}
+
+bool EytzingerArray::Insert(uint64_t key, uint64_t value) {
+  buffer_[key] = value;
+  if (buffer_.size() < buffer_capacity_) return true;
+  return Rebuild();
+}
+
+bool EytzingerArray::Rebuild() {
+  if (buffer_.empty()) return true;
+  // read the array in key order and merge the buffer in (buffer wins).
+  std::vector<L3Node> sorted;
+  sorted.reserve(size_ + buffer_.size());
+  auto array = Load(0, size_ + 1);
+  auto buffered = buffer_.begin();
+  uint64_t pos = 1;
+  while (2 * pos <= size_) pos = 2 * pos;
+  if (size_ == 0) pos = 0;
+  while ((pos != 0) || (buffered != buffer_.end())) {
+    if ((buffered != buffer_.end())
+      && ((pos == 0) || (buffered->first <= array[pos].key))) {
+      if ((pos != 0) && (buffered->first == array[pos].key)) {
+        pos = Successor(pos);
+      }
+      sorted.push_back(L3Node{buffered->first, buffered->second});
+      buffered++;
+    } else {
+      sorted.push_back(array[pos]);
+      pos = Successor(pos);
+    }
+  }
+  if (sorted.size() > capacity_) {
+    printf("eytzinger array full");
+    return false;
+  }
+
+  // write back in breadth-first order: an in-order walk of the implicit
+  // tree assigns the records in key order.
+  std::vector<L3Node> layout(sorted.size() + 1);
+  size_ = sorted.size();
+  uint64_t next = 0;
+  pos = 1;
+  while (2 * pos <= size_) pos = 2 * pos;
+  for (; pos != 0; pos = Successor(pos)) layout[pos] = sorted[next++];
+  assert(next == size_);
+  Load(0, size_ + 1);
+  storage_->Write(reinterpret_cast<const char*>(layout.data() + 1),
+    sizeof(L3Node), size_ * sizeof(L3Node));
+  buffer_.clear();
+  return true;
+}
+
+uint64_t EytzingerArray::Scan(uint64_t start_key, uint64_t end_key,
+  std::vector<L3Node>* records) {
+  assert(records);
+  // the lower bound: descend, then undo the trailing right turns.
+  uint64_t pos = 1;
+  while (pos <= size_) pos = 2 * pos + (Load(pos, 1)->key < start_key);
+  pos >>= __builtin_ffsll(~pos);
+
+  uint64_t count = 0;
+  auto buffered = buffer_.lower_bound(start_key);
+  while (true) {
+    auto record = (pos != 0) ? Load(pos, 1) : nullptr;
+    auto array_done = (record == nullptr) || (record->key > end_key);
+    auto buffer_done = (buffered == buffer_.end())
+      || (buffered->first > end_key);
+    if (array_done && buffer_done) break;
+    if (!buffer_done && (array_done || (buffered->first <= record->key))) {
+      if (!array_done && (buffered->first == record->key)) {
+        pos = Successor(pos);
+      }
+      records->push_back(L3Node{buffered->first, buffered->second});
+      buffered++;
+    } else {
+      records->push_back(*record);
+      pos = Successor(pos);
+    }
+    count++;
+  }
+  return count;
+}
+
+}  // namespace cobtree
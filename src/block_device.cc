@@ -1,4 +1,8 @@
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "block_device.h"
 
 namespace cobtree {
@@ -6,14 +10,35 @@ namespace cobtree {
 // return the number of bytes read
 uint64_t BlockDevice::Read(uint64_t offset, uint64_t len, 
   char** ret) {
-  *ret = buffer_.get() + offset;
+  *ret = data_ + offset;
   return (offset + len > buffer_size_) ? (buffer_size_ - offset) : len; 
 }
 
 void BlockDevice::Write(const char* data, uint64_t offset, 
   uint64_t len) {
   if (offset + len > buffer_size_) return; // no op if exceeds the buffer space
-  std::memcpy(buffer_.get() + offset, data, len);
+  std::memcpy(data_ + offset, data, len);
+}
+
+MappedFile::MappedFile(const std::string& path) 
+  : data_(nullptr), size_(0) {
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if ((::fstat(fd, &st) == 0) && (st.st_size > 0)) {
+    auto ptr = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, 
+      MAP_PRIVATE, fd, 0);
+    if (ptr != MAP_FAILED) {
+      data_ = static_cast<char*>(ptr);
+      size_ = st.st_size;
+    }
+  }
+  // the mapping stays valid after the descriptor is closed.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) ::munmap(data_, size_);
 }
 
 }  // namespace cobtree
\ No newline at end of file
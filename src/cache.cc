@@ -4,21 +4,103 @@
 namespace cobtree {
 
 void Cache::Add(const std::string& id, char* src, uint64_t len) {
-  assert(len < size_);
+  assert(len < size_ - pinned_capacity_);
   if (Exist(id)) return;
-  while (usage_ + len > size_) {
+  EvictFor(len);
+
+  fifo_list_.push_back(id);
+  contents_[id].FillContent(src, len);
+  block_transfer_count_ += (len - 1) / block_transfer_size_ + 1;
+  usage_ += len;
+}
+
+void Cache::AccessRange(const std::string& device, uint64_t offset,
+  uint64_t len) {
+  if (len == 0) return;
+  auto last_block = (offset + len - 1) / block_transfer_size_;
+  for (auto block = offset / block_transfer_size_; block <= last_block;
+    block++) {
+    auto cache_key = CreateRangeCacheKey(device, block);
+    if (!Exist(cache_key)) Add(cache_key, nullptr, block_transfer_size_);
+  }
+}
+
+uint32_t Cache::TraceDevice(const std::string& device) {
+  assert(tracer_);
+  auto it = trace_devices_.find(device);
+  if (it != trace_devices_.end()) return it->second;
+  auto id = tracer_->DeviceId(device);
+  trace_devices_.emplace(device, id);
+  return id;
+}
+
+void Cache::EvictFor(uint64_t len) {
+  while (usage_ + len > size_ - pinned_capacity_) {
     const std::string& block_to_delete = fifo_list_.front();
     auto deleted_size = contents_[block_to_delete].len();
     usage_ -= deleted_size;
     block_transfer_count_ += (deleted_size - 1) / block_transfer_size_ + 1;
+    // the device is the key up to the block id.
+    COBTREE_TRACE_INSTANT(tracer_, kTraceCacheEvict, 
+      TraceDevice(block_to_delete.substr(0, block_to_delete.rfind('@'))),
+      deleted_size, usage_);
     contents_.erase(block_to_delete);    
     fifo_list_.pop_front();
   }
+}
 
-  fifo_list_.push_back(id);
-  contents_[id].FillContent(src, len);
-  block_transfer_count_ += (len - 1) / block_transfer_size_ + 1;
-  usage_ += len;
+void Cache::ReservePinned(uint64_t bytes) {
+  assert(bytes < size_);
+  pinned_capacity_ = bytes;
+  block_transfer_count_ += pinned_.size();
+  pinned_.clear();
+  EvictFor(0);
+}
+
+bool Cache::PinBlock(const std::string& device, uint64_t block_id) {
+  auto cache_key = CreateRangeCacheKey(device, block_id);
+  if (pinned_.find(cache_key) != pinned_.end()) return true;
+  if ((pinned_.size() + 1) * block_transfer_size_ > pinned_capacity_) {
+    return false;
+  }
+  auto it = contents_.find(cache_key);
+  if (it != contents_.end()) {
+    // move it out of the FIFO.
+    usage_ -= it->second.len();
+    contents_.erase(it);
+    fifo_list_.remove(cache_key);
+  } else {
+    block_transfer_count_++;
+  }
+  pinned_.insert(cache_key);
+  return true;
+}
+
+void Cache::UnpinBlock(const std::string& device, uint64_t block_id) {
+  if (pinned_.erase(CreateRangeCacheKey(device, block_id)) > 0) {
+    block_transfer_count_++;
+  }
+}
+
+void Cache::UnpinDevice(const std::string& device) {
+  // the keys of a device are contiguous in key order.
+  auto prefix = device + "@";
+  auto it = pinned_.lower_bound(prefix);
+  while ((it != pinned_.end()) && (it->compare(0, prefix.size(), prefix) == 0)) {
+    block_transfer_count_++;
+    it = pinned_.erase(it);
+  }
+}
+
+bool Cache::Resident(const std::string& device, uint64_t offset,
+  uint64_t len) const {
+  if (len == 0) return true;
+  auto last_block = (offset + len - 1) / block_transfer_size_;
+  for (auto block = offset / block_transfer_size_; block <= last_block;
+    block++) {
+    if (!Exist(CreateRangeCacheKey(device, block))) return false;
+  }
+  return true;
 }
 
 }  // namespace cobtree
\ No newline at end of file
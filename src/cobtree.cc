@@ -1,6 +1,12 @@
 #include "cobtree.h"
+#include "async_get.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace cobtree {
 
@@ -10,51 +16,54 @@ struct L2GetReturn {
   uint64_t l3_segment_id;
 };
 
-L2GetReturn GetL2Item(uint64_t key, const PMASegment& l2_segment) {
+// the segments are searched through views: only the items visited are 
+// accounted for.
+L2GetReturn GetL2Item(uint64_t key, const PMASegmentView& l2_segment) {
   // by construction we should have l2 segment size being 
   // a multiple of L2Node size.
   auto item_size = sizeof(L2Node);
-  assert((l2_segment.len % item_size) == 0); 
-  auto num_element = l2_segment.num_item;
-  assert(num_element < l2_segment.len / item_size);
-  L2Node* item = reinterpret_cast<L2Node*>(l2_segment.content + l2_segment.len - item_size);
+  assert((l2_segment.len() % item_size) == 0); 
+  auto num_element = l2_segment.num_item();
+  assert(num_element < l2_segment.len() / item_size);
+  auto pos = (l2_segment.len() / item_size) - 1;
+  L2Node* item = reinterpret_cast<L2Node*>(l2_segment.LoadItem(pos));
 
   auto last_id = item->l3_segment_id;
-  auto pos = (l2_segment.len / item_size) - 1;
   while (num_element > 0 && item->key < key) {
     last_id = item->l3_segment_id;
-    item--;
     pos--;
     num_element--;
+    if (num_element > 0) {
+      item = reinterpret_cast<L2Node*>(l2_segment.LoadItem(pos));
+    }
   }
   return {pos+1, last_id};
 }
 
-uint64_t GetRecordLocation(uint64_t key, const PMASegment& segment,
+uint64_t GetRecordLocation(uint64_t key, const PMASegmentView& segment,
   bool* key_equal) {
   assert(key_equal);
   // by construction we should have l3 segment size being 
   // a multiple of record size.
   auto item_size = sizeof(L3Node);
-  assert((segment.len % item_size) == 0); 
-  auto num_element = segment.num_item;
-  assert(num_element < segment.len / item_size);
-  L3Node* item = reinterpret_cast<L3Node*>(segment.content + segment.len - item_size);
+  assert((segment.len() % item_size) == 0); 
+  auto num_element = segment.num_item();
+  assert(num_element < segment.len() / item_size);
+  auto pos = (segment.len() / item_size) - 1;
+  L3Node* item = reinterpret_cast<L3Node*>(segment.LoadItem(pos));
 
-  auto pos = (segment.len / item_size) - 1;
   while (num_element > 0 && item->key < key) {
-    item--;
     num_element--;
     pos--;
+    item = reinterpret_cast<L3Node*>(segment.LoadItem(pos));
   }
   *key_equal = (item->key == key);
   return pos;
 }
 
 void UpdateRecord(uint64_t key, uint64_t value, 
-  uint64_t record_idx, PMASegment* segment) {
-  L3Node* item = reinterpret_cast<L3Node*>(segment->content 
-    + record_idx * sizeof(L3Node));
+  uint64_t record_idx, const PMASegmentView& segment) {
+  L3Node* item = reinterpret_cast<L3Node*>(segment.LoadItem(record_idx));
   assert(item->key == key);
   item->value = value;  
 }
@@ -98,11 +107,42 @@ SegmentInfos MergeSegmentUpdateInfo(const SegmentInfos& old,
   return merged_updated_segment;
 }
 
+bool WriteAll(int fd, const void* data, uint64_t len, uint64_t offset) {
+  auto ptr = reinterpret_cast<const char*>(data);
+  while (len > 0) {
+    auto written = ::pwrite(fd, ptr, len, offset);
+    if (written < 0) return false;
+    ptr += written;
+    offset += written;
+    len -= written;
+  }
+  return true;
+}
+
+// lookups in flight in GetBatch, as in vEBTree::GetBatch.
+const uint64_t kGetBatchGroupSize = 16;
+
+const uint64_t kSnapshotMagic = 0x434f42545245454dULL; // "COBTREEM"
+const uint64_t kSnapshotPageSize = 4096;
+
+inline uint64_t AlignToPage(uint64_t offset) {
+  return (offset + kSnapshotPageSize - 1) / kSnapshotPageSize 
+    * kSnapshotPageSize;
+}
+
+std::string SnapshotFile(const std::string& path, uint64_t slot) {
+  return path + "." + std::to_string(slot);
+}
+
 }  // anonymous namespace
 
 bool CoBtree::L2Update(uint64_t l2_segment_id,
   uint64_t l3_insert_segment_id, uint64_t insert_in_segment_idx,
   const PMAUpdateContext& l3_update_ctx, PMAUpdateContext* l2_update_ctx){
+  COBTREE_TRACE_SCOPE(trace, cache_->event_tracer(), kTraceL2Update,
+    pma_index_.trace_device());
+  COBTREE_TRACE_ARG(trace, 0, l2_segment_id);
+  COBTREE_TRACE_ARG(trace, 1, l3_update_ctx.updated_segment.size());
 
   auto& l3_updated_segments = l3_update_ctx.updated_segment;
   auto insert_segment_it = l3_updated_segments.begin();
@@ -119,6 +159,7 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
     auto l3_segment_it = insert_segment_it;
     auto curr_l2_segment_id = l2_segment_id; 
     auto curr_l2_segment = pma_index_.Get(curr_l2_segment_id); 
+    pma_index_.MarkModified(curr_l2_segment_id);
     auto l2_item = reinterpret_cast<L2Node*>(
       curr_l2_segment.content + insert_in_segment_idx * sizeof(L2Node)
     ); 
@@ -144,6 +185,7 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
         assert(curr_l2_segment_id > 0);
         curr_l2_segment_id--;
         curr_l2_segment = pma_index_.Get(curr_l2_segment_id);
+        pma_index_.MarkModified(curr_l2_segment_id);
         l2_item = reinterpret_cast<L2Node*>(curr_l2_segment.content 
           - sizeof(L2Node)); 
         curr_l2_segment_last_item = reinterpret_cast<L2Node*>(
@@ -155,6 +197,7 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
   // update l2 item pointing to the segment where insertion happen and afterwards
   auto curr_l2_segment_id = l2_segment_id; 
   auto curr_l2_segment = pma_index_.Get(curr_l2_segment_id); 
+  pma_index_.MarkModified(curr_l2_segment_id);
   auto l2_item = reinterpret_cast<L2Node*>(
     curr_l2_segment.content + insert_in_segment_idx * sizeof(L2Node)
   ); 
@@ -176,6 +219,7 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
       assert(curr_l2_segment_id < pma_index_.segment_count());
       curr_l2_segment = pma_index_.Get(curr_l2_segment_id);
       if (curr_l2_segment.num_item == 0) break;
+      pma_index_.MarkModified(curr_l2_segment_id);
       l2_item = reinterpret_cast<L2Node*>(curr_l2_segment.content 
         + curr_l2_segment.len) - curr_l2_segment.num_item;
     }
@@ -205,6 +249,7 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
 
   // scan forward to update them
   *l2_update_ctx = aggregate_ctx;
+  COBTREE_TRACE_ARG(trace, 2, aggregate_ctx.updated_segment.size());
   return true;
 }
 
@@ -212,8 +257,16 @@ bool CoBtree::L2Update(uint64_t l2_segment_id,
 // l1 leafs are in key ascending order as leaf index increases (l2 item in key descending order). 
 bool CoBtree::L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
   const PMAUpdateContext& l2_update_ctx) {
+  COBTREE_TRACE_SCOPE(trace, cache_->event_tracer(), kTraceL1Update,
+    tree_.pma().trace_device());
+  COBTREE_TRACE_ARG(trace, 0, l1_leaf_address);
+  COBTREE_TRACE_ARG(trace, 1, l2_update_ctx.updated_segment.size());
   auto& l2_updated_segments = l2_update_ctx.updated_segment;
   auto insert_segment_it = l2_updated_segments.begin();
+  // the new separator keys are collected and applied to the vEB tree at
+  // once, so the ancestors shared by the leaves are updated once. (the 
+  // iterators follow the addresses, not the keys)
+  std::vector<LeafKeyUpdate> key_updates;
   if (l2_update_ctx.num_filled_empty_segment == 0) {
     // no leaf insertion. only update.
     while ((insert_segment_it != l2_updated_segments.end())
@@ -243,8 +296,8 @@ bool CoBtree::L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
         // vEBTree::get_children(leaf_it.node())->key = curr_l2_first_item->key;
         assert(vEBTree::get_children(leaf_it.node())->key
           == l2_segment_it->segment_id);
-        tree_.UpdateLeafKey(leaf_it.leaf_address(), leaf_it.parent_address(),
-          curr_l2_first_item->key);
+        key_updates.push_back(LeafKeyUpdate{leaf_it.leaf_address(), 
+          leaf_it.parent_address(), curr_l2_first_item->key});
       } while (l2_segment_it != l2_updated_segments.begin());
     }
 
@@ -260,12 +313,13 @@ bool CoBtree::L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
         // vEBTree::get_children(leaf_it.node())->key = curr_l2_first_item->key;
         assert(vEBTree::get_children(leaf_it.node())->key
           == insert_segment_it->segment_id);
-        tree_.UpdateLeafKey(leaf_it.leaf_address(), leaf_it.parent_address(),
-          curr_l2_first_item->key);
+        key_updates.push_back(LeafKeyUpdate{leaf_it.leaf_address(), 
+          leaf_it.parent_address(), curr_l2_first_item->key});
       // move to the next l3 segment
       insert_segment_it++;
       leaf_it.Prev();
     }
+    tree_.UpdateLeafKeys(key_updates);
   }
   else {
     // with new segement the logic is different;
@@ -284,10 +338,11 @@ bool CoBtree::L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
       auto curr_l2_first_item = reinterpret_cast<L2Node*>(
         curr_l2_segment.content + curr_l2_segment.len - sizeof(L2Node)
       );
-      tree_.UpdateLeafKey(leaf_it.leaf_address(), leaf_it.parent_address(), 
-        curr_l2_first_item->key);
+      key_updates.push_back(LeafKeyUpdate{leaf_it.leaf_address(), 
+        leaf_it.parent_address(), curr_l2_first_item->key});
       segment_it++;
     } while (--first_leaf_address > 0);
+    tree_.UpdateLeafKeys(key_updates);
     while(segment_it != l2_update_ctx.updated_segment.rend()) {
       // possibly we have new items to be added
       uint64_t tree_node_size = sizeof(Node) + sizeof(NodeEntry) 
@@ -309,18 +364,28 @@ bool CoBtree::L1Update(uint64_t l1_leaf_address, uint64_t l2_insert_segment_id,
   return true;
 }
 
-bool CoBtree::Insert(uint64_t key, uint64_t value) {
+bool CoBtree::InsertRecord(uint64_t key, uint64_t value) {
+  write_sequence_++;
+  if (insert_buffer_capacity_ > 0) {
+    NoteLatencyPath(kPathBuffered);
+    insert_buffer_[key] = value;
+    if (insert_buffer_.size() < insert_buffer_capacity_) return true;
+    return FlushInsertBuffer();
+  }
   uint64_t vebleaf_address;
   auto l2_segment_id = tree_.Get(key, &vebleaf_address);
-  auto l2_segment = pma_index_.Get(l2_segment_id);
+  auto l2_segment = pma_index_.GetView(l2_segment_id);
   auto l2_item = GetL2Item(key, l2_segment);
   auto l3_segment_id = l2_item.l3_segment_id;
-  auto l3_segment = pma_data_.Get(l3_segment_id);
+  auto l3_segment = pma_data_.GetView(l3_segment_id);
   bool key_equal = false;
   auto pos = GetRecordLocation(key, l3_segment, &key_equal);
   if (key_equal == true) {
     // fast path perfrom update
-    UpdateRecord(key, value, pos, &l3_segment);
+    NoteLatencyPath(kPathUpdate);
+    pma_data_.MarkModified(l3_segment_id, pos * sizeof(L3Node),
+      sizeof(L3Node));
+    UpdateRecord(key, value, pos, l3_segment);
     return true;
   } 
   // add new records to L3 and updates L2&L1 if needed
@@ -332,43 +397,795 @@ bool CoBtree::Insert(uint64_t key, uint64_t value) {
     printf("l3 pma full");
     return false;
   }
+  NoteLatencyPath(kPathL3Insert);
+  return PropagateL3Update(vebleaf_address, l2_segment_id, l2_item.pos,
+    l3_segment_id, ctx);
+}
 
+bool CoBtree::PropagateL3Update(uint64_t vebleaf_address, 
+  uint64_t l2_segment_id, uint64_t l2_item_pos, uint64_t l3_segment_id,
+  const PMAUpdateContext& ctx) {
   // fast path, insertion did not cause l3 rebalance.
   if (ctx.updated_segment.empty()) return true;
 
   // update l2 segment down pointer needed
+  NoteLatencyPath(kPathL2Update);
   PMAUpdateContext l2_update_ctx; 
-  auto l2_update_success = L2Update(l2_segment_id, l3_segment_id, l2_item.pos,
+  auto l2_update_success = L2Update(l2_segment_id, l3_segment_id, l2_item_pos,
     ctx, &l2_update_ctx);
   if (!l2_update_success) {
     printf("l2 pma full");
     return false;
   }
   
+  if (learned_index_) {
+    learned_index_->Refresh(pma_index_, l2_segment_id, ctx, l2_update_ctx);
+  }
+
   // update l1 segment
   // new insertion to l1.
   if (l2_update_ctx.updated_segment.empty()) return true;
+  NoteLatencyPath(kPathL1Update);
   auto l1_update_success = L1Update(vebleaf_address, l2_segment_id, 
     l2_update_ctx);
   if(!l1_update_success) printf("l1 pma full\\");
   return l1_update_success;
 }
 
-bool CoBtree::Get(uint64_t key, uint64_t* value) {
-  assert(value);
-  uint64_t vebleaf_address;
-  auto l2_segment_id = tree_.Get(key, &vebleaf_address);
-  auto l2_segment = pma_index_.Get(l2_segment_id);
+void CoBtree::PinVEBTreeTop(uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mu_);
+  tree_.PinTop(false);
+  cache_->ReservePinned(bytes);
+  if (bytes > 0) tree_.PinTop(true);
+}
+
+void CoBtree::EnableLearnedIndex(uint64_t max_error) {
+  std::lock_guard<std::mutex> lock(mu_);
+  learned_index_.reset(new LearnedSegmentIndex(pma_index_.segment_count(),
+    max_error));
+  learned_index_->Refresh(pma_index_, 0, 
+    pma_index_.last_non_empty_segment());
+}
+
+void CoBtree::EnableHashIndex(uint64_t capacity) {
+  std::lock_guard<std::mutex> lock(mu_);
+  hash_index_capacity_ = capacity;
+  hash_index_.clear();
+  hash_index_.reserve(capacity);
+}
+
+void CoBtree::EnableInsertBuffer(uint64_t capacity) {
+  std::lock_guard<std::mutex> lock(mu_);
+  insert_buffer_capacity_ = capacity;
+  if (insert_buffer_.size() >= capacity) FlushInsertBuffer();
+}
+
+bool CoBtree::FlushInsertBuffer() {
+  // the merge and the rebalances it triggers move records.
+  if (!insert_buffer_.empty()) write_sequence_++;
+  auto it = insert_buffer_.begin();
+  while (it != insert_buffer_.end()) {
+    // one descent for all the buffered records routed to the same segment.
+    uint64_t vebleaf_address;
+    auto l2_segment_id = tree_.Get(it->first, &vebleaf_address);
+    auto l2_segment = pma_index_.GetView(l2_segment_id);
+    auto l2_item = GetL2Item(it->first, l2_segment);
+    auto l3_segment_id = l2_item.l3_segment_id;
+    // the keys from the first key of the next segment are routed there.
+    uint64_t next_first_key = UINT64_MAX;
+    if (l3_segment_id + 1 < pma_data_.segment_count()) {
+      auto next = pma_data_.GetView(l3_segment_id + 1);
+      if (next.num_item() > 0) {
+        next_first_key = reinterpret_cast<L3Node*>(next.LoadItem(
+          pma_data_.segment_size() - 1))->key;
+      }
+    }
+
+    // merge in key order. the smallest key of a segment is at its end.
+    auto l3_segment = pma_data_.Get(l3_segment_id);
+    auto existing = reinterpret_cast<L3Node*>(l3_segment.content 
+      + l3_segment.len) - 1;
+    auto num_existing = l3_segment.num_item;
+    // keep one slot free as Add does.
+    auto room = pma_data_.segment_size() - 1 - num_existing;
+    std::vector<L3Node> merged;
+    merged.reserve(pma_data_.segment_size());
+    uint64_t i = 0;
+    while ((it != insert_buffer_.end()) && (it->first < next_first_key)) {
+      if ((i < num_existing) && (existing[-i].key < it->first)) {
+        merged.push_back(existing[-i++]);
+      } else if ((i < num_existing) && (existing[-i].key == it->first)) {
+        merged.push_back(L3Node{it->first, it->second});
+        i++;
+        it = insert_buffer_.erase(it);
+      } else if (room > 0) {
+        merged.push_back(L3Node{it->first, it->second});
+        room--;
+        it = insert_buffer_.erase(it);
+      } else {
+        break; // the rest goes in after the rebalance
+      }
+    }
+    while (i < num_existing) merged.push_back(existing[-i++]);
+
+    std::reverse(merged.begin(), merged.end());
+    PMAUpdateContext ctx;
+    if (!pma_data_.Rewrite(l3_segment_id, 
+      reinterpret_cast<const char*>(merged.data()), merged.size(), &ctx)) {
+      printf("l3 pma full");
+      return false;
+    }
+    NoteLatencyPath(kPathL3Insert);
+    if (!PropagateL3Update(vebleaf_address, l2_segment_id, l2_item.pos, 
+      l3_segment_id, ctx)) return false;
+  }
+  return true;
+}
+
+bool CoBtree::Insert(uint64_t key, uint64_t value) {
+  uint64_t lsn;
+  bool checkpoint_due;
+  bool success;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    success = LogAndInsertRecord(key, value, &lsn, &checkpoint_due);
+  }
+  return CommitInsert(lsn, checkpoint_due) && success;
+}
+
+bool CoBtree::LogAndInsertRecord(uint64_t key, uint64_t value, uint64_t* lsn,
+  bool* checkpoint_due) {
+  *lsn = 0;
+  *checkpoint_due = false;
+  if (wal_) {
+    *lsn = wal_->Append(kWALInsert, key, value);
+    *checkpoint_due = (checkpoint_interval_ > 0) 
+      && (++record_since_checkpoint_ >= checkpoint_interval_);
+  }
+  PerfScope perf(cache_->perf_stats(), kProbeCoBtreeInsert);
+  auto start = BeginLatency();
+  auto success = InsertRecord(key, value);
+  EndLatency(kLatencyInsert, start);
+  return success;
+}
+
+bool CoBtree::CommitInsert(uint64_t lsn, bool checkpoint_due) {
+  if (!wal_) return true;
+  // commit outside the lock so concurrent inserters share one fsync.
+  if (!wal_->Commit(lsn)) return false;
+  if (checkpoint_due) Checkpoint(checkpoint_image_path_);
+  return true;
+}
+
+bool CoBtree::Locate(uint64_t key, uint64_t* l3_segment_id, uint64_t* pos) {
+  assert(l3_segment_id);
+  assert(pos);
+  uint64_t l2_segment_id;
+  if (!learned_index_ || !learned_index_->FindSegment(key, &l2_segment_id)) {
+    uint64_t vebleaf_address;
+    l2_segment_id = tree_.Get(key, &vebleaf_address);
+  }
+  auto l2_segment = pma_index_.GetView(l2_segment_id);
   auto l2_item = GetL2Item(key, l2_segment);
-  auto l3_segment_id = l2_item.l3_segment_id;
-  auto l3_segment = pma_data_.Get(l3_segment_id);
+  *l3_segment_id = l2_item.l3_segment_id;
+  auto l3_segment = pma_data_.GetView(*l3_segment_id);
   bool key_equal = false;
-  auto pos = GetRecordLocation(key, l3_segment, &key_equal);
-  if (!key_equal) return false; // value not founds
-  auto item = reinterpret_cast<L3Node*>(l3_segment.content 
-    + pos * sizeof(L3Node));
+  *pos = GetRecordLocation(key, l3_segment, &key_equal);
+  return key_equal;
+}
+
+bool CoBtree::Get(uint64_t key, uint64_t* value) {
+  assert(value);
+  std::lock_guard<std::mutex> lock(mu_);
+  PerfScope perf(cache_->perf_stats(), kProbeCoBtreeGet);
+  auto start = BeginLatency();
+  auto found = GetRecord(key, value);
+  EndLatency(kLatencyGet, start);
+  return found;
+}
+
+uint64_t CoBtree::GetBatch(const uint64_t* keys, uint64_t count,
+  uint64_t* values, bool* found) {
+  assert(keys);
+  assert(values);
+  assert(found);
+  std::lock_guard<std::mutex> lock(mu_);
+  uint64_t segment_id[kGetBatchGroupSize];
+  uint64_t leaf_address[kGetBatchGroupSize];
+  uint64_t found_count = 0;
+  for (uint64_t begin = 0; begin < count; begin += kGetBatchGroupSize) {
+    auto group = std::min(kGetBatchGroupSize, count - begin);
+    auto group_keys = keys + begin;
+    tree_.GetBatch(group_keys, group, segment_id, leaf_address);
+    for (uint64_t i = 0; i < group; i++) {
+      pma_index_.GetView(segment_id[i]).PrefetchItems();
+    }
+    // level 2 items to level 3 segments.
+    for (uint64_t i = 0; i < group; i++) {
+      segment_id[i] = GetL2Item(group_keys[i], 
+        pma_index_.GetView(segment_id[i])).l3_segment_id;
+      pma_data_.GetView(segment_id[i]).PrefetchItems();
+    }
+    for (uint64_t i = 0; i < group; i++) {
+      auto l3_segment = pma_data_.GetView(segment_id[i]);
+      bool key_equal = false;
+      auto pos = GetRecordLocation(group_keys[i], l3_segment, &key_equal);
+      found[begin + i] = key_equal;
+      if (!key_equal) continue;
+      values[begin + i] = reinterpret_cast<L3Node*>(
+        l3_segment.LoadItem(pos))->value;
+    }
+  }
+  // the buffered records shadow level 3.
+  for (uint64_t i = 0; i < count; i++) {
+    if (!insert_buffer_.empty()) {
+      auto buffered = insert_buffer_.find(keys[i]);
+      if (buffered != insert_buffer_.end()) {
+        values[i] = buffered->second;
+        found[i] = true;
+      }
+    }
+    if (found[i]) found_count++;
+  }
+  return found_count;
+}
+
+bool CoBtree::AdvanceAsyncGet(AsyncGetState* lookup, 
+  uint64_t* restart_count) {
+  assert(lookup);
+  assert(restart_count);
+  std::lock_guard<std::mutex> lock(mu_);
+  if ((lookup->stage != kAsyncGetStart) 
+    && (lookup->sequence != write_sequence_)) {
+    // the nodes and segments may have moved since the lookup started.
+    lookup->stage = kAsyncGetStart;
+    (*restart_count)++;
+  }
+  while (true) {
+    switch (lookup->stage) {
+      case kAsyncGetStart: {
+        lookup->sequence = write_sequence_;
+        auto buffered = insert_buffer_.find(lookup->key);
+        if (buffered != insert_buffer_.end()) {
+          lookup->found = true;
+          lookup->value = buffered->second;
+          lookup->stage = kAsyncGetDone;
+          break;
+        }
+        lookup->address = tree_.root_address();
+        lookup->stage = kAsyncGetL1;
+        break;
+      }
+      case kAsyncGetL1: {
+        if (!lookup->read_done && !tree_.NodeResident(lookup->address)) {
+          return false;
+        }
+        lookup->read_done = false;
+        bool leaf;
+        auto next = tree_.GetStep(lookup->address, lookup->key, &leaf);
+        if (leaf) {
+          lookup->segment_id = next;
+          lookup->stage = kAsyncGetL2;
+        } else {
+          lookup->address = next;
+        }
+        break;
+      }
+      case kAsyncGetL2: {
+        auto l2_segment = pma_index_.GetView(lookup->segment_id);
+        if (!lookup->read_done && !l2_segment.ItemsResident()) return false;
+        lookup->read_done = false;
+        lookup->segment_id = GetL2Item(lookup->key, 
+          l2_segment).l3_segment_id;
+        lookup->stage = kAsyncGetL3;
+        break;
+      }
+      case kAsyncGetL3: {
+        auto l3_segment = pma_data_.GetView(lookup->segment_id);
+        if (!lookup->read_done && !l3_segment.ItemsResident()) return false;
+        lookup->read_done = false;
+        auto pos = GetRecordLocation(lookup->key, l3_segment, &lookup->found);
+        if (lookup->found) {
+          lookup->value = reinterpret_cast<L3Node*>(
+            l3_segment.LoadItem(pos))->value;
+        }
+        lookup->stage = kAsyncGetDone;
+        break;
+      }
+      case kAsyncGetDone:
+        return true;
+    }
+  }
+}
+
+bool CoBtree::GetRecord(uint64_t key, uint64_t* value) {
+  auto buffered = insert_buffer_.find(key);
+  if (buffered != insert_buffer_.end()) {
+    *value = buffered->second;
+    return true;
+  }
+  auto hashed = hash_index_.find(key);
+  if (hashed != hash_index_.end()) {
+    auto l3_segment = pma_data_.GetView(hashed->second.segment_id);
+    // the record may have been moved, the slot must still hold the key.
+    if (hashed->second.pos + l3_segment.num_item() 
+      >= pma_data_.segment_size()) {
+      auto item = reinterpret_cast<L3Node*>(
+        l3_segment.LoadItem(hashed->second.pos));
+      if (item->key == key) {
+        hash_index_hit_++;
+        *value = item->value;
+        return true;
+      }
+    }
+    hash_index_stale_++;
+  }
+  uint64_t l3_segment_id;
+  uint64_t pos;
+  if (!Locate(key, &l3_segment_id, &pos)) return false; // value not founds
+  auto item = reinterpret_cast<L3Node*>(
+    pma_data_.GetView(l3_segment_id).LoadItem(pos));
   *value = item->value;
+  if ((hashed != hash_index_.end()) 
+    || (hash_index_.size() < hash_index_capacity_)) {
+    hash_index_[key] = L3Slot{l3_segment_id, pos};
+  }
   return true;
 }
 
+ReadSnapshot::~ReadSnapshot() {
+  tree_->ReleaseReadSnapshot(epoch_);
+}
+
+std::unique_ptr<ReadSnapshot> CoBtree::CreateReadSnapshot() {
+  std::lock_guard<std::mutex> lock(mu_);
+  auto epoch = pma_data_.PinSnapshot();
+  std::unique_ptr<ReadSnapshot> snapshot(new ReadSnapshot(this, epoch, 
+    pma_data_.last_non_empty_segment()));
+  // the buffer is not versioned, the snapshot keeps a copy of it.
+  snapshot->buffered_.reserve(insert_buffer_.size());
+  for (const auto& record : insert_buffer_) {
+    snapshot->buffered_.push_back(L3Node{record.first, record.second});
+  }
+  return snapshot;
+}
+
+void CoBtree::ReleaseReadSnapshot(uint64_t epoch) {
+  std::lock_guard<std::mutex> lock(mu_);
+  pma_data_.ReleaseSnapshot(epoch);
+}
+
+uint64_t CoBtree::Scan(uint64_t start_key, uint64_t end_key, 
+  std::vector<L3Node>* records, const ReadSnapshot* snapshot) {
+  assert(records);
+  // the scan does not hold the tree lock, it records without a path.
+  if (!latency_stats_) {
+    return ScanRecords(start_key, end_key, records, snapshot);
+  }
+  auto start = LatencyNow();
+  auto count = ScanRecords(start_key, end_key, records, snapshot);
+  latency_stats_->Record(kLatencyScan, kPathRead, nullptr, 
+    LatencyNow() - start);
+  return count;
+}
+
+uint64_t CoBtree::ScanRecords(uint64_t start_key, uint64_t end_key, 
+  std::vector<L3Node>* records, const ReadSnapshot* snapshot) {
+  std::unique_ptr<ReadSnapshot> pinned;
+  if (!snapshot) {
+    pinned = CreateReadSnapshot();
+    snapshot = pinned.get();
+  }
+  auto read_segment = [this, snapshot](uint64_t segment_id) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return pma_data_.GetSnapshotCopy(segment_id, snapshot->epoch_);
+  };
+  // the smallest key of a segment is at its end.
+  auto first_record = [](const PMASegmentCopy& segment) {
+    return reinterpret_cast<L3Node*>(segment.content.get() + segment.len) - 1;
+  };
+
+  // binary search the last segment starting at or before start_key. 
+  // an empty segment is passed to the left, which only costs extra reads.
+  uint64_t left = 0;
+  uint64_t right = snapshot->last_segment_;
+  while (left < right) {
+    auto mid = left + (right - left + 1) / 2;
+    auto segment = read_segment(mid);
+    if ((segment.num_item > 0) && (first_record(segment)->key <= start_key)) {
+      left = mid;
+    } else {
+      right = mid - 1;
+    }
+  }
+
+  // the buffered records shadow level 3.
+  auto buffered = std::lower_bound(snapshot->buffered_.begin(), 
+    snapshot->buffered_.end(), start_key, 
+    [](const L3Node& record, uint64_t key) { return record.key < key; });
+  auto buffered_end = snapshot->buffered_.end();
+  auto emit_buffered = [&](uint64_t before_key) {
+    uint64_t emitted = 0;
+    while ((buffered != buffered_end) && (buffered->key < before_key) 
+      && (buffered->key <= end_key)) {
+      records->push_back(*buffered++);
+      emitted++;
+    }
+    return emitted;
+  };
+
+  uint64_t count = 0;
+  for (auto segment_id = left; segment_id <= snapshot->last_segment_; 
+    segment_id++) {
+    auto segment = read_segment(segment_id);
+    auto record = first_record(segment);
+    for (uint64_t i = 0; i < segment.num_item; i++, record--) {
+      if (record->key < start_key) continue;
+      if (record->key > end_key) return count + emit_buffered(UINT64_MAX);
+      count += emit_buffered(record->key);
+      if ((buffered != buffered_end) && (buffered->key == record->key)) {
+        continue;
+      }
+      records->push_back(*record);
+      count++;
+    }
+  }
+  return count + emit_buffered(UINT64_MAX);
+}
+
+void CoBtree::EnableLatencyStats() {
+  std::lock_guard<std::mutex> lock(mu_);
+  // a window can span the whole pma, one level above its height.
+  latency_stats_.reset(new OpLatencyStats({tree_.pma().height() + 1,
+    pma_index_.height() + 1, pma_data_.height() + 1}));
+}
+
+void CoBtree::DumpLatencyStats(std::ostream* out) const {
+  if (latency_stats_) latency_stats_->Dump(out);
+}
+
+uint64_t CoBtree::BeginLatency() {
+  if (!latency_stats_) return 0;
+  op_path_ = kPathRead;
+  op_node_split_count_ = tree_.node_split_count();
+  op_root_split_count_ = tree_.root_split_count();
+  tree_.TakeMaxRebalanceHeight();
+  pma_index_.TakeMaxRebalanceHeight();
+  pma_data_.TakeMaxRebalanceHeight();
+  return LatencyNow();
+}
+
+void CoBtree::EndLatency(LatencyOp op, uint64_t start) {
+  if (!latency_stats_) return;
+  auto latency = LatencyNow() - start;
+  if (tree_.root_split_count() != op_root_split_count_) {
+    NoteLatencyPath(kPathRootSplit);
+  } else if (tree_.node_split_count() != op_node_split_count_) {
+    NoteLatencyPath(kPathNodeSplit);
+  }
+  int rebalance_height[OpLatencyStats::kLevelCount] = {
+    tree_.TakeMaxRebalanceHeight(), pma_index_.TakeMaxRebalanceHeight(),
+    pma_data_.TakeMaxRebalanceHeight()};
+  latency_stats_->Record(op, op_path_, rebalance_height, latency);
+}
+
+void CoBtree::EnableValueLog(uint64_t log_capacity) {
+  assert(!value_log_);
+  value_log_.reset(new ValueLog(CreateUid(), log_capacity, cache_));
+  // examine a sixteenth of the log per collection to bound the pause.
+  value_log_gc_batch_ = std::max<uint64_t>(value_log_->capacity() >> 4, 
+    ValueLog::RecordSize(0));
+}
+
+bool CoBtree::Put(uint64_t key, const std::string& value) {
+  assert(value_log_);
+  // key 0 is the placeholder record every tree starts with.
+  if (key == 0) return false;
+  uint64_t lsn;
+  bool checkpoint_due;
+  bool success;
+  {
+    // the previous value is looked up and replaced in one step, else two 
+    // concurrent Put of a key would both mark it as garbage.
+    std::lock_guard<std::mutex> lock(mu_);
+    // keep garbage under half of the used log space.
+    if (value_log_->garbage_bytes() * 2 > value_log_->used_bytes()) {
+      ReclaimValueLog(value_log_gc_batch_);
+    }
+    uint64_t offset;
+    while (!value_log_->Append(key, value, &offset)) {
+      if (ReclaimValueLog(value_log_gc_batch_) == 0) {
+        printf("value log full");
+        return false;
+      }
+    }
+    // the value previously stored for the key becomes garbage.
+    uint64_t previous;
+    if (GetRecord(key, &previous) && (previous != offset)) {
+      value_log_->MarkGarbage(value_log_->ValueLength(previous));
+    }
+    success = LogAndInsertRecord(key, offset, &lsn, &checkpoint_due);
+  }
+  return CommitInsert(lsn, checkpoint_due) && success;
+}
+
+bool CoBtree::Get(uint64_t key, std::string* value) {
+  assert(value_log_);
+  assert(value);
+  // hold the lock while reading the log: a collection may reclaim the 
+  // record once its offset is known.
+  std::lock_guard<std::mutex> lock(mu_);
+  PerfScope perf(cache_->perf_stats(), kProbeCoBtreeGet);
+  auto start = BeginLatency();
+  uint64_t offset;
+  uint64_t log_key;
+  // a record not inserted by Put (the key 0 placeholder) has no log record.
+  auto found = GetRecord(key, &offset) 
+    && value_log_->Read(offset, &log_key, value) && (log_key == key);
+  EndLatency(kLatencyGet, start);
+  return found;
+}
+
+uint64_t CoBtree::CollectValueLogGarbage(uint64_t max_bytes) {
+  if (!value_log_) return 0;
+  std::lock_guard<std::mutex> lock(mu_);
+  return ReclaimValueLog(max_bytes);
+}
+
+uint64_t CoBtree::ReclaimValueLog(uint64_t max_bytes) {
+  // liveness is checked and patched in level 3 only.
+  if (!FlushInsertBuffer()) return 0;
+  // a relocated record keeps its place in level 3 since no insertion 
+  // happens during collection, so the patches are applied in one batch.
+  struct Relocation {
+    uint64_t l3_segment_id;
+    uint64_t pos;
+    uint64_t new_offset;
+  };
+  std::vector<Relocation> relocations;
+  uint64_t garbage = 0;
+  uint64_t relocated = 0;
+  auto start = value_log_->head();
+  auto end = std::min(value_log_->tail(), start + max_bytes);
+  auto offset = value_log_->FirstRecord();
+  while (offset < end) {
+    uint64_t key;
+    std::string value;
+    value_log_->Read(offset, &key, &value);
+    uint64_t l3_segment_id;
+    uint64_t pos;
+    bool live = false;
+    if (Locate(key, &l3_segment_id, &pos)) {
+      auto item = reinterpret_cast<L3Node*>(
+        pma_data_.GetView(l3_segment_id).LoadItem(pos));
+      live = (item->value == offset);
+    }
+    if (live) {
+      uint64_t new_offset;
+      // no space left to relocate. stop here and reclaim what we passed.
+      if (!value_log_->Append(key, value, &new_offset)) break;
+      relocations.push_back(Relocation{l3_segment_id, pos, new_offset});
+      relocated += ValueLog::RecordSize(value.size());
+    } else {
+      garbage += ValueLog::RecordSize(value.size());
+    }
+    offset = value_log_->NextRecord(offset);
+  }
+
+  // patch level 3 offsets
+  for (const auto& r : relocations) {
+    pma_data_.MarkModified(r.l3_segment_id, r.pos * sizeof(L3Node),
+      sizeof(L3Node));
+    auto item = reinterpret_cast<L3Node*>(
+      pma_data_.GetView(r.l3_segment_id).LoadItem(r.pos));
+    item->value = r.new_offset;
+  }
+  value_log_->Trim(offset, garbage);
+  return offset - start - relocated;
+}
+
+// page 0 of a snapshot file. the regions it points to start on page 
+// boundaries so that they can be used in place once the file is mapped.
+struct SnapshotHeader {
+  uint64_t magic;
+  uint64_t sequence; // the valid snapshot with the largest sequence wins
+  uint64_t checkpoint_lsn;
+  uint64_t record_count_l3;
+  uint64_t item_count_l2;
+  uint64_t leaf_count_l1;
+  vEBTreeLayout tree;
+  PMALayout level[3]; // l1, l2, l3
+  uint64_t item_count_offset[3];
+  uint64_t element_count_offset;
+  uint64_t segments_offset[3];
+  uint64_t file_size;
+  uint64_t checksum; // over all the fields above
+};
+
+namespace {
+
+uint64_t SnapshotChecksum(const SnapshotHeader& header) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  auto bytes = reinterpret_cast<const unsigned char*>(&header);
+  for (uint64_t i = 0; i < offsetof(SnapshotHeader, checksum); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// return false if there is no valid snapshot in the slot.
+bool ReadSnapshotHeader(const std::string& path, uint64_t slot, 
+  SnapshotHeader* header) {
+  auto fd = ::open(SnapshotFile(path, slot).c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  auto read = ::pread(fd, header, sizeof(SnapshotHeader), 0);
+  ::close(fd);
+  return (read == static_cast<ssize_t>(sizeof(SnapshotHeader)))
+    && (header->magic == kSnapshotMagic)
+    && (header->checksum == SnapshotChecksum(*header));
+}
+
+}  // anonymous namespace
+
+CoBtree::CoBtree(const std::string& uid, Cache* cache, 
+  const SnapshotHeader& header, std::unique_ptr<MappedFile> snapshot)
+  : uid_prefix_(uid), uid_seqeunce_number_(0), cache_(cache),
+    record_count_l3(header.record_count_l3),
+    item_count_l2(header.item_count_l2),
+    leaf_count_l1(header.leaf_count_l1),
+    snapshot_(std::move(snapshot)),
+    tree_(CreateUid(), header.tree, header.level[0], 
+      snapshot_->data() + header.segments_offset[0],
+      reinterpret_cast<uint64_t*>(snapshot_->data() 
+        + header.item_count_offset[0]),
+      reinterpret_cast<uint64_t*>(snapshot_->data() 
+        + header.element_count_offset), cache_),
+    pma_index_(CreateUid(), header.level[1], 
+      snapshot_->data() + header.segments_offset[1],
+      reinterpret_cast<uint64_t*>(snapshot_->data() 
+        + header.item_count_offset[1]), cache_),
+    pma_data_(CreateUid(), header.level[2], 
+      snapshot_->data() + header.segments_offset[2],
+      reinterpret_cast<uint64_t*>(snapshot_->data() 
+        + header.item_count_offset[2]), cache_),
+    value_log_gc_batch_(0), wal_(nullptr), checkpoint_interval_(0), 
+    record_since_checkpoint_(0), checkpoint_slot_(1), checkpoint_sequence_(0),
+    checkpoint_version_{{0, 0, 0}, {0, 0, 0}}, 
+    checkpoint_full_{false, false}, recovery_lsn_(header.checkpoint_lsn) {}
+
+void CoBtree::AttachWriteAheadLog(WriteAheadLog* wal, 
+  const std::string& image_path, uint64_t checkpoint_interval) {
+  assert(wal);
+  std::lock_guard<std::mutex> lock(mu_);
+  wal_ = wal;
+  checkpoint_image_path_ = image_path;
+  checkpoint_interval_ = checkpoint_interval;
+  record_since_checkpoint_ = 0;
+}
+
+bool CoBtree::Checkpoint(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mu_);
+  // the log is truncated, buffered records must be in the snapshot.
+  if (!FlushInsertBuffer()) return false;
+  const PMA* levels[3] = {&tree_.pma(), &pma_index_, &pma_data_};
+  if (path != checkpoint_path_) {
+    // the files hold an unknown state unless this is the first checkpoint
+    // of a constructed tree, whose unmodified segments are all empty, and 
+    // the slot file does not exist yet. a snapshot left at the path by 
+    // another tree must not win over ours: continue after its sequence.
+    auto known = checkpoint_path_.empty() && !snapshot_;
+    for (uint64_t i = 0; i < 2; i++) {
+      checkpoint_full_[i] = !known 
+        || (::access(SnapshotFile(path, i).c_str(), F_OK) == 0);
+      SnapshotHeader existing;
+      if (ReadSnapshotHeader(path, i, &existing)) {
+        checkpoint_sequence_ = std::max(checkpoint_sequence_, 
+          existing.sequence);
+      }
+    }
+    checkpoint_path_ = path;
+  }
+  // write to the slot not holding the latest snapshot.
+  auto slot = 1 - checkpoint_slot_;
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kSnapshotMagic;
+  header.sequence = checkpoint_sequence_ + 1;
+  header.checkpoint_lsn = (wal_) ? wal_->last_lsn() : 0;
+  header.record_count_l3 = record_count_l3;
+  header.item_count_l2 = item_count_l2;
+  header.leaf_count_l1 = leaf_count_l1;
+  header.tree = tree_.layout();
+  uint64_t offset = kSnapshotPageSize;
+  for (int i = 0; i < 3; i++) {
+    header.level[i] = levels[i]->layout();
+    header.item_count_offset[i] = offset;
+    offset = AlignToPage(offset + levels[i]->segment_count() 
+      * sizeof(uint64_t));
+    if (i == 0) {
+      header.element_count_offset = offset;
+      offset = AlignToPage(offset + levels[i]->segment_count() 
+        * sizeof(uint64_t));
+    }
+    header.segments_offset[i] = offset;
+    offset = AlignToPage(offset + levels[i]->segment_count() 
+      * levels[i]->segment_bytes());
+  }
+  header.file_size = offset;
+  header.checksum = SnapshotChecksum(header);
+
+  auto fd = ::open(SnapshotFile(path, slot).c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+  bool success = (::ftruncate(fd, header.file_size) == 0);
+  uint64_t version[3];
+  for (int i = 0; success && (i < 3); i++) {
+    version[i] = levels[i]->version();
+    const auto& item_count = levels[i]->item_count();
+    success = levels[i]->FlushModifiedSegments(fd, header.segments_offset[i],
+        checkpoint_version_[slot][i], checkpoint_full_[slot])
+      && WriteAll(fd, item_count.data(), 
+        item_count.size() * sizeof(uint64_t), header.item_count_offset[i]);
+  }
+  const auto& element_count = tree_.element_count();
+  success = success 
+    && WriteAll(fd, element_count.data(), 
+      element_count.size() * sizeof(uint64_t), header.element_count_offset)
+    // the header goes last, after the body is durable.
+    && (::fdatasync(fd) == 0)
+    && WriteAll(fd, &header, sizeof(header), 0)
+    && (::fdatasync(fd) == 0);
+  ::close(fd);
+  if (!success) return false;
+
+  checkpoint_slot_ = slot;
+  checkpoint_sequence_ = header.sequence;
+  checkpoint_full_[slot] = false;
+  for (int i = 0; i < 3; i++) checkpoint_version_[slot][i] = version[i];
+  record_since_checkpoint_ = 0;
+  // the log before the checkpoint is no longer needed.
+  return (wal_) ? wal_->Truncate(header.checkpoint_lsn) : true;
+}
+
+std::unique_ptr<CoBtree> CoBtree::Open(const std::string& path,
+  const std::string& uid, Cache* cache) {
+  SnapshotHeader header;
+  SnapshotHeader candidate;
+  bool found = false;
+  uint64_t slot = 0;
+  for (uint64_t i = 0; i < 2; i++) {
+    if (!ReadSnapshotHeader(path, i, &candidate)) continue;
+    if (found && (candidate.sequence < header.sequence)) continue;
+    header = candidate;
+    slot = i;
+    found = true;
+  }
+  if (!found) return nullptr;
+  std::unique_ptr<MappedFile> snapshot(
+    new MappedFile(SnapshotFile(path, slot)));
+  if (!snapshot->ok() || (snapshot->size() < header.file_size)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<CoBtree> tree(new CoBtree(uid, cache, header, 
+    std::move(snapshot)));
+  // the mapped slot is up to date. the other one holds an older snapshot.
+  tree->checkpoint_path_ = path;
+  tree->checkpoint_slot_ = slot;
+  tree->checkpoint_sequence_ = header.sequence;
+  tree->checkpoint_full_[1 - slot] = true;
+  return tree;
+}
+
+uint64_t CoBtree::Recover() {
+  if (!wal_) return 0;
+  std::lock_guard<std::mutex> lock(mu_);
+  return wal_->Replay(recovery_lsn_, [this](const WALRecord& record) {
+    // the tree does not support deletion yet.
+    if (record.type == kWALInsert) InsertRecord(record.key, record.value);
+  });
+}
+
 }  // namespace cobtree
\ No newline at end of file
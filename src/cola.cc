@@ -0,0 +1,193 @@
+#include "cola.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <map>
+
+namespace cobtree {
+
+Cola::Cola(const std::string& id, uint64_t estimated_record_count,
+  Cache* cache)
+  : id_(id), cache_(cache),
+  // levels 0..L-1 hold up to 2^L - 1 records.
+  max_level_count_(std::ceil(std::log2(estimated_record_count + 1))),
+  storage_(new BlockDevice(((1ULL << (max_level_count_ + 1)) - 2)
+    * sizeof(ColaEntry))) {
+  assert(cache_);
+  assert(max_level_count_ > 0);
+}
+
+const ColaEntry* Cola::Load(uint64_t level, uint64_t pos,
+  uint64_t count) const {
+  auto offset = EntryOffset(level, pos);
+  auto len = count * sizeof(ColaEntry);
+  // count the transfers of the blocks (of the stats block size) touched.
+  auto block_size = cache_->block_size_for_stats();
+  cache_->RecordAccess(id_, offset / block_size, offset, len, false);
+  cache_->AccessRange(id_, offset, len);
+  char* ptr;
+  storage_->Read(offset, len, &ptr);
+  return reinterpret_cast<const ColaEntry*>(ptr);
+}
+
+void Cola::Store(uint64_t level, const std::vector<ColaEntry>& entries) {
+  assert(entries.size() <= (1ULL << (level + 1)));
+  Load(level, 0, entries.size());
+  storage_->Write(reinterpret_cast<const char*>(entries.data()),
+    EntryOffset(level, 0), entries.size() * sizeof(ColaEntry));
+}
+
+void Cola::Build(uint64_t level, const std::vector<ColaEntry>& records) {
+  // sample the next level in one sequential pass.
+  std::vector<ColaEntry> samples;
+  auto next = level + 1;
+  if (next < level_size_.size()) {
+    auto next_entries = Load(next, 0, level_size_[next]);
+    for (uint64_t pos = 0; pos < level_size_[next];
+      pos += kColaLookaheadStride) {
+      samples.push_back(ColaEntry{next_entries[pos].key, pos,
+        kColaLookahead, UINT64_MAX});
+    }
+  }
+
+  std::vector<ColaEntry> entries;
+  entries.reserve(records.size() + samples.size());
+  std::merge(records.begin(), records.end(), samples.begin(), samples.end(),
+    std::back_inserter(entries),
+    [](const ColaEntry& a, const ColaEntry& b) { return a.key < b.key; });
+  auto left_lookahead = UINT64_MAX;
+  for (auto& entry : entries) {
+    if (entry.type == kColaLookahead) left_lookahead = entry.value;
+    entry.left_lookahead = left_lookahead;
+  }
+  Store(level, entries);
+  level_size_[level] = entries.size();
+  level_record_count_[level] = records.size();
+}
+
+bool Cola::Get(uint64_t key, uint64_t* value) {
+  assert(value);
+  // the search range in the current level. level 0 is searched entirely.
+  uint64_t lo = 0;
+  uint64_t hi = UINT64_MAX;
+  for (uint64_t level = 0; level < level_size_.size(); level++) {
+    auto size = level_size_[level];
+    if (size == 0) {
+      lo = 0;
+      hi = UINT64_MAX;
+      continue;
+    }
+    hi = std::min(hi, size);
+    assert(lo < hi);
+    auto range = Load(level, lo, hi - lo);
+    auto entry_at = [&](uint64_t pos) {
+      return (pos < hi) ? &range[pos - lo] : Load(level, pos, 1);
+    };
+    // the first entry not smaller than key. it is within the range: the
+    // lookahead bounding the range from the right is not smaller than key.
+    auto pos = lo;
+    while ((pos < hi) && (entry_at(pos)->key < key)) pos++;
+    assert((pos < hi) || (hi == size));
+    // the entries with the same key may run past the range.
+    for (auto match = pos; match < size; match++) {
+      auto entry = entry_at(match);
+      if (entry->key != key) break;
+      if (entry->type == kColaRecord) {
+        *value = entry->value;
+        return true;
+      }
+    }
+    // narrow the next level to the stride following the last lookahead
+    // smaller than key.
+    if (pos == 0) {
+      lo = 0;
+    } else {
+      assert(pos > lo);
+      auto left_lookahead = entry_at(pos - 1)->left_lookahead;
+      lo = (left_lookahead == UINT64_MAX) ? 0 : left_lookahead;
+    }
+    hi = lo + kColaLookaheadStride + 1;
+  }
+  return false;
+}
+
+uint64_t Cola::Scan(uint64_t start_key, uint64_t end_key,
+  std::vector<L3Node>* records) {
+  assert(records);
+  // from the oldest level to the newest, so that newer records overwrite.
+  std::map<uint64_t, uint64_t> merged;
+  for (auto level = level_size_.size(); level > 0; level--) {
+    auto size = level_size_[level - 1];
+    // binary search the first entry not smaller than start_key.
+    uint64_t left = 0;
+    uint64_t right = size;
+    while (left < right) {
+      auto mid = left + (right - left) / 2;
+      if (Load(level - 1, mid, 1)->key < start_key) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    for (auto pos = left; pos < size; pos++) {
+      auto entry = Load(level - 1, pos, 1);
+      if (entry->key > end_key) break;
+      if (entry->type == kColaRecord) merged[entry->key] = entry->value;
+    }
+  }
+  for (const auto& record : merged) {
+    records->push_back(L3Node{record.first, record.second});
+  }
+  return merged.size();
+}
+
+bool Cola::Insert(uint64_t key, uint64_t value) {
+  // the levels above the first level without records are merged.
+  uint64_t target = 0;
+  while ((target < level_size_.size())
+    && (level_record_count_[target] > 0)) {
+    target++;
+  }
+
+  // gather the records from the newest to the oldest level, so that a
+  // stable sort keeps the newest record first among equal keys.
+  std::vector<ColaEntry> records;
+  records.reserve(1ULL << target);
+  records.push_back(ColaEntry{key, value, kColaRecord, UINT64_MAX});
+  for (uint64_t level = 0; level < target; level++) {
+    auto entries = Load(level, 0, level_size_[level]);
+    for (uint64_t pos = 0; pos < level_size_[level]; pos++) {
+      if (entries[pos].type == kColaRecord) records.push_back(entries[pos]);
+    }
+  }
+  std::stable_sort(records.begin(), records.end(),
+    [](const ColaEntry& a, const ColaEntry& b) { return a.key < b.key; });
+  records.erase(std::unique(records.begin(), records.end(),
+    [](const ColaEntry& a, const ColaEntry& b) { return a.key == b.key; }),
+    records.end());
+  assert(records.size() <= (1ULL << target));
+
+  // the smallest level holding the distinct records receives them, the 
+  // merged levels and the first level without records being empty after.
+  uint64_t dest = 0;
+  while ((1ULL << dest) < records.size()) dest++;
+  if (dest == max_level_count_) {
+    printf("cola full");
+    return false;
+  }
+  if (dest == level_size_.size()) {
+    level_size_.push_back(0);
+    level_record_count_.push_back(0);
+  }
+  // from the lowest level rebuilt, the emptied levels only keep the 
+  // lookaheads into the level below.
+  for (auto level = std::max(dest + 1, target); level > 0; level--) {
+    Build(level - 1, (level - 1 == dest) ? records 
+      : std::vector<ColaEntry>());
+  }
+  return true;
+}
+
+}  // namespace cobtree
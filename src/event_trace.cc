@@ -0,0 +1,135 @@
+#include "event_trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+
+namespace cobtree {
+
+namespace {
+
+// small sequential thread ids for the trace viewer.
+uint32_t CurrentThreadId() {
+  static std::atomic<uint32_t> next_thread_id{0};
+  thread_local uint32_t thread_id = next_thread_id.fetch_add(1);
+  return thread_id;
+}
+
+struct TraceEventFormat {
+  const char* name;
+  const char* category;
+  const char* arg_names[4]; // nullptr for unused args
+};
+
+const TraceEventFormat kTraceEventFormats[kTraceEventTypeCount] = {
+  {"rebalance", "pma", {"segment", "height", "left", "right"}},
+  {"rebalance-range", "pma",
+    {"left", "right", "items_moved", "bytes_copied"}},
+  {"node-split", "veb", {"node", "height", nullptr, nullptr}},
+  {"move-subtree", "veb", {"root", "height", "new_address", "bytes_copied"}},
+  {"l2-update", "cobtree",
+    {"l2_segment", "l3_segments", "l2_segments", nullptr}},
+  {"l1-update", "cobtree", {"leaf", "l2_segments", nullptr, nullptr}},
+  {"evict", "cache", {"bytes", "usage", nullptr, nullptr}},
+};
+
+// device names are ids and paths, only quotes and backslashes are escaped.
+std::string JsonEscape(const std::string& text) {
+  std::string escaped;
+  for (auto c : text) {
+    if ((c == '"') || (c == '\\')) escaped.push_back('\\');
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+}  // anonymous namespace
+
+EventTracer::EventTracer(uint64_t capacity) : events_(capacity), next_(0) {
+  assert(capacity > 0);
+}
+
+uint64_t EventTracer::NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t EventTracer::DeviceId(const std::string& device) {
+  std::lock_guard<std::mutex> lock(devices_mu_);
+  auto it = device_ids_.find(device);
+  if (it != device_ids_.end()) return it->second;
+  devices_.push_back(device);
+  device_ids_.emplace(device, devices_.size() - 1);
+  return devices_.size() - 1;
+}
+
+void EventTracer::Record(TraceEventType type, uint32_t device,
+  uint64_t start_ns, uint64_t duration_ns, const uint64_t* args) {
+  assert(type < kTraceEventTypeCount);
+  auto slot = next_.fetch_add(1, std::memory_order_relaxed) % events_.size();
+  auto& event = events_[slot];
+  event.start_ns = start_ns;
+  event.duration_ns = duration_ns;
+  event.type = type;
+  event.device = device;
+  event.thread = CurrentThreadId();
+  for (int i = 0; i < 4; i++) event.args[i] = args[i];
+}
+
+std::vector<TraceEvent> EventTracer::Events() const {
+  auto recorded = recorded_count();
+  auto capacity = events_.size();
+  if (recorded <= capacity) {
+    return std::vector<TraceEvent>(events_.begin(),
+      events_.begin() + recorded);
+  }
+  // the oldest retained event is in the slot written next.
+  auto oldest = recorded % capacity;
+  std::vector<TraceEvent> events(events_.begin() + oldest, events_.end());
+  events.insert(events.end(), events_.begin(), events_.begin() + oldest);
+  return events;
+}
+
+void EventTracer::ExportChromeTrace(std::ostream* out) const {
+  assert(out);
+  auto events = Events();
+  // timestamps relative to the first retained event, in microseconds.
+  uint64_t origin = UINT64_MAX;
+  for (const auto& event : events) {
+    origin = std::min(origin, event.start_ns);
+  }
+  (*out) << "{\"traceEvents\":[";
+  char buffer[128];
+  bool first = true;
+  for (const auto& event : events) {
+    const auto& format = kTraceEventFormats[event.type];
+    (*out) << (first ? "\n" : ",\n");
+    first = false;
+    snprintf(buffer, sizeof(buffer), "%.3f", (event.start_ns - origin) / 1e3);
+    (*out) << "{\"name\":\"" << format.name << "\",\"cat\":\""
+      << format.category << "\",\"pid\":0,\"tid\":" << event.thread
+      << ",\"ts\":" << buffer;
+    if (event.duration_ns > 0) {
+      snprintf(buffer, sizeof(buffer), "%.3f", event.duration_ns / 1e3);
+      (*out) << ",\"ph\":\"X\",\"dur\":" << buffer;
+    } else {
+      (*out) << ",\"ph\":\"i\",\"s\":\"t\"";
+    }
+    (*out) << ",\"args\":{\"device\":\""
+      << JsonEscape(devices_[event.device]) << "\"";
+    for (int i = 0; i < 4; i++) {
+      if (!format.arg_names[i]) continue;
+      (*out) << ",\"" << format.arg_names[i] << "\":" << event.args[i];
+    }
+    (*out) << "}}";
+  }
+  (*out) << "\n]}\n";
+}
+
+const char* EventTracer::EventName(TraceEventType type) {
+  assert(type < kTraceEventTypeCount);
+  return kTraceEventFormats[type].name;
+}
+
+}  // namespace cobtree
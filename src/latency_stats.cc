@@ -0,0 +1,196 @@
+#include "latency_stats.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace cobtree {
+
+namespace {
+
+const uint64_t kExactBucketCount = 1ULL << LatencyHistogram::kSubBucketBits;
+const uint64_t kSubBucketCount = kExactBucketCount >> 1;
+const uint64_t kBucketCount = kExactBucketCount + kSubBucketCount
+  * (LatencyHistogram::kMaxValueBits - LatencyHistogram::kSubBucketBits);
+const uint64_t kMaxValue = (1ULL << LatencyHistogram::kMaxValueBits) - 1;
+
+const double kDumpPercentiles[] = {50, 90, 99, 99.9};
+
+void AtomicMin(std::atomic<uint64_t>* target, uint64_t value) {
+  auto current = target->load(std::memory_order_relaxed);
+  while ((value < current) && !target->compare_exchange_weak(current, value,
+    std::memory_order_relaxed)) {}
+}
+
+void AtomicMax(std::atomic<uint64_t>* target, uint64_t value) {
+  auto current = target->load(std::memory_order_relaxed);
+  while ((value > current) && !target->compare_exchange_weak(current, value,
+    std::memory_order_relaxed)) {}
+}
+
+void DumpHistogram(std::ostream* out, const char* name,
+  const LatencyHistogram& histogram) {
+  char line[256];
+  auto len = snprintf(line, sizeof(line), "%-28s %10lu  mean %9.2f", name,
+    histogram.count(), histogram.mean() / 1e3);
+  for (auto percentile : kDumpPercentiles) {
+    len += snprintf(line + len, sizeof(line) - len, "  p%g %9.2f", percentile,
+      histogram.ValueAtPercentile(percentile) / 1e3);
+  }
+  snprintf(line + len, sizeof(line) - len, "  max %9.2f us\n",
+    histogram.max() / 1e3);
+  (*out) << line;
+}
+
+}  // anonymous namespace
+
+LatencyHistogram::LatencyHistogram() : buckets_(kBucketCount) {
+  Reset();
+}
+
+uint64_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < kExactBucketCount) return value;
+  // keep the kSubBucketBits - 1 bits below the leading one.
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - (kSubBucketBits - 1);
+  return kExactBucketCount + (msb - kSubBucketBits) * kSubBucketCount
+    + ((value >> shift) - kSubBucketCount);
+}
+
+uint64_t LatencyHistogram::BucketValue(uint64_t index) {
+  if (index < kExactBucketCount) return index;
+  auto exponent = (index - kExactBucketCount) / kSubBucketCount;
+  auto sub_bucket = kSubBucketCount + (index - kExactBucketCount)
+    % kSubBucketCount;
+  auto shift = exponent + 1;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+  if (value > kMaxValue) value = kMaxValue;
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  AtomicMin(&min_, value);
+  AtomicMax(&max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (uint64_t i = 0; i < kBucketCount; i++) {
+    auto bucket_count = other.buckets_[i].load(std::memory_order_relaxed);
+    if (bucket_count > 0) {
+      buckets_[i].fetch_add(bucket_count, std::memory_order_relaxed);
+    }
+  }
+  if (other.count() == 0) return;
+  count_.fetch_add(other.count(), std::memory_order_relaxed);
+  sum_.fetch_add(other.sum_.load(std::memory_order_relaxed),
+    std::memory_order_relaxed);
+  AtomicMin(&min_, other.min());
+  AtomicMax(&max_, other.max());
+}
+
+void LatencyHistogram::Reset() {
+  for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  min_.store(UINT64_MAX, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+  auto samples = count();
+  return (samples > 0)
+    ? (double) sum_.load(std::memory_order_relaxed) / samples : 0.0;
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const {
+  auto samples = count();
+  if (samples == 0) return 0;
+  auto rank = static_cast<uint64_t>(percentile / 100 * samples + 0.5);
+  if (rank == 0) rank = 1;
+  uint64_t seen = 0;
+  for (uint64_t i = 0; i < kBucketCount; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      // no sample exceeds the max.
+      auto value = BucketValue(i);
+      return (value < max()) ? value : max();
+    }
+  }
+  return max();
+}
+
+OpLatencyStats::OpLatencyStats(const std::vector<int>& max_height) {
+  assert(max_height.size() == kLevelCount);
+  for (int level = 0; level < kLevelCount; level++) {
+    for (int height = 1; height <= max_height[level]; height++) {
+      rebalance_[level].emplace_back(new LatencyHistogram());
+    }
+  }
+}
+
+void OpLatencyStats::Record(LatencyOp op, LatencyPath path,
+  const int* rebalance_height, uint64_t latency_ns) {
+  op_[op][path].Record(latency_ns);
+  if (!rebalance_height) return;
+  for (int level = 0; level < kLevelCount; level++) {
+    auto height = rebalance_height[level];
+    if ((height >= 1) && (height <= (int) rebalance_[level].size())) {
+      rebalance_[level][height - 1]->Record(latency_ns);
+    }
+  }
+}
+
+const LatencyHistogram* OpLatencyStats::rebalance_histogram(int level,
+  int height) const {
+  assert((level >= 0) && (level < kLevelCount));
+  if ((height < 1) || (height > (int) rebalance_[level].size())) {
+    return nullptr;
+  }
+  return rebalance_[level][height - 1].get();
+}
+
+void OpLatencyStats::Reset() {
+  for (auto& op_histograms : op_) {
+    for (auto& histogram : op_histograms) histogram.Reset();
+  }
+  for (auto& level_histograms : rebalance_) {
+    for (auto& histogram : level_histograms) histogram->Reset();
+  }
+}
+
+void OpLatencyStats::Dump(std::ostream* out) const {
+  assert(out);
+  char name[64];
+  for (int op = 0; op < kLatencyOpCount; op++) {
+    for (int path = 0; path < kLatencyPathCount; path++) {
+      const auto& histogram = op_[op][path];
+      if (histogram.count() == 0) continue;
+      snprintf(name, sizeof(name), "%s/%s", OpName(LatencyOp(op)),
+        PathName(LatencyPath(path)));
+      DumpHistogram(out, name, histogram);
+    }
+  }
+  const char* const level_names[kLevelCount] = {"l1", "l2", "l3"};
+  for (int level = 0; level < kLevelCount; level++) {
+    for (uint64_t i = 0; i < rebalance_[level].size(); i++) {
+      if (rebalance_[level][i]->count() == 0) continue;
+      snprintf(name, sizeof(name), "rebalance/%s/height-%lu",
+        level_names[level], i + 1);
+      DumpHistogram(out, name, *rebalance_[level][i]);
+    }
+  }
+}
+
+const char* OpLatencyStats::OpName(LatencyOp op) {
+  const char* const names[kLatencyOpCount] = {"get", "insert", "scan"};
+  return names[op];
+}
+
+const char* OpLatencyStats::PathName(LatencyPath path) {
+  const char* const names[kLatencyPathCount] = {"read", "buffered", "update",
+    "l3-insert", "l2-update", "l1-update", "node-split", "root-split"};
+  return names[path];
+}
+
+}  // namespace cobtree
@@ -0,0 +1,170 @@
+#include "learned_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include "type.h"
+
+namespace cobtree {
+
+LearnedSegmentIndex::LearnedSegmentIndex(uint64_t segment_count,
+  uint64_t max_error) : max_error_(max_error),
+  first_keys_(segment_count, UINT64_MAX), keys_(segment_count, UINT64_MAX),
+  size_(0), hit_count_(0), miss_count_(0) {
+  assert(segment_count > 0);
+}
+
+void LearnedSegmentIndex::Fit(uint64_t begin, uint64_t end,
+  std::vector<Model>* models) const {
+  const double error = double(max_error_);
+  auto first = begin;
+  while (first < end) {
+    // shrink the cone of slopes fitting every point so far.
+    double lo = 0;
+    double hi = std::numeric_limits<double>::infinity();
+    auto s = first + 1;
+    for (; s < end; s++) {
+      double dy = double(s - first);
+      if (keys_[s] == keys_[first]) {
+        if (dy > error) break;
+        continue;
+      }
+      double dx = double(keys_[s] - keys_[first]);
+      auto new_lo = std::max(lo, (dy - error) / dx);
+      auto new_hi = std::min(hi, (dy + error) / dx);
+      if (new_lo > new_hi) break;
+      lo = new_lo;
+      hi = new_hi;
+    }
+    auto slope = (hi == std::numeric_limits<double>::infinity())
+      ? lo : (lo + hi) / 2;
+    models->push_back(Model{keys_[first], first, s, slope});
+    first = s;
+  }
+}
+
+uint64_t LearnedSegmentIndex::ModelOf(uint64_t segment_id) const {
+  auto it = std::upper_bound(models_.begin(), models_.end(), segment_id,
+    [](uint64_t id, const Model& model) { return id < model.first_segment; });
+  if (it == models_.begin()) return models_.size();
+  --it;
+  if (segment_id >= it->end_segment) return models_.size();
+  return it - models_.begin();
+}
+
+void LearnedSegmentIndex::Update(uint64_t first_segment,
+  const std::vector<uint64_t>& first_keys) {
+  if (first_keys.empty()) return;
+  auto end = first_segment + first_keys.size();
+  assert(end <= first_keys_.size());
+  std::copy(first_keys.begin(), first_keys.end(),
+    first_keys_.begin() + first_segment);
+
+  // an empty segment before the range takes a first key from it.
+  auto lo = first_segment;
+  while ((lo > 0) && (first_keys_[lo - 1] == UINT64_MAX)) lo--;
+  for (auto s = end; s > lo; s--) {
+    auto next_key = (s < keys_.size()) ? keys_[s] : UINT64_MAX;
+    keys_[s - 1] = (first_keys_[s - 1] == UINT64_MAX)
+      ? next_key : first_keys_[s - 1];
+  }
+  auto old_size = size_;
+  size_ = std::max(size_, end);
+  while ((size_ > 0) && (first_keys_[size_ - 1] == UINT64_MAX)) size_--;
+
+  // refit the models covering the changed segments, or extend the last one
+  // when the segments are past them.
+  auto from = std::min(lo, std::min(old_size, size_));
+  auto begin_model = (from == 0) ? 0 : ModelOf(from - 1);
+  auto refit_begin = (from == 0) ? 0 : models_[begin_model].first_segment;
+  auto end_model = models_.size();
+  auto refit_end = size_;
+  if (size_ == old_size) {
+    auto last_model = ModelOf(end - 1);
+    if ((end <= size_) && (last_model < models_.size())) {
+      end_model = last_model + 1;
+      refit_end = models_[last_model].end_segment;
+    }
+  }
+  assert(refit_begin <= refit_end);
+
+  std::vector<Model> refit;
+  Fit(refit_begin, refit_end, &refit);
+  models_.erase(models_.begin() + begin_model, models_.begin() + end_model);
+  models_.insert(models_.begin() + begin_model, refit.begin(), refit.end());
+}
+
+void LearnedSegmentIndex::Refresh(const PMA& level2, uint64_t first,
+  uint64_t last) {
+  assert(level2.segment_count() == first_keys_.size());
+  assert(first <= last);
+  // from the last segment, the first in the index.
+  std::vector<uint64_t> first_keys;
+  first_keys.reserve(last - first + 1);
+  for (auto segment_id = last + 1; segment_id > first; segment_id--) {
+    auto segment = level2.GetView(segment_id - 1);
+    // the smallest key of a segment is at its end.
+    first_keys.push_back((segment.num_item() == 0) ? UINT64_MAX
+      : reinterpret_cast<L2Node*>(segment.LoadItem(
+        level2.segment_size() - 1))->key);
+  }
+  Update(mirror(last), first_keys);
+}
+
+void LearnedSegmentIndex::Refresh(const PMA& level2, uint64_t l2_segment_id,
+  const PMAUpdateContext& l3_ctx, const PMAUpdateContext& l2_ctx) {
+  auto span = l3_ctx.updated_segment.size();
+  auto first = (l2_segment_id > span) ? l2_segment_id - span : 0;
+  auto last = std::min(l2_segment_id + span, level2.segment_count() - 1);
+  for (auto& segment : l2_ctx.updated_segment) {
+    first = std::min(first, segment.segment_id);
+    last = std::max(last, segment.segment_id);
+  }
+  Refresh(level2, first, last);
+}
+
+bool LearnedSegmentIndex::Find(uint64_t key, uint64_t* segment_id) {
+  assert(segment_id);
+  // the last model starting at or before the key holds the segment.
+  auto it = std::upper_bound(models_.begin(), models_.end(), key,
+    [](uint64_t k, const Model& model) { return k < model.first_key; });
+  if (it == models_.begin()) {
+    miss_count_++;
+    return false;
+  }
+  --it;
+  auto predicted = double(it->first_segment)
+    + it->slope * double(key - it->first_key);
+  auto last = double(it->end_segment - 1);
+  auto p = uint64_t(std::min(predicted, last));
+  // one more on each side for the rounding and the key between two points.
+  auto window_begin = std::max(it->first_segment,
+    (p > max_error_ + 1) ? p - max_error_ - 1 : 0);
+  auto window_end = std::min(it->end_segment, p + max_error_ + 2);
+  auto s = std::upper_bound(keys_.begin() + window_begin,
+    keys_.begin() + window_end, key) - keys_.begin();
+  if ((uint64_t(s) == window_begin) || ((uint64_t(s) < size_)
+    && (keys_[s] <= key))) {
+    miss_count_++;
+    return false;
+  }
+  s--;
+  if (first_keys_[s] == UINT64_MAX) {
+    miss_count_++;
+    return false;
+  }
+  hit_count_++;
+  *segment_id = s;
+  return true;
+}
+
+bool LearnedSegmentIndex::FindSegment(uint64_t key, 
+  uint64_t* l2_segment_id) {
+  assert(l2_segment_id);
+  uint64_t segment_id;
+  if (!Find(key, &segment_id)) return false;
+  *l2_segment_id = mirror(segment_id);
+  return true;
+}
+
+}  // namespace cobtree
@@ -0,0 +1,102 @@
+#include "memory_hierarchy.h"
+
+#include <cassert>
+#include <sstream>
+
+namespace cobtree {
+
+MemoryHierarchy::MemoryHierarchy(
+  const std::vector<MemoryLevelOption>& options) {
+  for (const auto& option : options) {
+    // a level holds at least one block.
+    assert(option.block_size > 0);
+    assert(option.capacity >= option.block_size);
+    levels_.emplace_back(option);
+  }
+}
+
+bool MemoryHierarchy::ParseLevels(const std::string& description,
+  std::vector<MemoryLevelOption>* options) {
+  assert(options);
+  std::vector<MemoryLevelOption> parsed;
+  std::stringstream stream{description};
+  std::string level;
+  while (std::getline(stream, level, ',')) {
+    auto colon = level.find(':');
+    if (colon == std::string::npos) return false;
+    uint64_t block_size;
+    uint64_t capacity;
+    try {
+      block_size = std::stoull(level.substr(0, colon));
+      capacity = std::stoull(level.substr(colon + 1));
+    } catch (...) {
+      return false;
+    }
+    if ((block_size == 0) || (capacity < block_size)) return false;
+    parsed.push_back(MemoryLevelOption{"L" + std::to_string(parsed.size() + 1),
+      block_size, capacity});
+  }
+  if (parsed.empty()) return false;
+  *options = std::move(parsed);
+  return true;
+}
+
+void MemoryHierarchy::Access(const std::string& device, uint64_t offset,
+  uint64_t len) {
+  if (len == 0) return;
+  auto it = devices_.find(device);
+  if (it == devices_.end()) {
+    it = devices_.emplace(device, devices_.size()).first;
+  }
+  std::vector<std::pair<uint64_t, uint64_t>> ranges{{offset, offset + len}};
+  for (auto& level : levels_) {
+    std::vector<std::pair<uint64_t, uint64_t>> missed;
+    for (const auto& range : ranges) {
+      auto level_missed = AccessLevel(&level, it->second, range.first,
+        range.second);
+      missed.insert(missed.end(), level_missed.begin(), level_missed.end());
+    }
+    if (missed.empty()) return;
+    ranges.swap(missed);
+  }
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> MemoryHierarchy::AccessLevel(
+  Level* level, uint64_t device, uint64_t begin, uint64_t end) {
+  std::vector<std::pair<uint64_t, uint64_t>> missed;
+  auto block_size = level->option.block_size;
+  auto max_block_count = level->option.capacity / block_size;
+  for (auto block = begin / block_size; block <= (end - 1) / block_size;
+    block++) {
+    level->stats.access_count++;
+    BlockId id{device, block};
+    auto found = level->blocks.find(id);
+    if (found != level->blocks.end()) {
+      // move to the front of the lru list.
+      level->lru_list.splice(level->lru_list.begin(), level->lru_list,
+        found->second);
+      continue;
+    }
+    level->stats.transfer_count++;
+    if (level->blocks.size() == max_block_count) {
+      level->blocks.erase(level->lru_list.back());
+      level->lru_list.pop_back();
+    }
+    level->lru_list.push_front(id);
+    level->blocks.emplace(id, level->lru_list.begin());
+    // merge adjacent missed blocks into one range for the next level.
+    auto block_begin = block * block_size;
+    if (!missed.empty() && (missed.back().second == block_begin)) {
+      missed.back().second += block_size;
+    } else {
+      missed.emplace_back(block_begin, block_begin + block_size);
+    }
+  }
+  return missed;
+}
+
+void MemoryHierarchy::ResetStats() {
+  for (auto& level : levels_) level.stats = MemoryLevelStats{0, 0};
+}
+
+}  // namespace cobtree
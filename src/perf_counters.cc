@@ -0,0 +1,135 @@
+#include "perf_counters.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace cobtree {
+
+namespace {
+
+struct PerfEventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+const PerfEventConfig kPerfEventConfigs[kPerfEventCount] = {
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+};
+
+int OpenPerfEvent(const PerfEventConfig& event, int group_fd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // the calling thread on any cpu.
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+}  // anonymous namespace
+
+PerfCounterGroup::PerfCounterGroup() : leader_fd_(-1), opened_count_(0) {
+  // the first event that opens leads the group.
+  for (int i = 0; i < kPerfEventCount; i++) {
+    fd_[i] = OpenPerfEvent(kPerfEventConfigs[i], leader_fd_);
+    position_[i] = -1;
+    if (fd_[i] < 0) continue;
+    if (leader_fd_ < 0) leader_fd_ = fd_[i];
+    position_[i] = opened_count_++;
+  }
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+  for (int i = 0; i < kPerfEventCount; i++) {
+    if (fd_[i] >= 0) close(fd_[i]);
+  }
+}
+
+bool PerfCounterGroup::Read(PerfCounts* counts) const {
+  assert(counts);
+  if (!ok()) return false;
+  // the number of events followed by their values in opening order.
+  uint64_t buffer[kPerfEventCount + 1];
+  auto len = read(leader_fd_, buffer, sizeof(buffer));
+  if ((len < (ssize_t) sizeof(uint64_t))
+    || (buffer[0] != (uint64_t) opened_count_)) return false;
+  for (int i = 0; i < kPerfEventCount; i++) {
+    counts->value[i] = (position_[i] >= 0) ? buffer[position_[i] + 1] : 0;
+  }
+  return true;
+}
+
+PerfCounterGroup* PerfCounterGroup::ThisThread() {
+  thread_local std::unique_ptr<PerfCounterGroup> group(
+    new PerfCounterGroup());
+  return group.get();
+}
+
+const char* PerfCounterGroup::EventName(PerfEvent event) {
+  const char* const names[kPerfEventCount] = {"cache-misses",
+    "dtlb-misses", "branch-misses", "instructions"};
+  return names[event];
+}
+
+PerfProbeStats::PerfProbeStats() {
+  Reset();
+}
+
+void PerfProbeStats::Add(PerfProbe probe, const PerfCounts& begin,
+  const PerfCounts& end) {
+  calls_[probe].fetch_add(1, std::memory_order_relaxed);
+  for (int i = 0; i < kPerfEventCount; i++) {
+    if (end.value[i] > begin.value[i]) {
+      counts_[probe][i].fetch_add(end.value[i] - begin.value[i],
+        std::memory_order_relaxed);
+    }
+  }
+}
+
+void PerfProbeStats::Reset() {
+  for (int probe = 0; probe < kPerfProbeCount; probe++) {
+    calls_[probe].store(0, std::memory_order_relaxed);
+    for (auto& count : counts_[probe]) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void PerfProbeStats::Dump(std::ostream* out) const {
+  assert(out);
+  char line[256];
+  for (int probe = 0; probe < kPerfProbeCount; probe++) {
+    auto calls = call_count(PerfProbe(probe));
+    if (calls == 0) continue;
+    auto len = snprintf(line, sizeof(line), "%-20s %10lu calls",
+      ProbeName(PerfProbe(probe)), calls);
+    for (int event = 0; event < kPerfEventCount; event++) {
+      len += snprintf(line + len, sizeof(line) - len, "  %10.2f %s",
+        (double) count(PerfProbe(probe), PerfEvent(event)) / calls,
+        PerfCounterGroup::EventName(PerfEvent(event)));
+    }
+    snprintf(line + len, sizeof(line) - len, " per call\n");
+    (*out) << line;
+  }
+}
+
+const char* PerfProbeStats::ProbeName(PerfProbe probe) {
+  const char* const names[kPerfProbeCount] = {"cobtree-get",
+    "cobtree-insert", "veb-get", "pma-rebalance-range"};
+  return names[probe];
+}
+
+}  // namespace cobtree
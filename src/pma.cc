@@ -1,24 +1,91 @@
 #include "pma.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <queue>
+#include <unistd.h>
 
 namespace cobtree {
 
+namespace {
+const uintptr_t kCacheLineSize = 64;
+}  // anonymous namespace
+
+char* PMASegmentView::Load(uint64_t offset, uint64_t len) const {
+  assert(offset + len <= len_);
+  pma_->AccessRange(segment_id_, offset, len);
+  return content_ + offset;
+}
+
+char* PMASegmentView::LoadItem(uint64_t pos) const {
+  return Load(pos * pma_->item_size_, pma_->item_size_);
+}
+
+void PMASegmentView::Prefetch(uint64_t offset, uint64_t len) const {
+  assert(offset + len <= len_);
+  if (len == 0) return;
+  // one prefetch per cache line.
+  auto line = reinterpret_cast<uintptr_t>(content_ + offset) 
+    & ~(kCacheLineSize - 1);
+  auto end = reinterpret_cast<uintptr_t>(content_ + offset + len);
+  for (; line < end; line += kCacheLineSize) {
+    __builtin_prefetch(reinterpret_cast<const void*>(line));
+  }
+}
+
+void PMASegmentView::PrefetchItems() const {
+  auto bytes = std::min(len_, (num_item_ + 1) * pma_->item_size_);
+  Prefetch(len_ - bytes, bytes);
+}
+
+bool PMASegmentView::Resident(uint64_t offset, uint64_t len) const {
+  assert(offset + len <= len_);
+  return pma_->RangeResident(segment_id_, offset, len);
+}
+
+bool PMASegmentView::ItemsResident() const {
+  auto bytes = std::min(len_, (num_item_ + 1) * pma_->item_size_);
+  return pma_->RangeResident(segment_id_, len_ - bytes, bytes);
+}
+
+uint32_t PMA::trace_device() const {
+  auto tracer = event_tracer();
+  if (!tracer) return 0;
+  if (trace_generation_ != cache_->event_tracer_generation()) {
+    trace_device_ = tracer->DeviceId(id_);
+    trace_generation_ = cache_->event_tracer_generation();
+  }
+  return trace_device_;
+}
+
+void PMA::AccessRange(uint64_t segment_id, uint64_t offset,
+  uint64_t len) const {
+  auto device_offset = segment_id * segment_size_ * item_size_ + offset;
+  cache_->RecordAccess(id_, segment_id, device_offset, len, false);
+  cache_->AccessRange(id_, device_offset, len);
+}
+
+bool PMA::RangeResident(uint64_t segment_id, uint64_t offset,
+  uint64_t len) const {
+  return cache_->Resident(id_, 
+    segment_id * segment_size_ * item_size_ + offset, len);
+}
+
 PMASegment PMA::Get(uint64_t segment_id) const {
+  auto view = GetView(segment_id);
+  return PMASegment{view.Load(0, view.len()), view.len(), view.num_item()};
+}
+
+PMASegmentView PMA::GetView(uint64_t segment_id) const {
   assert(segment_id < segment_count_);
-  std::string cache_key{CreatePMACacheKey(id_, segment_id)};
-  char* ptr = cache_->Get(cache_key);
-  if (ptr == nullptr) {
-    // ptr = storage_.get()->buffer_.get() + segment_id * segment_size_;
-    auto read_len = storage_->Read((segment_id * segment_size_) * item_size_, 
-      segment_size_ * item_size_, &ptr);
-    assert(read_len == segment_size_* item_size_); // the segment should have a space already allocated in block device.
-    // add it to cache.
-    cache_->Add(cache_key, ptr, read_len);
-  }
-  return PMASegment{ptr, segment_size_ * item_size_, item_count_[segment_id]};
+  char* ptr;
+  auto read_len = storage_->Read((segment_id * segment_size_) * item_size_, 
+    segment_size_ * item_size_, &ptr);
+  assert(read_len == segment_size_* item_size_); // the segment should have a space already allocated in block device.
+  (void) read_len;
+  return PMASegmentView{this, segment_id, ptr, segment_size_ * item_size_,
+    item_count_[segment_id]};
 }
 
 PMASegmentCopy PMA::GetCopy(uint64_t segment_id) const {
@@ -36,9 +103,11 @@ bool PMA::Add(const char *item, uint64_t segment_id, uint64_t pos, PMAUpdateCont
   PMASegment segment = Get(segment_id);
   // by construction, when executed correctly, PMA never reaches a status where we have no free space in a segment.
   assert(pos > 0);
+  MarkModified(segment_id);
   // shift all item to the left of pos (pos inclusive) left by one position
   // to make space for insertion
-  std::memcpy(segment.content, segment.content + item_size_, pos * item_size_);
+  std::memmove(segment.content, segment.content + item_size_, 
+    pos * item_size_);
   std::memcpy(segment.content + pos * item_size_, item, item_size_);
   item_count_[segment_id]++;
 
@@ -46,6 +115,17 @@ bool PMA::Add(const char *item, uint64_t segment_id, uint64_t pos, PMAUpdateCont
   return Rebalance(segment_id, ctx);
 }
 
+bool PMA::Rewrite(uint64_t segment_id, const char* items, uint64_t num_item,
+  PMAUpdateContext* ctx) {
+  assert(num_item < segment_size_);
+  PMASegment segment = Get(segment_id);
+  MarkModified(segment_id);
+  std::memcpy(segment.content + (segment_size_ - num_item) * item_size_,
+    items, num_item * item_size_);
+  item_count_[segment_id] = num_item;
+  return Rebalance(segment_id, ctx);
+}
+
 // we want to ensure there is at least 1 item in every segment after redistribution.
 // due to rounding. the redistribution can be for 27 item over 8
 //  1 2 4 4 4 4 4 4
@@ -70,13 +150,6 @@ struct RedistributionCtx {
       non_target_non_one_value = 1 + remain;
       first_non_one_segment--;
     }
-    printf("start segment: %lu, #segment: %lu, first non one: %lu,\
-      first match target: %lu, target item: %lu\n", starting_segment,
-      num_segment, first_non_one_segment, first_match_target_segment, target_item_per_segment);
-    if (first_non_one_segment != first_match_target_segment) {
-      printf("segment %lu has %lu item\n", first_non_one_segment, 
-        non_target_non_one_value);
-    }
   }
 
   uint64_t get_target_item(uint64_t segment_id) const {
@@ -104,11 +177,19 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
   
   // calculate the target item count for each segment
   auto num_segment = right - left + 1;
+  COBTREE_TRACE_SCOPE(trace, event_tracer(), kTracePMARebalanceRange, 
+    trace_device());
+  PerfScope perf(perf_stats(), kProbePMARebalanceRange);
+  COBTREE_TRACE_ARG(trace, 0, left);
+  COBTREE_TRACE_ARG(trace, 1, right);
+  COBTREE_TRACE_ARG(trace, 2, item_count);
+  COBTREE_TRACE_ARG(trace, 3, item_count * item_size_);
   // create the redistribution context. it ensures that at least one item in a segment.
   RedistributionCtx redistribution_ctx{left, num_segment, item_count};
 
   // clear context and set if empty segment filled.
   ctx->clear();
+  for (auto i = left; i < right+1; i++) MarkModified(i);
 
   auto src_segment_id = right;
   char* src_segment = Get(right).content;
@@ -118,21 +199,6 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
   auto dest_segment = Get(right).content;
   auto dest_offset = segment_size_ - 1;
   
-  // { 
-  //   if (src_segment_item_count > 0) {
-  //     // printed src segment content as uint64_t.
-  //     auto pitr = reinterpret_cast<uint64_t*>(src_segment + segment_size_ * item_size_ 
-  //       - sizeof(uint64_t));\
-  //     auto start = pitr;
-  //     std::cout << "data in source component " << src_segment_id << "\n";  
-  //     auto end = start - src_segment_item_count * item_size_ / sizeof(uint64_t);
-  //     while (pitr != end) {
-  //       std::cout << *pitr << " ";
-  //       pitr--;
-  //     }
-  //     std::cout << "\n";
-  //   }
-  // }
   auto curr_item_to_copy = redistribution_ctx.get_target_item(right);
   auto num_item_left = item_count;
   // when dest is smaller than src, it copy the content and push it here. later src will read from the unmodified old state of segment.
@@ -143,52 +209,12 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
 
     if (actual_copy_count > 0) {
 
-      // #ifndef NDEBUG
-      // { 
-      //   // printed copied content as uint64_t.
-      //   auto pitr = reinterpret_cast<uint64_t*>(src_segment + (src_offset - actual_copy_count + 1) * item_size_);\
-      //   auto start = pitr;
-      //   std::cout << "copied data from segment " << src_segment_id << " offset " 
-      //     << src_offset << "\n";  
-      //   while (pitr != start + actual_copy_count * item_size_ / sizeof(uint64_t)) {
-      //     std::cout << *pitr << " ";
-      //     pitr++;
-      //   }
-      //   std::cout << "\n";
-      // }
-      // #endif // NDEBUG
       std::memcpy(dest_segment + (dest_offset - actual_copy_count + 1) * item_size_,
         src_segment + (src_offset - actual_copy_count + 1) * item_size_,
         actual_copy_count * item_size_);
 
-      // #ifndef NDEBUG
-      // { 
-      //   // printed copied content as uint64_t.
-      //   auto pitr = reinterpret_cast<uint64_t*>(dest_segment + (dest_offset - actual_copy_count + 1) * item_size_);\
-      //   auto start = pitr;
-      //   std::cout  << " to segment " << dest_segment_id << " offset " << dest_offset << "\n";  
-      //   while (pitr != start + actual_copy_count * item_size_ / sizeof(uint64_t)) {
-      //     std::cout << *pitr << " ";
-      //     pitr++;
-      //   }
-      //   std::cout << "\n";
-      // }
-      // #endif // NDEBUG
       num_item_left -= actual_copy_count;
     }
-      // {
-      //   auto segment = Get(1);
-      //   // printed dest segment content as uint64_t.
-      //   auto pitr = reinterpret_cast<uint64_t*>(segment.content + (segment_size_) * item_size_ 
-      //     - sizeof(uint64_t));\
-      //   auto start = pitr;
-      //   std::cout << "data in dest component " << 1  << "\n";  
-      //   while (pitr != start - redistribution_ctx.get_target_item(1) * item_size_ / sizeof(uint64_t)) {
-      //     std::cout << *pitr << " ";
-      //     pitr--;
-      //   }
-      //   std::cout << "\n";
-      // }
     
     // adjust src offset to copy
     if ((actual_copy_count == src_segment_left)
@@ -208,20 +234,6 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
       // check if we should read from segment copy.
       src_offset = segment_size_ - 1; 
       src_segment_item_count = item_count_[src_segment_id];
-      // { 
-      //   if (src_segment_item_count > 0) {
-      //     // printed src segment content as uint64_t.
-      //     auto pitr = reinterpret_cast<uint64_t*>(src_segment + (segment_size_) * item_size_ 
-      //       - sizeof(uint64_t));\
-      //     auto start = pitr;
-      //     std::cout << "data in source component " << src_segment_id  << "\n";  
-      //     while (pitr != start - src_segment_item_count * item_size_ / sizeof(uint64_t)) {
-      //       std::cout << *pitr << " ";
-      //       pitr--;
-      //     }
-      //     std::cout << "\n";
-      //   }
-      // }
     } else {
       // there are still item in this source to copy
       assert(src_offset > actual_copy_count);
@@ -236,18 +248,6 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
         // we are modifying segments that would be sources later;
         src_cpy.push(GetCopy(dest_segment_id));
       }
-      // { 
-      //     // printed dest segment content as uint64_t.
-      //     auto pitr = reinterpret_cast<uint64_t*>(dest_segment + (segment_size_) * item_size_ 
-      //       - sizeof(uint64_t));\
-      //     auto start = pitr;
-      //     std::cout << "data in dest component " << dest_segment_id+1  << "\n";  
-      //     while (pitr != start - redistribution_ctx.get_target_item(dest_segment_id+1) * item_size_ / sizeof(uint64_t)) {
-      //       std::cout << *pitr << " ";
-      //       pitr--;
-      //     }
-      //     std::cout << "\n";
-      // }
       dest_segment = Get(dest_segment_id).content;
       dest_offset = segment_size_ - 1;
       curr_item_to_copy = redistribution_ctx.get_target_item(dest_segment_id);
@@ -266,25 +266,15 @@ void PMA::RebalanceRange(uint64_t left, uint64_t right, uint64_t item_count,
     auto final_item_count = redistribution_ctx.get_target_item(i); 
     item_count_[i] = final_item_count;
     ctx->updated_segment.emplace_back(i, final_item_count);  
-    // {
-    //   auto segment = Get(i);
-    //   // printed dest segment content as uint64_t.
-    //   auto pitr = reinterpret_cast<uint64_t*>(segment.content + (segment_size_) * item_size_ 
-    //     - sizeof(uint64_t));\
-    //   auto start = pitr;
-    //   std::cout << "data in dest component " << i  << "\n";  
-    //   while (pitr != start - item_count_[i] * item_size_ / sizeof(uint64_t)) {
-    //     std::cout << *pitr << " ";
-    //     pitr--;
-    //   }
-    //   std::cout << "\n";
-    // }
   }
 }
 
 bool PMA::Rebalance(uint64_t segment_id, PMAUpdateContext *ctx) {
   // fast path that the current element not exceeding density requirement
   if (item_count_[segment_id] < UpperDensityThreshold(1) * segment_size_) return true;
+  COBTREE_TRACE_SCOPE(trace, event_tracer(), kTracePMARebalance, 
+    trace_device());
+  COBTREE_TRACE_ARG(trace, 0, segment_id);
 
   // check if adding its neighbor is enough
   uint64_t left = segment_id;
@@ -315,9 +305,82 @@ bool PMA::Rebalance(uint64_t segment_id, PMAUpdateContext *ctx) {
 
   // update the non empty segment count if needed
   last_non_empty_segment_ = std::max(last_non_empty_segment_, right);
+  COBTREE_TRACE_ARG(trace, 1, rebalancing_height);
+  COBTREE_TRACE_ARG(trace, 2, left);
+  COBTREE_TRACE_ARG(trace, 3, right);
   // perform rebalanc within the selected range.
   RebalanceRange(left, right, item_count, ctx);  
+  max_rebalance_height_ = std::max(max_rebalance_height_, rebalancing_height);
+  return true;
+}
+
+bool PMA::FlushModifiedSegments(int fd, uint64_t file_offset, 
+  uint64_t since_version, bool flush_all) const {
+  auto bytes = segment_bytes();
+  for (uint64_t i = 0; i < segment_count_; i++) {
+    if (!flush_all && (segment_version_[i] <= since_version)) continue;
+    char* ptr;
+    storage_->Read(i * bytes, bytes, &ptr);
+    uint64_t written = 0;
+    while (written < bytes) {
+      auto ret = ::pwrite(fd, ptr + written, bytes - written, 
+        file_offset + i * bytes + written);
+      if (ret < 0) return false;
+      written += ret;
+    }
+  }
   return true;
 }
 
+void PMA::PreserveSegment(uint64_t segment_id) {
+  // the current image is seen by the snapshots pinned since it was written.
+  auto from_epoch = segment_epoch_[segment_id];
+  auto it = read_snapshots_.lower_bound(from_epoch);
+  if ((it == read_snapshots_.end()) || (*it >= epoch_)) return;
+  retained_versions_[segment_id].push_back(
+    PMASegmentVersion{from_epoch, epoch_, GetCopy(segment_id)});
+  retained_bytes_ += segment_bytes();
+}
+
+void PMA::ReleaseSnapshot(uint64_t epoch) {
+  auto pinned = read_snapshots_.find(epoch);
+  assert(pinned != read_snapshots_.end());
+  read_snapshots_.erase(pinned);
+  // reclaim the images whose epoch range no longer holds a snapshot.
+  for (auto it = retained_versions_.begin(); 
+    it != retained_versions_.end();) {
+    auto& versions = it->second;
+    auto needed = [this](const PMASegmentVersion& v) {
+      auto s = read_snapshots_.lower_bound(v.from_epoch);
+      return (s != read_snapshots_.end()) && (*s < v.to_epoch);
+    };
+    auto kept = std::partition(versions.begin(), versions.end(), needed);
+    retained_bytes_ -= (versions.end() - kept) * segment_bytes();
+    versions.erase(kept, versions.end());
+    it = versions.empty() ? retained_versions_.erase(it) : std::next(it);
+  }
+}
+
+PMASegmentCopy PMA::GetSnapshotCopy(uint64_t segment_id, 
+  uint64_t epoch) const {
+  assert(read_snapshots_.count(epoch) > 0);
+  if (segment_epoch_[segment_id] <= epoch) return GetCopy(segment_id);
+  // the segment was modified after the pin, the image is retained.
+  auto it = retained_versions_.find(segment_id);
+  assert(it != retained_versions_.end());
+  for (const auto& v : it->second) {
+    if ((v.from_epoch <= epoch) && (epoch < v.to_epoch)) {
+      PMASegmentCopy cpy;
+      cpy.segment_id = segment_id;
+      cpy.len = v.copy.len;
+      cpy.content.reset(new char[cpy.len]);
+      std::memcpy(cpy.content.get(), v.copy.content.get(), cpy.len);
+      cpy.num_item = v.copy.num_item;
+      return cpy;
+    }
+  }
+  assert(false);
+  return PMASegmentCopy{};
+}
+
 }  // namespace cobtree
\ No newline at end of file
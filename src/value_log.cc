@@ -0,0 +1,106 @@
+#include "value_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cobtree {
+
+char* ValueLog::Load(uint64_t offset, uint64_t len) const {
+  auto physical_offset = offset % capacity_;
+  assert(physical_offset + len <= capacity_); // a range never wraps around
+  // bring each touched block into the cache to count the transfer.
+  auto block_size = storage_->block_size();
+  cache_->RecordAccess(id_, physical_offset / block_size, physical_offset,
+    len, false);
+  if (len > 0) {
+    auto last_block = (physical_offset + len - 1) / block_size;
+    for (auto block = physical_offset / block_size; block <= last_block;
+      block++) {
+      std::string cache_key{CreateValueLogCacheKey(id_, block)};
+      if (cache_->Exist(cache_key)) continue;
+      char* block_ptr;
+      auto read_len = storage_->Read(block * block_size, block_size,
+        &block_ptr);
+      cache_->Add(cache_key, block_ptr, read_len);
+    }
+  }
+  char* ptr;
+  storage_->Read(physical_offset, len, &ptr);
+  return ptr;
+}
+
+uint64_t ValueLog::SkipPadding(uint64_t offset) const {
+  if (offset >= tail_) return tail_;
+  auto remain = capacity_ - offset % capacity_;
+  // not even space for a header, the writer skipped it silently.
+  if (remain < sizeof(ValueLogRecordHeader)) return offset + remain;
+  auto header = reinterpret_cast<ValueLogRecordHeader*>(
+    Load(offset, sizeof(ValueLogRecordHeader)));
+  return (header->len == UINT64_MAX) ? offset + remain : offset;
+}
+
+bool ValueLog::Append(uint64_t key, const std::string& value,
+  uint64_t* offset) {
+  assert(offset);
+  auto record_size = RecordSize(value.size());
+  if (record_size > capacity_) return false;
+  // records do not wrap around, pad the remaining space if it is too small.
+  auto remain = capacity_ - tail_ % capacity_;
+  auto padding = (remain < record_size) ? remain : 0;
+  if (used_bytes() + padding + record_size > capacity_) return false;
+  if (padding >= sizeof(ValueLogRecordHeader)) {
+    ValueLogRecordHeader pad{UINT64_MAX, UINT64_MAX};
+    Load(tail_, sizeof(pad));
+    storage_->Write(reinterpret_cast<const char*>(&pad), tail_ % capacity_,
+      sizeof(pad));
+  }
+  tail_ += padding;
+
+  ValueLogRecordHeader header{key, value.size()};
+  auto physical_offset = tail_ % capacity_;
+  Load(tail_, record_size);
+  storage_->Write(reinterpret_cast<const char*>(&header), physical_offset,
+    sizeof(header));
+  storage_->Write(value.data(), physical_offset + sizeof(header),
+    value.size());
+  *offset = tail_;
+  tail_ += record_size;
+  return true;
+}
+
+bool ValueLog::Read(uint64_t offset, uint64_t* key, std::string* value) const {
+  assert(key);
+  assert(value);
+  if ((offset < head_) || (offset >= tail_)) return false;
+  auto header = reinterpret_cast<ValueLogRecordHeader*>(
+    Load(offset, sizeof(ValueLogRecordHeader)));
+  assert(header->len != UINT64_MAX); // offset should not point to padding
+  *key = header->key;
+  auto len = header->len;
+  value->assign(Load(offset + sizeof(ValueLogRecordHeader), len), len);
+  return true;
+}
+
+uint64_t ValueLog::ValueLength(uint64_t offset) const {
+  assert((offset >= head_) && (offset < tail_));
+  auto header = reinterpret_cast<ValueLogRecordHeader*>(
+    Load(offset, sizeof(ValueLogRecordHeader)));
+  return header->len;
+}
+
+uint64_t ValueLog::NextRecord(uint64_t offset) const {
+  offset = SkipPadding(offset);
+  if (offset >= tail_) return tail_;
+  auto header = reinterpret_cast<ValueLogRecordHeader*>(
+    Load(offset, sizeof(ValueLogRecordHeader)));
+  return SkipPadding(offset + RecordSize(header->len));
+}
+
+void ValueLog::Trim(uint64_t new_head, uint64_t reclaimed_garbage) {
+  assert(new_head >= head_);
+  assert(new_head <= tail_);
+  head_ = new_head;
+  garbage_bytes_ -= std::min(garbage_bytes_, reclaimed_garbage);
+}
+
+}  // namespace cobtree
@@ -3,10 +3,70 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <map>
+#include <set>
 #include <stack>
 
 namespace cobtree {
 
+namespace {
+// lookups in flight in GetBatch. about the misses a core can have 
+// outstanding; more would evict their prefetched nodes before use.
+const uint64_t kLookupGroupSize = 16;
+}  // anonymous namespace
+
+vEBTreeBase::vEBTreeBase(uint64_t fanout, uint64_t estimated_unit_count, 
+  double pma_redundancy_factor, const std::string& uid, 
+  const PMADensityOption& pma_options, Cache* cache)
+  : fanout_(fanout), node_size_(sizeof(Node) + sizeof(NodeEntry) * fanout_),
+    root_height_(2), // one leaf and one root will be created
+    pma_(uid, node_size_, std::ceil(estimated_unit_count 
+      * pma_redundancy_factor), pma_options, cache),
+    item_per_segment(pma_.segment_size()),
+    root_address_(item_per_segment - 1), // the initial root is at the end of the first segment
+    segment_element_count(pma_.segment_count()) {
+  assert(pma_.segment_size() > 10); // a segment needs to be reasonably large
+  // create the fist leaf
+  std::unique_ptr<char[]> first_leaf_buffer{ new char[node_size_] };
+  std::memset(first_leaf_buffer.get(), -1, node_size_);
+  Node* first_leaf = reinterpret_cast<Node*>(first_leaf_buffer.get());
+  first_leaf->parent_addr = root_address_;
+  first_leaf->height = 1;
+  get_children(first_leaf)->key = 0;
+  auto segment = pma_.Get(0);
+  std::memcpy((segment.content + (item_per_segment - 2) * node_size_),
+    first_leaf_buffer.get(), node_size_);
+
+  // create the root
+  std::unique_ptr<char[]> first_root_buffer{ new char[node_size_] };
+  std::memset(first_root_buffer.get(), -1, node_size_);
+  Node* first_root = reinterpret_cast<Node*>(first_root_buffer.get());
+  first_root->height = 2;
+  auto child = get_children(first_root);
+  child->key = 0; // in out fixed key range of uint64_t 0 is the smallest key.
+  child->addr = item_per_segment - 2;
+  std::memcpy((segment.content + (item_per_segment - 1) * node_size_),
+    first_root_buffer.get(), node_size_);
+  
+  // set the first segment item count to 2;
+  segment_element_count[0] = 2;
+  pma_.vebtree_init_first_segment_count();
+  pma_.MarkModified(0);
+}
+
+vEBTreeBase::vEBTreeBase(const std::string& uid, const vEBTreeLayout& layout,
+  const PMALayout& pma_layout, char* segments, uint64_t* item_count,
+  uint64_t* element_count, Cache* cache)
+  : fanout_(layout.fanout), 
+    node_size_(sizeof(Node) + sizeof(NodeEntry) * fanout_),
+    root_height_(layout.root_height),
+    pma_(uid, pma_layout, segments, item_count, cache),
+    item_per_segment(pma_.segment_size()),
+    root_address_(layout.root_address),
+    segment_element_count(element_count, pma_.segment_count()) {
+  assert(pma_layout.item_size == node_size_);
+}
+
 /**
  * @brief perfrom get in van Emde Boas layout tree. The value returned is 
  *  from the leaf value that has the largest key smaller than the lookup key.
@@ -15,7 +75,9 @@ namespace cobtree {
  * @param pma_address address in the PMA where vEB Tree is stored
  * @return uint64_t leaf value
  */
-uint64_t vEBTree::Get(uint64_t key, uint64_t* pma_address, bool* match_key) {
+template <uint64_t kFanout>
+uint64_t vEBTreeImpl<kFanout>::Get(uint64_t key, uint64_t* pma_address, bool* match_key) {
+  PerfScope perf(pma_.perf_stats(), kProbeVEBTreeGet);
   // bool is_leaf = false;
   // // obtain the root node and the address of the target child
   // auto last_address = root_address_;
@@ -30,41 +92,98 @@ uint64_t vEBTree::Get(uint64_t key, uint64_t* pma_address, bool* match_key) {
   // *pma_address = last_address;
   // return address;
   auto address = root_address_;
-  auto node = GetNode(address);
+  auto node = LoadNode(address);
   while (node->height != 1) {
     address = child_to_search(node, key, match_key);
-    node = GetNode(address);
+    node = LoadNode(address);
   }
   *pma_address = address;
   return get_children(node)->key;
 }
 
-Node* vEBTree::GetNode(uint64_t address) {
+template <uint64_t kFanout>
+void vEBTreeImpl<kFanout>::GetBatch(const uint64_t* keys, uint64_t count, 
+  uint64_t* values, uint64_t* pma_addresses) {
+  uint64_t address[kLookupGroupSize];
+  for (uint64_t begin = 0; begin < count; begin += kLookupGroupSize) {
+    auto group = std::min(kLookupGroupSize, count - begin);
+    for (uint64_t i = 0; i < group; i++) address[i] = root_address_;
+    // every node is one level above its children: the lookups of a group
+    // reach the leaves at the same step.
+    for (auto height = root_height_; height > 1; height--) {
+      for (uint64_t i = 0; i < group; i++) {
+        address[i] = child_to_search(LoadNode(address[i]), keys[begin + i]);
+        PrefetchNode(address[i]);
+      }
+    }
+    for (uint64_t i = 0; i < group; i++) {
+      auto node = LoadNode(address[i]);
+      assert(node->height == 1);
+      pma_addresses[begin + i] = address[i];
+      values[begin + i] = get_children(node)->key;
+    }
+  }
+}
+
+bool vEBTreeBase::NodeResident(uint64_t address) const {
   auto segment_id = address / item_per_segment;
-  auto segment = pma_.Get(segment_id);
   auto segment_offset = address - segment_id * item_per_segment; 
-  assert(segment.len > segment_offset + node_size_);
-  return reinterpret_cast<Node*>(segment.content 
-    + segment_offset * node_size_); 
+  return pma_.GetView(segment_id).Resident(segment_offset * node_size_, 
+    node_size_);
+}
+
+template <uint64_t kFanout>
+uint64_t vEBTreeImpl<kFanout>::GetStep(uint64_t address, uint64_t key, bool* leaf) {
+  assert(leaf);
+  auto node = LoadNode(address);
+  *leaf = (node->height == 1);
+  return (*leaf) ? get_children(node)->key : child_to_search(node, key);
+}
+
+const Node* vEBTreeBase::LoadNode(uint64_t address) const {
+  auto segment_id = address / item_per_segment;
+  auto segment_offset = address - segment_id * item_per_segment; 
+  assert(segment_offset < item_per_segment);
+  return reinterpret_cast<const Node*>(
+    pma_.GetView(segment_id).LoadItem(segment_offset));
+}
+
+void vEBTreeBase::PrefetchNode(uint64_t address) const {
+  auto segment_id = address / item_per_segment;
+  auto segment_offset = address - segment_id * item_per_segment; 
+  pma_.GetView(segment_id).Prefetch(segment_offset * node_size_, node_size_);
+}
+
+Node* vEBTreeBase::GetNode(uint64_t address) {
+  auto segment_id = address / item_per_segment;
+  // only the node is accounted for, not the whole segment.
+  auto segment = pma_.GetView(segment_id);
+  auto segment_offset = address - segment_id * item_per_segment; 
+  assert(segment_offset < item_per_segment);
+  // callers update the node in place through the returned pointer. the
+  // read-only walks use LoadNode, which does not mark it modified.
+  pma_.MarkModified(segment_id, segment_offset * node_size_, node_size_);
+  return reinterpret_cast<Node*>(segment.LoadItem(segment_offset)); 
 }
 
 // Insert in our simulated use case of growing vEBTree, only insert at the tail end, after rebalance fill up new segemnts.
-bool vEBTree::Insert(uint64_t key, uint64_t value) {
+template <uint64_t kFanout>
+bool vEBTreeImpl<kFanout>::Insert(uint64_t key, uint64_t value) {
   // find the parent that we should add this child to
   bool match_key = false;
   // obtain the root node
-  auto node = GetNode(root_address_);
+  auto node = LoadNode(root_address_);
   auto address = root_address_;
 
   // need to traverse down the tree until we are at the leaf.
   while(node->height != 1) {
     address = child_to_search(node, key, &match_key);
-    node = GetNode(address);
+    node = LoadNode(address);
   }
 
   // if the leaf with the same key exists, fast path to update it.
   if (match_key) {
-    get_children(node)->key = value;
+    get_children(GetNode(address))->key = value;
     return true;
   }
   // node insertion needed
@@ -91,32 +210,223 @@ bool vEBTree::Insert(uint64_t key, uint64_t value) {
   } 
 
   // add the leaf node to parent
-  return AddChildToNode(GetNode(landed_address)->parent_addr, 
+  auto added = AddChildToNode(LoadNode(landed_address)->parent_addr, 
     landed_address, key);
+  // the root may have moved or changed and the pinned nodes shifted.
+  if (pin_top_ && (pinned_shifted_ || (root_address_ != pinned_root_address_)
+    || (root_height_ != pinned_root_height_))) {
+    RepinTop();
+  }
+  return added;
 }
 
-// for now use a copy then insert. maybe better to implement its own logic
-uint64_t vEBTree::MoveSubtree(uint64_t subtree_root_address, uint64_t height, uint64_t new_address) {
-  auto tree_copy = CopySubtree(subtree_root_address, height, false);
+void vEBTreeBase::PinTop(bool enable) {
+  pin_top_ = enable;
+  if (enable) {
+    RepinTop();
+  } else {
+    for (auto block : pinned_blocks_) {
+      pma_.cache()->UnpinBlock(pma_.id(), block);
+    }
+    pinned_blocks_.clear();
+    pinned_levels_ = 0;
+  }
+}
+
+template <uint64_t kFanout>
+void vEBTreeImpl<kFanout>::RepinTop() {
+  repin_count_++;
+  pinned_root_address_ = root_address_;
+  pinned_root_height_ = root_height_;
+  pinned_shifted_ = false;
+  auto cache = pma_.cache();
+  auto block_size = cache->block_size_for_stats();
+  auto max_block_count = cache->pinned_capacity() / block_size;
+  // the blocks holding the nodes of the levels taken so far.
+  std::set<uint64_t> blocks;
+  std::vector<uint64_t> level{root_address_};
+  pinned_levels_ = 0;
+  while (!level.empty()) {
+    auto level_blocks = blocks;
+    for (auto address : level) {
+      // the node address is its item index in the pma.
+      auto offset = address * node_size_;
+      for (auto block = offset / block_size; 
+        block <= (offset + node_size_ - 1) / block_size; block++) {
+        level_blocks.insert(block);
+      }
+    }
+    if (level_blocks.size() > max_block_count) break;
+    blocks.swap(level_blocks);
+    pinned_levels_++;
+    std::vector<uint64_t> next_level;
+    for (auto address : level) {
+      auto node = LoadNode(address);
+      if (node->height == 1) continue;
+      for (auto child = get_children(node); 
+        child < get_children(node) + fanout(); child++) {
+        if (child->addr == UINT64_MAX) break;
+        next_level.push_back(child->addr);
+      }
+    }
+    level.swap(next_level);
+  }
+  // only the blocks that changed are released or loaded.
+  for (auto block : pinned_blocks_) {
+    if (blocks.count(block) == 0) cache->UnpinBlock(pma_.id(), block);
+  }
+  for (auto block : blocks) {
+    auto pinned = cache->PinBlock(pma_.id(), block);
+    assert(pinned);
+    (void) pinned;
+  }
+  pinned_blocks_.swap(blocks);
+}
+
+void vEBTreeBase::NoteNodesShifted(uint64_t first_segment, 
+  uint64_t last_segment) {
+  if (!pin_top_ || pinned_shifted_ || pinned_blocks_.empty()) return;
+  auto block_size = pma_.cache()->block_size_for_stats();
+  auto segment_bytes = item_per_segment * node_size_;
+  auto first_block = first_segment * segment_bytes / block_size;
+  auto last_block = ((last_segment + 1) * segment_bytes - 1) / block_size;
+  auto block = pinned_blocks_.lower_bound(first_block);
+  pinned_shifted_ = (block != pinned_blocks_.end()) && (*block <= last_block);
+}
+
+// the nodes are shifted one at a time between the pma segments, in the 
+// order that never overwrites a node not moved yet, and their addresses 
+// are rewritten as they land. the relative position of a node in the 
+// subtree (counted without the empty slots) is kept.
+template <uint64_t kFanout>
+uint64_t vEBTreeImpl<kFanout>::MoveSubtree(uint64_t subtree_root_address, uint64_t height, uint64_t new_address) {
+  COBTREE_TRACE_SCOPE(trace, pma_.event_tracer(), kTraceMoveSubtree, 
+    pma_.trace_device());
+  COBTREE_TRACE_ARG(trace, 0, subtree_root_address);
+  COBTREE_TRACE_ARG(trace, 1, height);
+  COBTREE_TRACE_ARG(trace, 2, new_address);
+  uint64_t leaf_height = height - SubtreeHeight(height) + 1;
+
+  // count the nodes. the subtree ends at its leaf with the lowest address.
+  uint64_t node_count = 0;
+  auto last_address_to_move = subtree_root_address;
+  for (auto address = subtree_root_address; ; 
+    address = PrevNodeAddress(address)) {
+    node_count++;
+    auto node = LoadNode(address);
+    if (node->height != leaf_height) {
+      for (auto child = get_children(node); 
+        child < get_children(node) + fanout(); child++) {
+        if (child->addr == UINT64_MAX) break;
+        last_address_to_move = std::min<uint64_t>(last_address_to_move, 
+          child->addr);
+      }
+    } else if (address == last_address_to_move) {
+      break;
+    }
+  }
+  COBTREE_TRACE_ARG(trace, 3, node_count * node_size_);
+
+  if (new_address == subtree_root_address) return node_count;
   // update the parent of the subtree roots child pointer
-  auto subtree_root = GetNode(subtree_root_address);
-  auto parent = GetNode(subtree_root->parent_addr);
+  auto parent_address = LoadNode(subtree_root_address)->parent_addr;
+  auto parent = GetNode(parent_address);
   for (auto child = get_children(parent);
-    child < get_children(parent)+fanout_; child++) {
+    child < get_children(parent)+fanout(); child++) {
     if (child->addr == subtree_root_address) {
       child->addr = new_address;
       break;
     }
   }
-  InsertSubtree(tree_copy, new_address);
-  return tree_copy.node_count;
+
+  // moving up, start from the root; moving down, from the last leaf.
+  bool upward = new_address > subtree_root_address;
+  auto source = (upward) ? subtree_root_address 
+    : NodeAddressBelow(subtree_root_address, node_count - 1);
+  auto dest = (upward) ? new_address 
+    : NodeAddressBelow(new_address, node_count - 1);
+  auto lowest_address = std::min(
+    NodeAddressBelow(subtree_root_address, node_count - 1),
+    NodeAddressBelow(new_address, node_count - 1));
+  for (uint64_t i = 0; i < node_count; i++) {
+    auto node = GetNode(dest);
+    std::memmove(node, LoadNode(source), node_size_);
+    // the parent of the root is not moved. 
+    if (node->height != height) {
+      node->parent_addr = NodeAddressBelow(new_address, 
+        NodeOffsetBelow(subtree_root_address, node->parent_addr));
+    }
+    for (auto child = get_children(node); 
+      child < get_children(node) + fanout(); child++) {
+      if (child->addr == UINT64_MAX) break; // empty nodes encountered
+      if (node->height != leaf_height) {
+        // the children above the leaves are moved as well.
+        child->addr = NodeAddressBelow(new_address, 
+          NodeOffsetBelow(subtree_root_address, child->addr));
+      } else {
+        GetNode(child->addr)->parent_addr = dest;
+      }
+    }
+    if (i + 1 == node_count) break;
+    source = (upward) ? PrevNodeAddress(source) : NextNodeAddress(source);
+    dest = (upward) ? PrevNodeAddress(dest) : NextNodeAddress(dest);
+  }
+  NoteNodesShifted(lowest_address / item_per_segment, 
+    std::max(subtree_root_address, new_address) / item_per_segment);
+  return node_count;
 }
 
-TreeCopy vEBTree::CopySubtree(uint64_t subtree_root_address, uint64_t height, bool top_part_only) {
+uint64_t vEBTreeBase::PrevNodeAddress(uint64_t address) const {
+  // the nodes of a segment are right aligned.
+  auto segment_id = address / item_per_segment;
+  if (address > (segment_id + 1) * item_per_segment 
+    - segment_element_count[segment_id]) {
+    return address - 1;
+  }
+  assert(segment_id > 0);
+  return segment_id * item_per_segment - 1;
+}
+
+uint64_t vEBTreeBase::NextNodeAddress(uint64_t address) const {
+  auto segment_id = address / item_per_segment;
+  if (address + 1 < (segment_id + 1) * item_per_segment) return address + 1;
+  assert(segment_id + 1 < pma_.segment_count());
+  return (segment_id + 2) * item_per_segment 
+    - segment_element_count[segment_id + 1];
+}
+
+uint64_t vEBTreeBase::NodeOffsetBelow(uint64_t from, uint64_t address) const {
+  assert(address <= from);
+  auto offset = from - address;
+  // skip the empty slots leading the segments in between.
+  for (auto segment_id = address / item_per_segment + 1; 
+    segment_id <= from / item_per_segment; segment_id++) {
+    offset -= item_per_segment - segment_element_count[segment_id];
+  }
+  return offset;
+}
+
+uint64_t vEBTreeBase::NodeAddressBelow(uint64_t from, uint64_t offset) const {
+  auto segment_id = from / item_per_segment;
+  // the nodes below from in its segment.
+  auto below = from - ((segment_id + 1) * item_per_segment 
+    - segment_element_count[segment_id]);
+  while (offset > below) {
+    offset -= below + 1;
+    assert(segment_id > 0);
+    segment_id--;
+    from = (segment_id + 1) * item_per_segment - 1;
+    below = segment_element_count[segment_id] - 1;
+  }
+  return from - offset;
+}
+
+template <uint64_t kFanout>
+TreeCopy vEBTreeImpl<kFanout>::CopySubtree(uint64_t subtree_root_address, uint64_t height, bool top_part_only) {
   // calculate recursive tree context
   auto subtree_height = SubtreeHeight(height) >> ((top_part_only) ? 1 : 0);
   assert(subtree_height > 0);
-  uint64_t cap_tree_size = (std::pow(fanout_, subtree_height) - 1)/(fanout_-1); 
+  uint64_t cap_tree_size = subtree_node_count(subtree_height);
   uint64_t leaf_height = height - subtree_height + 1;
   uint64_t last_address_to_copy = subtree_root_address;// termination criteria: the current node is at last_address_to_copy and it has leaf height
 
@@ -141,7 +451,7 @@ TreeCopy vEBTree::CopySubtree(uint64_t subtree_root_address, uint64_t height, bo
     copy_segment_offset = item_per_segment - 1;
   }
   // add the first segment
-  if (temp < cap_tree_size) segment_source.emplace_back(SegmentInfo(segment_id, segment_element_count.front()));
+  if (temp < cap_tree_size) segment_source.emplace_back(SegmentInfo(segment_id, segment_element_count[0]));
 
   // the offset in the PMA to start copy
   segment_id = subtree_root_address / item_per_segment;
@@ -175,9 +485,10 @@ TreeCopy vEBTree::CopySubtree(uint64_t subtree_root_address, uint64_t height, bo
       // for non-leaf node we update the children address
       if (dest_it->height != leaf_height) {
         for (auto child = get_children(dest_it); 
-          child < get_children(dest_it)+fanout_; child++) {
+          child < get_children(dest_it)+fanout(); child++) {
           if(child->addr == UINT64_MAX) break; // empty nodes encountered
-          last_address_to_copy = std::min(last_address_to_copy, child->addr);
+          last_address_to_copy = std::min<uint64_t>(last_address_to_copy, 
+            child->addr);
           // adjust children address. Note that for non-leaf node, its child will be copied.
           child->addr = subtree_root_address - child->addr 
             - empty_spaces[segment_id - child->addr/item_per_segment];
@@ -198,23 +509,13 @@ TreeCopy vEBTree::CopySubtree(uint64_t subtree_root_address, uint64_t height, bo
     copy_segment_offset = item_per_segment - 1; 
   }
 
-  // debug print of tree copy
-  {
-    auto debug_node_it = reinterpret_cast<Node*>(buffer.get()
-      + (cap_tree_size-1) * node_size_);
-    auto debug_node_end = reinterpret_cast<Node*>(buffer.get() + (cap_tree_size - node_count) * node_size_);
-    while (debug_node_it >= debug_node_end) {
-      DebugPrintNode(debug_node_it);
-      debug_node_it = get_next_node_in_segment(debug_node_it);
-    }
-  }
-
   return TreeCopy{height, leaf_height, node_count, cap_tree_size, 
     std::move(buffer)};
 }
 
 // Note: overwrite existing contents, the space should have been left for the tree to fill up
-void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
+template <uint64_t kFanout>
+void vEBTreeImpl<kFanout>::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
   auto subtree_height = SubtreeHeight(tree.tree_root_height);
   // ultimate termination criteria
   uint64_t total_to_copy = tree.node_count;
@@ -233,6 +534,8 @@ void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
     temp += segment_element_count[segment_id];
     segment_dest.emplace_back(segment_id, segment_element_count[segment_id]);
   }
+  NoteNodesShifted(segment_dest.back().segment_id, 
+    segment_dest.front().segment_id);
 
   auto copy_dest_offset = new_address;
   // points to start position of source.
@@ -242,6 +545,7 @@ void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
   for (auto dest_segment_it = segment_dest.begin(); dest_segment_it != segment_dest.end();
     dest_segment_it++) {
     auto segment = pma_.Get(dest_segment_it->segment_id);
+    pma_.MarkModified(dest_segment_it->segment_id);
     // point to the first position to copy.
     Node* dest_it = reinterpret_cast<Node*>(segment.content 
       + ((item_per_segment - 1
@@ -253,7 +557,7 @@ void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
       std::memcpy(dest_it, source_it, node_size_);
       if (dest_it->height != tree.tree_root_height) {
         // update parenet address
-        auto offset_base = dest_it->parent_addr;
+        uint64_t offset_base = dest_it->parent_addr;
         auto adjusted_offset = offset_base;
         auto temp = 0;
         auto segment_space_remain = segment_dest[temp].num_count - 1;
@@ -269,10 +573,10 @@ void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
       // for non-leaf node we update the children address
       if (dest_it->height != tree.tree_leaf_height) {
         for (auto child = get_children(dest_it); 
-          child < get_children(dest_it)+fanout_; child++) {
+          child < get_children(dest_it)+fanout(); child++) {
           if(child->addr == UINT64_MAX) break; // empty nodes encountered
           // adjust children address. Note that for non-leaf node, its child will be copied.
-          auto offset_base = child->addr;
+          uint64_t offset_base = child->addr;
           auto adjusted_offset = offset_base;
           auto temp = 0;
           auto segment_space_remain = segment_dest[temp].num_count - 1;
@@ -287,7 +591,7 @@ void vEBTree::InsertSubtree(const TreeCopy& tree, uint64_t new_address) {
       } else {
         // need to rewrite their children parent pointer
         for (auto child = get_children(dest_it); 
-          child < get_children(dest_it) + fanout_; child++) {
+          child < get_children(dest_it) + fanout(); child++) {
           if(child->addr == UINT64_MAX) break; // empty nodes encountered
           // adjust children's parent pointer
           auto child_node = GetNode(child->addr);
@@ -311,7 +615,7 @@ namespace {
 // There may be hidden memory transfer cost hidden here. As the context for rebalancing take space 
 // O(N/log^2{N}) which may not fit in cache layer.
 struct RebalancePointerAdjustementCtx{
-  RebalancePointerAdjustementCtx(const PMAUpdateContext& ctx, const std::vector<uint64_t>& old_element_count, uint64_t _segment_size, uint64_t _insert_address) 
+  RebalancePointerAdjustementCtx(const PMAUpdateContext& ctx, const CountArray& old_element_count, uint64_t _segment_size, uint64_t _insert_address) 
     : segment_size(_segment_size), insert_address(_insert_address),
     insert_segment(insert_address/segment_size) {
       for (auto s : ctx.updated_segment) {
@@ -420,7 +724,8 @@ struct RebalancePointerAdjustementCtx{
 };
 }  // anonymous namespace
 
-bool vEBTree::AddNodeToPMA(const Node* node, uint64_t address, 
+template <uint64_t kFanout>
+bool vEBTreeImpl<kFanout>::AddNodeToPMA(const Node* node, uint64_t address, 
   uint64_t* landed_address, PMAUpdateContext* ctx, bool* success) {
   // insert to the designated segment first.
   assert(landed_address);
@@ -453,13 +758,16 @@ bool vEBTree::AddNodeToPMA(const Node* node, uint64_t address,
     auto num_elements = s.num_count;
     auto cur_address = (s.segment_id+1) * item_per_segment - 1;
     while (num_elements > 0) {
-      if ((node_it->parent_addr != UINT64_MAX) && (!address_adjust.AdjustAddress(
-        node_it->parent_addr, &(node_it->parent_addr)))) {
+      uint64_t adjusted;
+      if ((node_it->parent_addr != UINT64_MAX) && address_adjust.AdjustAddress(
+        node_it->parent_addr, &adjusted)) {
+        node_it->parent_addr = adjusted;
+      } else if (node_it->parent_addr != UINT64_MAX) {
       // the parenet node is outside our updating ranges. we need to explicitly find it and update.
         auto old_address = address_adjust.RevertAddress(cur_address);
         auto parent_node = GetNode(node_it->parent_addr);
         for (auto child = get_children(parent_node); 
-          child != get_children(parent_node) + fanout_; child++) {
+          child != get_children(parent_node) + fanout(); child++) {
           if (child->addr == UINT64_MAX) break;
           if (child->addr != old_address) continue;
           child->addr = cur_address;
@@ -469,10 +777,12 @@ bool vEBTree::AddNodeToPMA(const Node* node, uint64_t address,
       // for non-leaf node update children address
       if (node_it->height != 1) {
         for (auto child = get_children(node_it); 
-          child < get_children(node_it) + fanout_; child++) {            
+          child < get_children(node_it) + fanout(); child++) {            
           // fast path, if we reach an empty child pointer
           if (child->addr == UINT64_MAX) break; 
-          if (!address_adjust.AdjustAddress(child->addr, &(child->addr))) {
+          if (address_adjust.AdjustAddress(child->addr, &adjusted)) {
+            child->addr = adjusted;
+          } else {
             // similar to above, if children outside the updating range we need to explicitly find it and update its parent pointer 
             auto child_node = GetNode(child->addr);
             child_node->parent_addr = cur_address;
@@ -491,29 +801,30 @@ bool vEBTree::AddNodeToPMA(const Node* node, uint64_t address,
   // return if we expand into new segment. if so, need to adjust the root address.
 
   // the inserted node has not updated its children address
-  node = GetNode(*landed_address);
+  node = LoadNode(*landed_address);
   for (auto child = get_children(node);
-    child < get_children(node) + fanout_; child++) {
+    child < get_children(node) + fanout(); child++) {
     if (child->addr == UINT64_MAX) break;
     auto child_node = GetNode(child->addr);
     child_node->parent_addr = *landed_address;
   }
 
   // update the cached item count in vebtree
+  auto first_segment = segment_id;
+  auto last_segment = segment_id;
   for (auto u : ctx->updated_segment) {
     segment_element_count[u.segment_id] = u.num_count;
+    first_segment = std::min(first_segment, u.segment_id);
+    last_segment = std::max(last_segment, u.segment_id);
   }
-  // debug print
-  {
-    std::cout << "A node has been added\n";
-    DebugPrintAsPMA();
-  }
+  NoteNodesShifted(first_segment, last_segment);
   return ctx->num_filled_empty_segment != 0; 
 }
 
 // this function only add the entry under the parent node. 
 // if we have the child node at hand we can easily figure out the key being its first child key.
-bool vEBTree::AddChildToNode(uint64_t node_address, uint64_t child_address, uint64_t child_key) {
+template <uint64_t kFanout>
+bool vEBTreeImpl<kFanout>::AddChildToNode(uint64_t node_address, uint64_t child_address, uint64_t child_key) {
   auto node = GetNode(node_address);
   bool done = false;
   int child_count = 0;
@@ -521,7 +832,7 @@ bool vEBTree::AddChildToNode(uint64_t node_address, uint64_t child_address, uint
   // so we need to shift all child entry with larger key to make space
   NodeEntry buffer_shift_child;
   for(auto child = get_children(node); 
-    child != get_children(node) + fanout_; child++) {
+    child != get_children(node) + fanout(); child++) {
     // skip smaller childs
     if ((child->key < child_key)) {
       child_count++;
@@ -538,23 +849,20 @@ bool vEBTree::AddChildToNode(uint64_t node_address, uint64_t child_address, uint
     child_address = buffer_shift_child.addr;
   }
   assert(done);
-  return (child_count == fanout_-1) 
+  return (child_count == fanout()-1) 
     ? NodeSplit(node, node->height, node_address) : true;
 }
 
 // leaf node height = 1.
-uint64_t vEBTree::SubtreeHeight(uint64_t height) const {
+uint64_t vEBTreeBase::SubtreeHeight(uint64_t height) const {
   // assert(height > 1);
   if (height == 0) return 0;
-  uint64_t subtree_height_in_power_two = 0;
-  while((height & 1ULL) != 1) {
-    subtree_height_in_power_two ++;
-    height >>= 1;
-  }
-  return 1 << subtree_height_in_power_two;
+  // the largest power of two dividing height.
+  return height & (~height + 1);
 }
 
-std::vector<uint64_t> vEBTree::GetLeafAddresses(Node* node, uint64_t height) {
+template <uint64_t kFanout>
+std::vector<uint64_t> vEBTreeImpl<kFanout>::GetLeafAddresses(Node* node, uint64_t height) {
   // for the last two level there will be no leaf subtrees
   if (height <= 2) return std::vector<uint64_t>{};
   auto subtree_height = SubtreeHeight(height);
@@ -568,7 +876,7 @@ std::vector<uint64_t> vEBTree::GetLeafAddresses(Node* node, uint64_t height) {
   std::vector<uint64_t>  leaf_addresses;
   // DO DFS to obtain the leaf addresses
   // add the child nodes to stack first.
-  for (auto subtree = get_children(node) + fanout_ - 1; 
+  for (auto subtree = get_children(node) + fanout() - 1; 
     subtree >= get_children(node); subtree--) {
     if (subtree->addr== UINT64_MAX) continue;
       search_address_stack.push(subtree->addr);
@@ -576,10 +884,10 @@ std::vector<uint64_t> vEBTree::GetLeafAddresses(Node* node, uint64_t height) {
   while (!search_address_stack.empty()) {
     auto search_address = search_address_stack.top();
     search_address_stack.pop();
-    auto node = GetNode(search_address);
+    auto node = LoadNode(search_address);
     // to help order in descending pma address for leaf addresses.
     std::vector<uint64_t> leaf_address_buf{};
-    for (auto subtree = get_children(node) + fanout_ - 1; 
+    for (auto subtree = get_children(node) + fanout() - 1; 
       subtree >= get_children(node); subtree--) {
       if (subtree->addr== UINT64_MAX) continue;
       if (node->height == leaf_subtree_height + 1) {
@@ -597,27 +905,33 @@ std::vector<uint64_t> vEBTree::GetLeafAddresses(Node* node, uint64_t height) {
 }
 
 // end with call to AddChildToNode, which potentially call NodeSplit on parent node.
-bool vEBTree::NodeSplit(Node* node, uint64_t height, uint64_t node_address) {
+template <uint64_t kFanout>
+bool vEBTreeImpl<kFanout>::NodeSplit(Node* node, uint64_t height, uint64_t node_address) {
+  node_split_count_++;
+  COBTREE_TRACE_SCOPE(trace, pma_.event_tracer(), kTraceNodeSplit, 
+    pma_.trace_device());
+  COBTREE_TRACE_ARG(trace, 0, node_address);
+  COBTREE_TRACE_ARG(trace, 1, height);
   // handle root node split.
   if (node->height == root_height_) {
     auto success = AddNewRoot(node);
     if (!success) return false;
     // we need to reassign the node pointer.
     // the old node would be the first child of root
-    auto new_root = GetNode(root_address_);
+    auto new_root = LoadNode(root_address_);
     node_address = get_children(new_root)->addr;
     node = GetNode(node_address);
     // height remain unchanged
   }
 
   // the splitting node is guaranteed not a root.
-  auto partition_idx = fanout_/2;
+  auto partition_idx = fanout()/2;
   int curr_idx = 0;
   auto splitting_node_key = get_children(node)->key; // this is required to relocate the splitting node after new node insertion.
   // determine the new node insertion place before the subtrees that the new node will take control
   auto subtree_height = SubtreeHeight(height);
-  auto insert_address = ( subtree_height > 1) 
-    ? (get_children(node) + partition_idx) -> addr
+  uint64_t insert_address = ( subtree_height > 1) 
+    ? uint64_t((get_children(node) + partition_idx) -> addr)
     : (node_address - 1);
   // there should be a valid address otherwise NodeSplit should not be called
   assert(insert_address != UINT64_MAX); 
@@ -629,18 +943,12 @@ bool vEBTree::NodeSplit(Node* node, uint64_t height, uint64_t node_address) {
   new_node->height = node->height;
   new_node->parent_addr = node->parent_addr;
   // copy over the address of children to own;
-  auto num_children_to_own = fanout_-partition_idx;
-  auto new_child_itr = get_children(new_node);
-  while (num_children_to_own > 0) {
-    auto child_to_copy = get_children(node) + fanout_ - num_children_to_own;
-    new_child_itr->key = child_to_copy->key;
-    new_child_itr->addr = child_to_copy->addr;
-    // reset children no longer control in the splitting node
-    child_to_copy->key = UINT64_MAX;
-    child_to_copy->addr = UINT64_MAX;
-    num_children_to_own--;
-    new_child_itr++;
-  } 
+  auto num_children_to_own = fanout()-partition_idx;
+  std::copy_n(get_children(node) + partition_idx, num_children_to_own,
+    get_children(new_node));
+  // reset children no longer control in the splitting node
+  std::fill_n(get_children(node) + partition_idx, num_children_to_own,
+    NodeEntry());
   
   // actually all nodes including this one at insert address and before are shifted one places front. // if exceeds density requirement, need rebalance. 
   PMAUpdateContext ctx;
@@ -659,9 +967,9 @@ bool vEBTree::NodeSplit(Node* node, uint64_t height, uint64_t node_address) {
   
   new_node = GetNode(landed_address);
   auto original_splitting_node_addres = UINT64_MAX;
-  auto new_node_parent = GetNode(new_node->parent_addr);
+  auto new_node_parent = LoadNode(new_node->parent_addr);
   for (auto child = get_children(new_node_parent);
-    child < get_children(new_node_parent) + fanout_;
+    child < get_children(new_node_parent) + fanout();
     child++) {
     if (child->key == splitting_node_key) {
       original_splitting_node_addres = child->addr;
@@ -727,7 +1035,9 @@ bool vEBTree::NodeSplit(Node* node, uint64_t height, uint64_t node_address) {
 }
 
 
-bool vEBTree::AddNewRoot(Node* old_root) {
+template <uint64_t kFanout>
+bool vEBTreeImpl<kFanout>::AddNewRoot(Node* old_root) {
+  root_split_count_++;
   std::unique_ptr<char[]> new_root_buffer(new char[node_size_]);
   std::memset(new_root_buffer.get(), -1, node_size_);
   Node* new_root = reinterpret_cast<Node*>(new_root_buffer.get());
@@ -744,8 +1054,7 @@ bool vEBTree::AddNewRoot(Node* old_root) {
   // cached info update
   if (root_moved) root_address_ = landed_address;
   // update old root parent pointer.
-  new_root = GetNode(landed_address);
-  old_root = GetNode(get_children(new_root)->addr);
+  old_root = GetNode(get_children(LoadNode(landed_address))->addr);
   old_root->parent_addr = landed_address;
   return true;
 }
@@ -780,123 +1089,109 @@ uint64_t GetChildIdx(const NodeEntry* node, uint64_t len, uint64_t addr,
   return len;
 }
 
-/**
- * @brief Get the Right Most Child Address 
- * 
- * @param node the children node to search
- * @param len number of children nodes to search
- * @param checker true a child with valid address found; false otherwise
- * @return uint64_t 
- */
-uint64_t GetRightMostChildAddress(const NodeEntry* node, uint64_t len, 
-  bool* checker = nullptr) {
-  assert(node);
-  assert(len > 1);
-  auto curr = node + len - 1;
-  int curr_idx = len - 1;
-  if (checker) *checker = true;
-  do {
-    if(curr->addr != UINT64_MAX) return curr->addr;
-    curr--;
-  } while (curr != node); 
-  if(checker) *checker = false;
-  return len;
-}
-
 }  // anonymous namespace
 
-void vEBTreeBackwardIterator::Prev() {
-  if (!valid_) return; // valid_ set false means we are at the first leaf.
-  auto curr_address = curr_parent_address_;
-  auto curr = tree_->GetNode(curr_address);
-  bool checker;
-  auto idx = GetChildIdx(vEBTree::get_children(curr), tree_->fanout_,
-    curr_address, &checker);
-  assert(checker);
-  // continue to move upward
-  while (idx == 0) {
-    // fast path, we were at the first leaf in tree. no more in front
-    if(curr->height == tree_->root_height_) {
-      valid_ = false;
-      return;
-    }
-    curr_address = curr->parent_addr;
-    curr = tree_->GetNode(curr_address);
-    idx = GetChildIdx(vEBTree::get_children(curr), tree_->fanout_,
-      curr_address, &checker);
+vEBTreeLeafIterator::vEBTreeLeafIterator(vEBTree* tree, 
+  uint64_t leaf_address) : valid_(true), curr_address_(leaf_address), 
+  tree_(tree->impl_.get()), curr_(tree_->LoadNode(leaf_address)) {
+  // climb once to record the path.
+  auto address = leaf_address;
+  const Node* node = curr_;
+  while (node->height != tree_->root_height_) {
+    auto parent_address = node->parent_addr;
+    node = tree_->LoadNode(parent_address);
+    bool checker;
+    auto idx = GetChildIdx(tree_->get_children(node), tree_->fanout_,
+      address, &checker);
     assert(checker);
+    ancestors_.push_back(Ancestor{parent_address, idx});
+    address = parent_address;
   }
+  std::reverse(ancestors_.begin(), ancestors_.end());
+}
 
-  // we are at a node where we have a child in front not visited
-  // go all the way to the right most leaf under this unvisited child
-  auto unvisited_child = vEBTree::get_children(curr) + (idx-1);
-  curr = tree_->GetNode(unvisited_child->addr);
-  while(curr->height != 1) {
-    // move further down
-    auto children = vEBTree::get_children(curr);
-    curr_address = GetRightMostChildAddress(children,
-      tree_->fanout_, &checker);
-    assert(checker);
-    curr = tree_->GetNode(curr_address);
-  }
-  curr_address_ = curr_address;
-  curr_ = curr;
-  curr_parent_address_ = curr_->parent_addr;
-}
-
-void vEBTreeForwardIterator::Next() {
-  if (!valid_) return; // valid_ set false means we are at the last leaf.
-  auto curr_address = curr_parent_address_;
-  auto curr = tree_->GetNode(curr_address);
-  bool checker;
-  auto idx = GetChildIdx(vEBTree::get_children(curr), tree_->fanout_,
-    curr_address, &checker);
-  assert(checker);
-  while (idx == GetRightMostChildAddress(vEBTree::get_children(curr),
-    tree_->fanout_, &checker)) {
-    if(curr->height == tree_->root_height_) {
-      valid_ = false;
-      return;
-    }
-    curr_address = curr->parent_addr;
-    curr = tree_->GetNode(curr_address);
-    idx = GetChildIdx(vEBTree::get_children(curr), tree_->fanout_,
-      curr_address, &checker);
-    assert(checker);
+void vEBTreeLeafIterator::Step(bool forward) {
+  if (!valid_) return;
+  // the nearest ancestor with a child next to the path on that side.
+  auto level = ancestors_.size();
+  const NodeEntry* children = nullptr;
+  while (level > 0) {
+    auto& ancestor = ancestors_[level - 1];
+    children = tree_->get_children(tree_->LoadNode(ancestor.address));
+    if (forward ? ((ancestor.child_idx + 1 < tree_->fanout_) 
+      && (children[ancestor.child_idx + 1].addr != UINT64_MAX))
+      : (ancestor.child_idx > 0)) break;
+    level--;
   }
-
-  // we are at a node where we have a child in next not visited
-  // go all the way to the left most leaf under this unvisited child
-  auto unvisited_child = vEBTree::get_children(curr) + (idx+1);
-  curr = tree_->GetNode(unvisited_child->addr);
-  while(curr->height != 1) {
-    curr_address = vEBTree::get_children(curr)->addr;
-    assert(curr_address != UINT64_MAX);
-    curr = tree_->GetNode(curr_address);
+  // the first or the last leaf, the path is kept.
+  if (level == 0) {
+    valid_ = false;
+    return;
   }
-  curr_address_ = curr_address;
-  curr_ = curr;
-  curr_parent_address_ = curr_->parent_addr;
+  ancestors_.resize(level);
+  auto& ancestor = ancestors_.back();
+  ancestor.child_idx += forward ? 1 : -1;
+  // descend along the leftmost (forward) or the rightmost children.
+  auto address = children[ancestor.child_idx].addr;
+  auto node = tree_->LoadNode(address);
+  while (node->height != 1) {
+    children = tree_->get_children(node);
+    uint64_t idx = 0;
+    if (!forward) {
+      while ((idx + 1 < tree_->fanout_) 
+        && (children[idx + 1].addr != UINT64_MAX)) idx++;
+    }
+    ancestors_.push_back(Ancestor{address, idx});
+    address = children[idx].addr;
+    node = tree_->LoadNode(address);
+  }
+  curr_address_ = address;
+  curr_ = node;
 }
 
 void vEBTree::UpdateLeafKey(uint64_t leaf_address, uint64_t parent_address, uint64_t new_key) {
-  auto curr_address = parent_address;
-  Node* curr;
-  uint64_t idx;
-  do {
-    curr = GetNode(curr_address);
-    bool checker;
-    idx = GetChildIdx(get_children(curr), fanout_, leaf_address, &checker);
-    auto child_entry = get_children(curr) + idx;
-    assert(child_entry->addr = curr_address);
-    child_entry->key = new_key;
-    curr_address = curr->parent_addr;
-  } while (idx==0 && curr->height != root_height_);
+  impl_->UpdateLeafKeys(std::vector<LeafKeyUpdate>{
+    LeafKeyUpdate{leaf_address, parent_address, new_key}});
+}
+
+template <uint64_t kFanout>
+void vEBTreeImpl<kFanout>::UpdateLeafKeys(const std::vector<LeafKeyUpdate>& updates) {
+  // the (child address, key) entries to set in each node of a level. 
+  typedef std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>>
+    LevelUpdates;
+  LevelUpdates level;
+  for (auto& update : updates) {
+    level[update.parent_address].emplace_back(update.leaf_address, 
+      update.new_key);
+  }
+  while (!level.empty()) {
+    LevelUpdates next_level;
+    for (auto& node_updates : level) {
+      auto node = LoadNode(node_updates.first);
+      bool first_key_updated = false;
+      for (auto& entry : node_updates.second) {
+        bool checker;
+        auto idx = GetChildIdx(get_children(node), fanout(), entry.first, 
+          &checker);
+        assert(checker);
+        if ((get_children(node) + idx)->key == entry.second) continue;
+        // only the nodes whose keys change are written.
+        (get_children(GetNode(node_updates.first)) + idx)->key = entry.second;
+        first_key_updated |= (idx == 0);
+      }
+      // the node first key is its separator key in the parent.
+      if (first_key_updated && (node->height != root_height_)) {
+        next_level[node->parent_addr].emplace_back(node_updates.first,
+          get_children(node)->key);
+      }
+    }
+    level.swap(next_level);
+  }
 }
 
-void vEBTree::DebugPrintNode(const Node* node) const {
+void vEBTreeBase::DebugPrintNode(const Node* node) const {
   // print the node header infomation
-  std::cout << " (height " << ((node->height != UINT64_MAX)
+  std::cout << " (height " << ((node->height != kNullHeight)
     ? std::to_string(node->height) : "null"); 
   std::cout << " parent addr: " << ((node->parent_addr != UINT64_MAX)
     ? std::to_string(node->parent_addr) : "null");
@@ -913,7 +1208,7 @@ void vEBTree::DebugPrintNode(const Node* node) const {
   std::cout << ")\n";
 }
 
-void vEBTree::DebugPrintAsPMA() const {
+void vEBTreeBase::DebugPrintAsPMA() const {
   for (uint64_t segment_id = 0; segment_id < pma_.segment_count(); segment_id++) {
     // all segments after this are empty
     auto num_nodes = segment_element_count[segment_id];
@@ -938,10 +1233,10 @@ void vEBTree::DebugPrintAsPMA() const {
   }
 }
 
-void vEBTree::DebugPrintDFS() {
+void vEBTreeBase::DebugPrintDFS() {
   std::stack<uint64_t> dfs_idx_stack;
   dfs_idx_stack.push(0);
-  auto node = GetNode(root_address_);
+  auto node = LoadNode(root_address_);
   auto curr_idx = 0;
   auto curr_address = root_address_;
   std::cout << "PMA address: " << curr_address;
@@ -950,7 +1245,7 @@ void vEBTree::DebugPrintDFS() {
     if ((curr_idx >= fanout_) || (node->height == 1)) {
       curr_address = node->parent_addr;
       if(curr_address == UINT64_MAX) { break; /*root finished*/}
-      node = GetNode(curr_address);
+      node = LoadNode(curr_address);
       curr_idx = dfs_idx_stack.top() + 1;
       dfs_idx_stack.pop();
       if (curr_idx != fanout_) dfs_idx_stack.push(curr_idx);
@@ -961,7 +1256,7 @@ void vEBTree::DebugPrintDFS() {
         dfs_idx_stack.pop();
         continue;
       }
-      node = GetNode(curr_address);
+      node = LoadNode(curr_address);
       auto padding = std::string(dfs_idx_stack.size(), ' ');
       std::cout << padding << "PMA address: " << curr_address;
       DebugPrintNode(node);
@@ -972,4 +1267,41 @@ void vEBTree::DebugPrintDFS() {
   }
 }
 
-}  // namespace cobtree
\ No newline at end of file
+namespace {
+template <typename... Args>
+std::unique_ptr<vEBTreeBase> NewvEBTreeImpl(uint64_t fanout, 
+  Args&&... args) {
+  switch (fanout) {
+    case 4: return std::unique_ptr<vEBTreeBase>(
+      new vEBTreeImpl<4>(std::forward<Args>(args)...));
+    case 8: return std::unique_ptr<vEBTreeBase>(
+      new vEBTreeImpl<8>(std::forward<Args>(args)...));
+    case 16: return std::unique_ptr<vEBTreeBase>(
+      new vEBTreeImpl<16>(std::forward<Args>(args)...));
+    default: return std::unique_ptr<vEBTreeBase>(
+      new vEBTreeImpl<0>(std::forward<Args>(args)...));
+  }
+}
+}  // anonymous namespace
+
+std::unique_ptr<vEBTreeBase> vEBTree::NewImpl(uint64_t fanout, 
+  uint64_t estimated_unit_count, double pma_redundancy_factor, 
+  const std::string& uid, const PMADensityOption& pma_options, 
+  Cache* cache) {
+  return NewvEBTreeImpl(fanout, fanout, estimated_unit_count, 
+    pma_redundancy_factor, uid, pma_options, cache);
+}
+
+std::unique_ptr<vEBTreeBase> vEBTree::NewImpl(const std::string& uid, 
+  const vEBTreeLayout& layout, const PMALayout& pma_layout, char* segments,
+  uint64_t* item_count, uint64_t* element_count, Cache* cache) {
+  return NewvEBTreeImpl(layout.fanout, uid, layout, pma_layout, segments, 
+    item_count, element_count, cache);
+}
+
+template class vEBTreeImpl<0>;
+template class vEBTreeImpl<4>;
+template class vEBTreeImpl<8>;
+template class vEBTreeImpl<16>;
+
+}  // namespace cobtree
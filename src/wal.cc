@@ -0,0 +1,146 @@
+#include "wal.h"
+
+#include <cassert>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cobtree {
+
+namespace {
+
+bool WriteAll(int fd, const char* data, uint64_t len) {
+  while (len > 0) {
+    auto written = ::write(fd, data, len);
+    if (written < 0) return false;
+    data += written;
+    len -= written;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path)
+  : path_(path), fd_(::open(path.c_str(), O_RDWR | O_CREAT, 0644)),
+  next_lsn_(1), durable_lsn_(0), flushing_(false), sync_count_(0) {
+  if (fd_ < 0) return;
+  // continue after the last valid record; drop a torn tail if any.
+  auto records = ReadAll();
+  if (!records.empty()) next_lsn_ = records.back().lsn + 1;
+  durable_lsn_ = next_lsn_ - 1;
+  auto valid_len = records.size() * sizeof(WALRecord);
+  if ((::ftruncate(fd_, valid_len) != 0)
+    || (::lseek(fd_, valid_len, SEEK_SET) < 0)) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  if (fd_ < 0) return;
+  Commit(last_lsn());
+  ::close(fd_);
+}
+
+uint64_t WriteAheadLog::Checksum(const WALRecord& record) {
+  // FNV-1a over the fields except the checksum itself.
+  uint64_t hash = 14695981039346656037ULL;
+  auto bytes = reinterpret_cast<const unsigned char*>(&record);
+  for (uint64_t i = 0; i < offsetof(WALRecord, checksum); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t WriteAheadLog::Append(WALRecordType type, uint64_t key,
+  uint64_t value) {
+  std::lock_guard<std::mutex> lock(mu_);
+  WALRecord record{next_lsn_++, type, key, value, 0};
+  record.checksum = Checksum(record);
+  pending_.push_back(record);
+  return record.lsn;
+}
+
+bool WriteAheadLog::Commit(uint64_t lsn) {
+  if (fd_ < 0) return false;
+  std::unique_lock<std::mutex> lock(mu_);
+  while (durable_lsn_ < lsn) {
+    if (flushing_) {
+      // a leader is writing, our record is in this group or the next.
+      flushed_cv_.wait(lock);
+      continue;
+    }
+    // become the leader and take every record buffered so far.
+    flushing_ = true;
+    std::vector<WALRecord> group;
+    group.swap(pending_);
+    lock.unlock();
+    auto success = WriteAll(fd_, reinterpret_cast<const char*>(group.data()),
+      group.size() * sizeof(WALRecord)) && (::fdatasync(fd_) == 0);
+    lock.lock();
+    flushing_ = false;
+    if (success) {
+      if (!group.empty()) durable_lsn_ = group.back().lsn;
+      sync_count_++;
+    }
+    flushed_cv_.notify_all();
+    if (!success) return false;
+  }
+  return true;
+}
+
+bool WriteAheadLog::Truncate(uint64_t checkpoint_lsn) {
+  if (fd_ < 0) return false;
+  std::unique_lock<std::mutex> lock(mu_);
+  while (flushing_) flushed_cv_.wait(lock);
+  assert(checkpoint_lsn < next_lsn_);
+  // the buffered records are covered by the checkpoint.
+  pending_.clear();
+  WALRecord record{checkpoint_lsn, kWALCheckpoint, 0, 0, 0};
+  record.checksum = Checksum(record);
+  auto success = (::ftruncate(fd_, 0) == 0)
+    && (::lseek(fd_, 0, SEEK_SET) == 0)
+    && WriteAll(fd_, reinterpret_cast<const char*>(&record), sizeof(record))
+    && (::fdatasync(fd_) == 0);
+  if (success) {
+    durable_lsn_ = next_lsn_ - 1;
+    sync_count_++;
+  }
+  flushed_cv_.notify_all();
+  return success;
+}
+
+std::vector<WALRecord> WriteAheadLog::ReadAll() const {
+  std::vector<WALRecord> records;
+  WALRecord record;
+  uint64_t offset = 0;
+  while (::pread(fd_, &record, sizeof(record), offset)
+    == static_cast<ssize_t>(sizeof(record))) {
+    if (record.checksum != Checksum(record)) break; // torn write
+    records.push_back(record);
+    offset += sizeof(record);
+  }
+  return records;
+}
+
+uint64_t WriteAheadLog::Replay(uint64_t from_lsn,
+  const std::function<void(const WALRecord&)>& apply) const {
+  if (fd_ < 0) return 0;
+  auto records = ReadAll();
+  // only the tail after the last checkpoint needs to be replayed.
+  auto start = records.begin();
+  for (auto it = records.begin(); it != records.end(); it++) {
+    if (it->type == kWALCheckpoint) start = it + 1;
+  }
+  uint64_t replayed = 0;
+  for (auto it = start; it != records.end(); it++) {
+    if (it->lsn <= from_lsn) continue;
+    apply(*it);
+    replayed++;
+  }
+  return replayed;
+}
+
+}  // namespace cobtree
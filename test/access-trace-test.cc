@@ -0,0 +1,103 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "access_trace.h"
+#include "cache.h"
+#include "cola.h"
+#include "pma.h"
+
+using namespace cobtree;
+
+int main(){
+  const std::string path{"access-trace-test.trace"};
+
+  std::cout << "--------------record-----------------\n";
+  {
+    AccessTraceWriter trace{path};
+    assert(trace.ok());
+    trace.Record("a", false, 0, 0, 64);
+    trace.Record("b", true, 3, 1ULL << 40, 16);
+    trace.Record("a", false, 1, 300, 1);
+    assert(trace.record_count() == 3);
+  }
+  {
+    std::vector<std::string> devices;
+    std::vector<AccessTraceRecord> records;
+    assert(ReadAccessTrace(path, &devices, &records));
+    assert((devices.size() == 2) && (devices[0] == "a")
+      && (devices[1] == "b"));
+    assert(records.size() == 3);
+    assert((records[1].device == 1) && records[1].write
+      && (records[1].segment_id == 3) && (records[1].offset == 1ULL << 40)
+      && (records[1].len == 16));
+    assert((records[2].device == 0) && !records[2].write
+      && (records[2].offset == 300));
+  }
+  {
+    // a writer that could not open its file drops the records.
+    AccessTraceWriter trace{"no-such-dir/access-trace-test.trace"};
+    assert(!trace.ok());
+    for (uint64_t i = 0; i < 100000; i++) trace.Record("a", false, 0, i, 64);
+    assert(trace.record_count() == 0);
+    assert(!trace.Flush());
+  }
+
+  std::cout << "--------------replay-----------------\n";
+  {
+    // blocks 1 2 3 4 1 2 5 1 2 3 4 5 on a cache of three blocks: the
+    // textbook sequence where fifo gets 9 misses, lru 10 and opt 7.
+    std::vector<AccessTraceRecord> records;
+    for (uint64_t block : {1, 2, 3, 4, 1, 2, 5, 1, 2, 3, 4, 5}) {
+      records.push_back(AccessTraceRecord{0, false, 0, block * 64, 64});
+    }
+    assert(ReplayAccessTrace(records, kReplaceFIFO, 192, 64).miss_count == 9);
+    assert(ReplayAccessTrace(records, kReplaceLRU, 192, 64).miss_count == 10);
+    assert(ReplayAccessTrace(records, kReplaceBelady, 192, 64).miss_count
+      == 7);
+    // larger blocks hold two of them, the three blocks fit.
+    assert(ReplayAccessTrace(records, kReplaceLRU, 384, 128).miss_count == 3);
+
+    // a written block is written back when evicted.
+    records[0].write = true;
+    auto result = ReplayAccessTrace(records, kReplaceFIFO, 192, 64);
+    assert(result.writeback_count == 1);
+  }
+
+  std::cout << "--------------engines-----------------\n";
+  {
+    Cache cache{40*1024};
+    cache.set_block_size_for_stats(4096);
+    {
+      AccessTraceWriter trace{path};
+      cache.set_access_trace(&trace);
+      PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+      PMA pma{"pma", 16, 4096, density, &cache};
+      // a read of one item and an in-place write of it.
+      pma.GetView(5).LoadItem(2);
+      pma.MarkModified(5, 2 * 16, 16);
+      Cola cola{"cola", 1000, &cache};
+      for (uint64_t key = 1; key <= 100; key++) cola.Insert(key, key);
+      cache.set_access_trace(nullptr);
+    }
+    std::vector<std::string> devices;
+    std::vector<AccessTraceRecord> records;
+    assert(ReadAccessTrace(path, &devices, &records));
+    std::cout << records.size() << " accesses\n";
+    assert((devices.size() == 2) && (devices[0] == "pma"));
+    assert(!records[0].write && (records[0].segment_id == 5)
+      && (records[0].len == 16));
+    assert(records[1].write && (records[1].offset == records[0].offset));
+    for (auto policy : {kReplaceFIFO, kReplaceLRU, kReplaceBelady}) {
+      auto result = ReplayAccessTrace(records, policy, 40*1024, 4096);
+      std::cout << "policy " << policy << ": " << result.miss_count
+        << " misses\n";
+      assert(result.miss_count > 0);
+    }
+    // opt is a lower bound of the misses.
+    assert(ReplayAccessTrace(records, kReplaceBelady, 8192, 64).miss_count
+      <= ReplayAccessTrace(records, kReplaceLRU, 8192, 64).miss_count);
+  }
+  std::remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "async_get.h"
+#include "cobtree.h"
+
+using namespace cobtree;
+
+int main(){
+  PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+  // two blocks: the lookups keep missing the cache.
+  Cache cache{3*256};
+  cache.set_block_size_for_stats(256);
+  CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+    density, &cache};
+  for (uint64_t key = 2; key <= 16; key += 2) assert(tree.Insert(key, key*10));
+
+  std::cout << "--------------lookups-----------------\n";
+  {
+    ThreadPoolReadDevice device{4, 200};
+    AsyncGetScheduler scheduler{&tree, &device};
+    const uint64_t lookup_count = 300;
+    std::vector<int> completed(lookup_count, 0);
+    for (uint64_t i = 0; i < lookup_count; i++) {
+      uint64_t expected_value = UINT64_MAX;
+      bool expected = tree.Get(i % 20, &expected_value);
+      scheduler.Submit(i % 20, [&completed, i, expected, expected_value](
+        uint64_t key, bool found, uint64_t value) {
+        assert(key == i % 20);
+        completed[i]++;
+        assert(found == expected);
+        assert(!found || (value == expected_value));
+      });
+    }
+    scheduler.Run();
+    for (auto count : completed) assert(count == 1);
+    std::cout << scheduler.suspend_count() << " suspensions, "
+      << scheduler.max_in_flight() << " reads in flight at most\n";
+    assert(scheduler.suspend_count() > 0);
+    assert(scheduler.max_in_flight() > 1);
+    assert(scheduler.restart_count() == 0);
+  }
+
+  std::cout << "--------------restart-----------------\n";
+  {
+    // a cold cache: both lookups wait at every level, the first to
+    // complete inserts while the other is in flight.
+    cache.AccessRange("cold", 0, 3*256);
+    ThreadPoolReadDevice device{1, 100};
+    AsyncGetScheduler scheduler{&tree, &device};
+    uint64_t completed = 0;
+    for (uint64_t key : {4, 6}) {
+      scheduler.Submit(key, [&](uint64_t key, bool found, uint64_t value) {
+        assert(found && (value == key * 10));
+        if (completed++ == 0) assert(tree.Insert(5, 50));
+      });
+    }
+    scheduler.Run();
+    std::cout << scheduler.restart_count() << " restarts\n";
+    assert(completed == 2);
+    assert(scheduler.restart_count() == 1);
+  }
+
+  std::cout << "--------------restart on flush--------\n";
+  {
+    // the buffered records are merged into level 3 while a lookup waits.
+    tree.EnableInsertBuffer(64);
+    for (uint64_t key : {7, 9, 11}) assert(tree.Insert(key, key*10));
+    cache.AccessRange("cold", 0, 3*256);
+    ThreadPoolReadDevice device{1, 100};
+    AsyncGetScheduler scheduler{&tree, &device};
+    uint64_t completed = 0;
+    for (uint64_t key : {4, 6}) {
+      scheduler.Submit(key, [&](uint64_t key, bool found, uint64_t value) {
+        assert(found && (value == key * 10));
+        if (completed++ == 0) tree.EnableInsertBuffer(0);
+      });
+    }
+    scheduler.Run();
+    std::cout << scheduler.restart_count() << " restarts\n";
+    assert(completed == 2);
+    assert(scheduler.restart_count() == 1);
+    for (uint64_t key : {7, 9, 11}) {
+      uint64_t value;
+      assert(tree.Get(key, &value) && (value == key * 10));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "baseline.h"
+#include "cola.h"
+
+using namespace cobtree;
+
+int main(){
+  // configuration set up
+  uint64_t estimated_record_count = 20000;
+  uint64_t cache_size = 40*1024;
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 1; i <= estimated_record_count / 2; i++) {
+    keys.push_back(i * 2);
+  }
+  std::mt19937_64 rng(7);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  std::vector<std::string> names{"b+-tree", "sorted-array", "eytzinger", 
+    "cola"};
+  for (const auto& name : names) {
+    Cache cache{cache_size};
+    cache.set_block_size_for_stats(4096);
+    std::unique_ptr<Engine> engine;
+    if (name == "b+-tree") {
+      engine.reset(new BPlusTree(name, estimated_record_count, &cache));
+    } else if (name == "sorted-array") {
+      engine.reset(new SortedArray(name, estimated_record_count, &cache));
+    } else if (name == "eytzinger") {
+      engine.reset(new EytzingerArray(name, estimated_record_count, 256, 
+        &cache));
+    } else {
+      engine.reset(new Cola(name, estimated_record_count, &cache));
+    }
+    std::cout << "--------------" << name << "-----------------\n";
+
+    std::map<uint64_t, uint64_t> expected;
+    for (uint64_t i = 0; i < keys.size(); i++) {
+      auto success = engine->Insert(keys[i], keys[i] + 10);
+      assert(success);
+      expected[keys[i]] = keys[i] + 10;
+      // update some earlier records
+      if (i % 5 == 0) {
+        engine->Insert(keys[i/2], keys[i/2] + 20);
+        expected[keys[i/2]] = keys[i/2] + 20;
+      }
+    }
+    std::cout << "insert cost: " 
+      << (double) cache.recorded_block_transfer() / keys.size() << "\n";
+
+    cache.reset_block_transfer_stats();
+    for (const auto& record : expected) {
+      uint64_t ret;
+      auto found = engine->Get(record.first, &ret);
+      assert(found);
+      assert(ret == record.second);
+      assert(!engine->Get(record.first + 1, &ret));
+    }
+    std::cout << "get cost: " 
+      << (double) cache.recorded_block_transfer() / expected.size() / 2 
+      << "\n";
+
+    cache.reset_block_transfer_stats();
+    std::vector<L3Node> records;
+    auto count = engine->Scan(1001, 5001, &records);
+    assert(count == 2000);
+    auto it = expected.lower_bound(1001);
+    for (const auto& record : records) {
+      assert(record.key == it->first);
+      assert(record.value == it->second);
+      it++;
+    }
+    std::cout << "scan cost: " << cache.recorded_block_transfer() << "\n";
+  }
+  return 0;
+}
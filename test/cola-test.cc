@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cola.h"
+
+using namespace cobtree;
+
+int main(){
+  // configuration set up
+  uint64_t estimated_record_count = 100000;
+  const std::string uid{"cola-test"};
+
+  // set up cache
+  uint64_t cache_size = 40*1024;
+  Cache cache{cache_size};
+  cache.set_block_size_for_stats(4096);
+
+  Cola cola{uid, estimated_record_count, &cache};
+
+  std::cout << "--------------insertion-----------------\n";
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 1; i <= estimated_record_count / 2; i++) {
+    keys.push_back(i * 2);
+  }
+  std::mt19937_64 rng(42);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::unordered_map<uint64_t, uint64_t> expected;
+  for (auto k : keys) {
+    auto success = cola.Insert(k, k + 10);
+    assert(success);
+    expected[k] = k + 10;
+  }
+  // updates shadow the older records
+  for (uint64_t i = 0; i < keys.size(); i += 7) {
+    cola.Insert(keys[i], keys[i] + 20);
+    expected[keys[i]] = keys[i] + 20;
+  }
+  std::cout << "insert cost: " << cache.recorded_block_transfer() << "\n";
+  for (uint64_t level = 0; level < cola.level_count(); level++) {
+    std::cout << "level " << level << ": " << cola.level_record_count(level)
+      << " records " << cola.level_size(level) << " entries\n";
+  }
+
+  std::cout << "--------------Get-----------------\n";
+  cache.reset_block_transfer_stats();
+  for (const auto& record : expected) {
+    uint64_t ret;
+    auto found = cola.Get(record.first, &ret);
+    assert(found);
+    assert(ret == record.second);
+    // odd keys are absent
+    assert(!cola.Get(record.first - 1, &ret));
+  }
+  std::cout << "get cost: " << cache.recorded_block_transfer() << "\n";
+
+  std::cout << "--------------updates-----------------\n";
+  {
+    // the updates of one key replace its record instead of filling levels.
+    const uint64_t small_record_count = 100;
+    Cola small{uid + "-small", small_record_count, &cache};
+    for (uint64_t i = 0; i < 10 * small_record_count; i++) {
+      assert(small.Insert(1, i));
+      uint64_t ret;
+      assert(small.Get(1, &ret) && (ret == i));
+    }
+    for (uint64_t level = 0; level < small.level_count(); level++) {
+      assert(small.level_record_count(level) <= 1);
+    }
+    // the distinct keys still fill it up to its capacity.
+    for (uint64_t k = 2; k < 128; k++) assert(small.Insert(k, k));
+    assert(!small.Insert(128, 128));
+    for (uint64_t k = 2; k < 128; k++) {
+      uint64_t ret;
+      assert(small.Get(k, &ret) && (ret == k));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "event_trace.h"
+#include "pma.h"
+
+using namespace cobtree;
+
+int main(){
+  std::cout << "--------------ring buffer-----------------\n";
+  {
+    EventTracer tracer{4};
+    uint64_t args[4] = {0, 0, 0, 0};
+    auto a = tracer.DeviceId("a");
+    auto b = tracer.DeviceId("b");
+    assert((a != b) && (tracer.DeviceId("a") == a));
+    for (uint64_t i = 0; i < 6; i++) {
+      args[0] = i;
+      tracer.Record(kTraceNodeSplit, (i % 2) ? a : b, 100 + i, 1, args);
+    }
+    assert(tracer.recorded_count() == 6);
+    auto events = tracer.Events();
+    // the last four, oldest first.
+    assert(events.size() == 4);
+    for (uint64_t i = 0; i < 4; i++) {
+      assert((events[i].args[0] == i + 2) && (events[i].start_ns == 102 + i));
+    }
+    assert(tracer.device_name(events[0].device) == "b");
+    assert(tracer.device_name(events[1].device) == "a");
+  }
+
+  std::cout << "--------------pma-----------------\n";
+  {
+    Cache cache{1024};
+    cache.set_block_size_for_stats(64);
+    EventTracer tracer{1 << 16};
+    cache.set_event_tracer(&tracer);
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    PMA pma{"pma", 16, 4096, density, &cache};
+    // descending keys all go to the end of the first segment.
+    PMAUpdateContext ctx;
+    for (uint64_t key = 100; key > 60; key--) {
+      uint64_t record[2] = {key, key};
+      assert(pma.Add(reinterpret_cast<const char*>(record), 0,
+        pma.segment_size() - 1, &ctx));
+    }
+    cache.set_event_tracer(nullptr);
+
+    uint64_t count[kTraceEventTypeCount] = {0};
+    for (const auto& event : tracer.Events()) {
+      count[event.type]++;
+      if (event.type == kTracePMARebalanceRange) {
+        assert(tracer.device_name(event.device) == "pma");
+        assert(event.args[0] <= event.args[1]);
+        assert(event.args[3] == event.args[2] * 16);
+      }
+    }
+    std::cout << count[kTracePMARebalance] << " rebalances, "
+      << count[kTraceCacheEvict] << " evictions\n";
+#ifdef COBTREE_EVENT_TRACE
+    assert(count[kTracePMARebalance] > 0);
+    assert(count[kTracePMARebalance] == count[kTracePMARebalanceRange]);
+    assert(count[kTraceCacheEvict] > 0);
+#endif  // COBTREE_EVENT_TRACE
+
+    std::stringstream json;
+    tracer.ExportChromeTrace(&json);
+    auto text = json.str();
+    std::cout << text.substr(0, text.find('\n', text.find('\n') + 1)) << "\n";
+    assert(text.find("{\"traceEvents\":[") == 0);
+    assert(text.rfind("]}\n") == text.size() - 3);
+#ifdef COBTREE_EVENT_TRACE
+    assert(text.find("\"name\":\"rebalance-range\"") != std::string::npos);
+    assert(text.find("\"ph\":\"X\"") != std::string::npos);
+    assert(text.find("\"name\":\"evict\"") != std::string::npos);
+#endif  // COBTREE_EVENT_TRACE
+
+    // another tracer numbers the devices anew.
+    EventTracer other{1 << 16};
+    assert(other.DeviceId("other") == 0);
+    cache.set_event_tracer(&other);
+    for (uint64_t key = 60; key > 20; key--) {
+      uint64_t record[2] = {key, key};
+      assert(pma.Add(reinterpret_cast<const char*>(record), 0,
+        pma.segment_size() - 1, &ctx));
+    }
+    cache.set_event_tracer(nullptr);
+    for (const auto& event : other.Events()) {
+      if (event.type == kTracePMARebalance) {
+        assert(other.device_name(event.device) == "pma");
+      }
+    }
+#ifdef COBTREE_EVENT_TRACE
+    assert(other.recorded_count() > 0);
+#endif  // COBTREE_EVENT_TRACE
+  }
+  return 0;
+}
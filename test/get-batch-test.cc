@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cobtree.h"
+#include "cola.h"
+
+using namespace cobtree;
+
+// GetBatch returns what Get returns, for every key.
+void CheckBatch(Engine* engine, const std::vector<uint64_t>& keys) {
+  std::vector<uint64_t> values(keys.size(), UINT64_MAX);
+  std::unique_ptr<bool[]> found(new bool[keys.size()]);
+  auto found_count = engine->GetBatch(keys.data(), keys.size(), 
+    values.data(), found.get());
+  uint64_t expected_count = 0;
+  for (uint64_t i = 0; i < keys.size(); i++) {
+    uint64_t value;
+    auto expected = engine->Get(keys[i], &value);
+    assert(found[i] == expected);
+    if (expected) {
+      assert(values[i] == value);
+      expected_count++;
+    }
+  }
+  assert(found_count == expected_count);
+}
+
+int main(){
+  std::cout << "--------------cobtree-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    for (uint64_t key = 2; key <= 16; key += 2) assert(tree.Insert(key, key));
+    // more keys than a group, present and absent, repeated and unsorted.
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < 40; key++) keys.push_back((key * 7) % 20);
+    CheckBatch(&tree, keys);
+
+    tree.EnableInsertBuffer(8);
+    assert(tree.Insert(3, 30));
+    assert(tree.Insert(4, 40));
+    CheckBatch(&tree, keys);
+    uint64_t value;
+    bool found;
+    uint64_t key = 4;
+    assert((tree.GetBatch(&key, 1, &value, &found) == 1) && found
+      && (value == 40));
+  }
+
+  std::cout << "--------------default-----------------\n";
+  {
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    Cola cola{"cola", 1000, &cache};
+    for (uint64_t key = 1; key <= 100; key += 3) assert(cola.Insert(key, key));
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < 110; key++) keys.push_back(key);
+    CheckBatch(&cola, keys);
+  }
+  return 0;
+}
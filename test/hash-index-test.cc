@@ -0,0 +1,70 @@
+#include <iostream>
+#include <string>
+#include "cobtree.h"
+
+using namespace cobtree;
+
+int main(){
+  std::cout << "--------------hash index-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{64*256};
+    cache.set_block_size_for_stats(256);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    tree.EnableHashIndex(8);
+    for (uint64_t key = 10; key <= 50; key += 10) {
+      assert(tree.Insert(key, key));
+    }
+    uint64_t value;
+    // the first Get descends and adds the entry, the second uses it.
+    for (uint64_t key = 10; key <= 50; key += 10) {
+      assert(tree.Get(key, &value) && (value == key));
+    }
+    assert(tree.hash_index_hit_count() == 0);
+    for (uint64_t key = 10; key <= 50; key += 10) {
+      assert(tree.Get(key, &value) && (value == key));
+    }
+    assert(tree.hash_index_hit_count() == 5);
+    assert(!tree.Get(11, &value));
+
+    // a hit reads the record's segment only, fewer transfers than the
+    // three levels.
+    cache.AccessRange("cold", 0, 64*256);
+    auto transfers = cache.recorded_block_transfer();
+    assert(tree.Get(30, &value) && (value == 30));
+    auto hit_transfers = cache.recorded_block_transfer() - transfers;
+    assert(tree.hash_index_hit_count() == 6);
+    cache.AccessRange("cold", 0, 64*256);
+    transfers = cache.recorded_block_transfer();
+    assert(tree.Get(35, &value) == false);
+    std::cout << hit_transfers << " transfers for a hit, " 
+      << cache.recorded_block_transfer() - transfers << " for a descent\n";
+    assert(hit_transfers < cache.recorded_block_transfer() - transfers);
+
+    // the records shift as more are inserted: the moved ones are found by
+    // the descent again and their entries refreshed.
+    for (uint64_t key = 15; key <= 55; key += 10) {
+      assert(tree.Insert(key, key));
+    }
+    for (int round = 0; round < 2; round++) {
+      for (uint64_t key = 10; key <= 55; key += 5) {
+        assert(tree.Get(key, &value) && (value == key));
+      }
+    }
+    std::cout << tree.hash_index_hit_count() << " hits "
+      << tree.hash_index_stale_count() << " stale\n";
+    // the capacity bounds the entries: 8 keys hit in the second round.
+    assert(tree.hash_index_hit_count() >= 6 + 8);
+    assert(tree.hash_index_stale_count() > 0);
+    // an update in place keeps the slot.
+    assert(tree.Insert(20, 21));
+    assert(tree.Get(20, &value) && (value == 21));
+
+    tree.EnableHashIndex(0);
+    auto hits = tree.hash_index_hit_count();
+    assert(tree.Get(20, &value) && (value == 21));
+    assert(tree.hash_index_hit_count() == hits);
+  }
+  return 0;
+}
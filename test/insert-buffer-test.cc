@@ -0,0 +1,62 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cobtree.h"
+
+using namespace cobtree;
+
+int main(){
+  // cobtree configuration set up
+  uint64_t veb_fanout = 4;
+  uint64_t estimated_record_count = 1024*1024;
+  double pma_redundancy_factor_l1 = 1.2;
+  double pma_redundancy_factor_l2 = 1.2;
+  double pma_redundancy_factor_l3 = 1.2;
+  PMADensityOption pma_density_l1{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l2{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l3{0.8, 0.6, 0.2, 0.1};
+  const std::string uid{"cobtree"};
+
+  uint64_t cache_size = 1024*1024;
+  Cache cache{cache_size};
+  cache.set_block_size_for_stats(4096);
+  CoBtree tree{veb_fanout, estimated_record_count, pma_redundancy_factor_l1, 
+    pma_redundancy_factor_l2, pma_redundancy_factor_l3, uid, pma_density_l1, 
+    pma_density_l2, pma_density_l3, &cache};
+  tree.EnableInsertBuffer(4);
+
+  std::cout << "--------------insertion-----------------\n";
+  // out of order keys, flushed every 4 records
+  std::vector<uint64_t> keys{9, 3, 14, 1, 12, 6, 2, 11, 5, 13, 8, 4, 7, 10};
+  for (auto k : keys) {
+    auto success = tree.Insert(k, k*10);
+    assert(success);
+  }
+  tree.Insert(3, 300); // update a flushed record in the buffer
+
+  std::cout << "--------------Get-----------------\n";
+  for (uint64_t i = 1; i < 15; i++) {
+    uint64_t ret;
+    auto found = tree.Get(i, &ret);
+    assert(found);
+    assert(ret == ((i == 3) ? 300 : i*10));
+    std::cout << i << " " << ret << "\n";
+  }
+
+  std::cout << "--------------Scan-----------------\n";
+  std::vector<L3Node> records;
+  auto count = tree.Scan(2, 13, &records);
+  assert(count == 12);
+  for (uint64_t i = 0; i < records.size(); i++) {
+    assert(records[i].key == i+2);
+    assert(records[i].value == ((i+2 == 3) ? 300 : (i+2)*10));
+  }
+
+  // flush the remaining buffered records
+  tree.EnableInsertBuffer(0);
+  uint64_t ret;
+  assert(tree.Get(3, &ret) && (ret == 300));
+  assert(tree.Get(10, &ret) && (ret == 100));
+  std::cout << "cost: " << cache.recorded_block_transfer() << "\n";
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cobtree.h"
+#include "latency_stats.h"
+
+using namespace cobtree;
+
+int main(){
+  std::cout << "--------------histogram-----------------\n";
+  {
+    LatencyHistogram histogram;
+    assert((histogram.count() == 0) && (histogram.ValueAtPercentile(50) == 0));
+    for (uint64_t value = 1; value <= 100000; value++) histogram.Record(value);
+    assert(histogram.count() == 100000);
+    assert((histogram.min() == 1) && (histogram.max() == 100000));
+    assert((histogram.mean() > 50000) && (histogram.mean() < 50001));
+    // within the bucket precision of 1/64.
+    for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+      auto expected = percentile * 1000;
+      auto value = histogram.ValueAtPercentile(percentile);
+      std::cout << "p" << percentile << " " << value << "\n";
+      assert((value >= expected) && (value <= expected * (1 + 1.0 / 64)));
+    }
+    assert(histogram.ValueAtPercentile(100) == 100000);
+
+    // small values are exact.
+    LatencyHistogram small;
+    for (uint64_t value = 0; value < 100; value++) small.Record(value);
+    assert(small.ValueAtPercentile(50) == 49);
+    histogram.Merge(small);
+    assert((histogram.count() == 100100) && (histogram.min() == 0));
+    // values past the range are clamped.
+    histogram.Record(UINT64_MAX);
+    assert(histogram.max() < UINT64_MAX);
+    histogram.Reset();
+    assert((histogram.count() == 0) && (histogram.max() == 0));
+  }
+
+  std::cout << "--------------tree-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    assert(tree.latency_stats() == nullptr);
+    tree.EnableLatencyStats();
+    const auto& stats = *tree.latency_stats();
+    for (uint64_t key = 1; key <= 8; key++) assert(tree.Insert(key, key));
+    assert(tree.Insert(3, 30));
+    uint64_t value;
+    assert(tree.Get(3, &value) && (value == 30));
+    assert(!tree.Get(100, &value));
+    std::vector<L3Node> records;
+    assert(tree.Scan(2, 5, &records) == 4);
+
+    assert(stats.histogram(kLatencyInsert, kPathL3Insert).count() == 8);
+    assert(stats.histogram(kLatencyInsert, kPathUpdate).count() == 1);
+    assert(stats.histogram(kLatencyGet, kPathRead).count() == 2);
+    assert(stats.histogram(kLatencyScan, kPathRead).count() == 1);
+    assert(stats.rebalance_histogram(2, 0) == nullptr);
+
+    std::stringstream dump;
+    tree.DumpLatencyStats(&dump);
+    std::cout << dump.str();
+    assert(dump.str().find("insert/l3-insert") != std::string::npos);
+    assert(dump.str().find("insert/update") != std::string::npos);
+    assert(dump.str().find("scan/read") != std::string::npos);
+
+    // the buffered inserts are tagged as such.
+    tree.EnableLatencyStats();
+    tree.EnableInsertBuffer(4);
+    assert(tree.Insert(20, 20));
+    assert(tree.latency_stats()->histogram(kLatencyInsert, kPathBuffered)
+      .count() == 1);
+  }
+  return 0;
+}
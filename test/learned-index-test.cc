@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "cobtree.h"
+#include "learned_index.h"
+
+using namespace cobtree;
+
+namespace {
+
+// the last non-empty segment whose first key is not larger than key.
+bool ExpectedSegment(const std::vector<uint64_t>& first_keys, uint64_t key,
+  uint64_t* segment_id) {
+  bool found = false;
+  for (uint64_t s = 0; s < first_keys.size(); s++) {
+    if ((first_keys[s] != UINT64_MAX) && (first_keys[s] <= key)) {
+      *segment_id = s;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void CheckAll(LearnedSegmentIndex* index,
+  const std::vector<uint64_t>& first_keys, uint64_t max_key) {
+  std::mt19937_64 rng(7);
+  for (int i = 0; i < 2000; i++) {
+    auto key = rng() % max_key;
+    uint64_t expected;
+    uint64_t segment_id;
+    auto found = ExpectedSegment(first_keys, key, &expected);
+    // a hit is always right, misses are left to the vEB tree.
+    if (index->Find(key, &segment_id)) {
+      assert(found);
+      assert(segment_id == expected);
+    }
+  }
+}
+
+// the first keys of the level 2 segments, UINT64_MAX if empty.
+std::vector<uint64_t> FirstKeys(const PMA& level2) {
+  std::vector<uint64_t> first_keys(level2.segment_count(), UINT64_MAX);
+  for (uint64_t s = 0; s < level2.segment_count(); s++) {
+    auto segment = level2.Get(s);
+    if (segment.num_item == 0) continue;
+    first_keys[s] = reinterpret_cast<const L2Node*>(segment.content
+      + segment.len - sizeof(L2Node))->key;
+  }
+  return first_keys;
+}
+
+// the level 2 segment of key: the one with the largest first key not
+// larger than key (the keys descend with the segment id).
+bool ExpectedLevel2Segment(const std::vector<uint64_t>& first_keys,
+  uint64_t key, uint64_t* segment_id) {
+  bool found = false;
+  for (uint64_t s = 0; s < first_keys.size(); s++) {
+    if ((first_keys[s] == UINT64_MAX) || (first_keys[s] > key)) continue;
+    if (!found || (first_keys[s] > first_keys[*segment_id])) *segment_id = s;
+    found = true;
+  }
+  return found;
+}
+
+// every first key is found in its segment, and the key right before it 
+// not in it.
+void CheckLevel2(LearnedSegmentIndex* index,
+  const std::vector<uint64_t>& first_keys) {
+  for (uint64_t s = 0; s < first_keys.size(); s++) {
+    if (first_keys[s] == UINT64_MAX) continue;
+    uint64_t segment_id;
+    assert(index->FindSegment(first_keys[s], &segment_id));
+    assert(segment_id == s);
+    uint64_t expected;
+    if ((first_keys[s] > 0) 
+      && index->FindSegment(first_keys[s] - 1, &segment_id)) {
+      assert(ExpectedLevel2Segment(first_keys, first_keys[s] - 1, 
+        &expected));
+      assert(segment_id == expected);
+    }
+  }
+}
+
+// the position of key in a level 2 segment, as in pma-test.
+uint64_t Level2Position(const PMA& level2, uint64_t segment_id, 
+  uint64_t key) {
+  auto segment = level2.Get(segment_id);
+  auto item = reinterpret_cast<const L2Node*>(segment.content + segment.len
+    - sizeof(L2Node));
+  auto pos = level2.segment_size() - 1;
+  for (auto n = segment.num_item; (n > 0) && (item->key < key); n--) {
+    item--;
+    pos--;
+  }
+  return pos;
+}
+
+}  // anonymous namespace
+
+int main(){
+  std::cout << "--------------uniform keys-----------------\n";
+  {
+    std::vector<uint64_t> first_keys(1000);
+    for (uint64_t s = 0; s < first_keys.size(); s++) first_keys[s] = s * 100;
+    LearnedSegmentIndex index{first_keys.size(), 2};
+    index.Update(0, first_keys);
+    // one line fits evenly spaced keys.
+    assert(index.model_count() == 1);
+    CheckAll(&index, first_keys, 100 * 1000);
+    assert(index.miss_count() == 0);
+  }
+
+  std::cout << "--------------skewed keys and empty segments-----------------\n";
+  {
+    std::vector<uint64_t> first_keys(2000, UINT64_MAX);
+    std::mt19937_64 rng(3);
+    uint64_t key = 0;
+    for (uint64_t s = 0; s < 1800; s++) {
+      // every tenth segment is left empty.
+      if ((s % 10 == 5)) continue;
+      first_keys[s] = key;
+      key += (s < 900) ? 1 + rng() % 10 : 1000 + rng() % 100000;
+    }
+    LearnedSegmentIndex index{first_keys.size(), 4};
+    index.Update(0, first_keys);
+    std::cout << index.model_count() << " models\n";
+    assert(index.model_count() > 1);
+    assert(index.model_count() < 200);
+    CheckAll(&index, first_keys, key + 1000);
+    assert(index.hit_count() > 0);
+    std::cout << index.hit_count() << " hits " << index.miss_count()
+      << " misses\n";
+
+    // shift the keys of a few segments and empty one.
+    for (uint64_t s = 400; s < 410; s++) {
+      if (first_keys[s] != UINT64_MAX) first_keys[s]++;
+    }
+    first_keys[407] = UINT64_MAX;
+    index.Update(400, std::vector<uint64_t>(first_keys.begin() + 400,
+      first_keys.begin() + 410));
+    CheckAll(&index, first_keys, key + 1000);
+
+    // grow past the trained segments, then shrink.
+    for (uint64_t s = 1800; s < 1900; s++) first_keys[s] = key + s;
+    index.Update(1800, std::vector<uint64_t>(first_keys.begin() + 1800,
+      first_keys.begin() + 1900));
+    CheckAll(&index, first_keys, key + 3000);
+    uint64_t segment_id;
+    assert(index.Find(key + 1899, &segment_id) && (segment_id == 1899));
+    for (uint64_t s = 1850; s < 1900; s++) first_keys[s] = UINT64_MAX;
+    index.Update(1850, std::vector<uint64_t>(50, UINT64_MAX));
+    CheckAll(&index, first_keys, key + 3000);
+    assert(index.Find(key + 1899, &segment_id) && (segment_id == 1849));
+  }
+
+  std::cout << "--------------level 2 refresh-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    PMA level2{"level2", sizeof(L2Node), 1200, density, &cache};
+    LearnedSegmentIndex index{level2.segment_count(), 2};
+    // an insertion that rebalanced its level 3 segment only.
+    PMAUpdateContext l3_ctx;
+    l3_ctx.updated_segment.emplace_back(0, 1);
+    // the placeholder key 0 first, then the others in random order.
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 10; key < 6000; key += 10) keys.push_back(key);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(5));
+    keys.insert(keys.begin(), 0);
+    uint64_t rebalance_count = 0;
+    for (auto key : keys) {
+      uint64_t segment_id = 0;
+      ExpectedLevel2Segment(FirstKeys(level2), key, &segment_id);
+      L2Node item{key, key};
+      PMAUpdateContext l2_ctx;
+      assert(level2.Add(reinterpret_cast<const char*>(&item), segment_id,
+        Level2Position(level2, segment_id, key), &l2_ctx));
+      if (!l2_ctx.updated_segment.empty()) rebalance_count++;
+      index.Refresh(level2, segment_id, l3_ctx, l2_ctx);
+      CheckLevel2(&index, FirstKeys(level2));
+    }
+    std::cout << rebalance_count << " level 2 rebalances over " 
+      << level2.last_non_empty_segment() + 1 << " segments, "
+      << index.model_count() << " models\n";
+    assert(rebalance_count > 0);
+
+    // a level 3 rebalance over 3 segments without a level 2 rebalance: 
+    // the walk back from the insertion rewrites the first keys of the 2 
+    // level 2 segments before it in place.
+    auto segment_id = level2.last_non_empty_segment() / 2;
+    assert(segment_id >= 2);
+    for (auto s = segment_id - 2; s < segment_id; s++) {
+      auto segment = level2.Get(s);
+      level2.MarkModified(s);
+      reinterpret_cast<L2Node*>(segment.content + segment.len 
+        - sizeof(L2Node))->key++;
+    }
+    l3_ctx.updated_segment.emplace_back(1, 1);
+    l3_ctx.updated_segment.emplace_back(2, 1);
+    index.Refresh(level2, segment_id, l3_ctx, PMAUpdateContext());
+    CheckLevel2(&index, FirstKeys(level2));
+  }
+
+  std::cout << "--------------cobtree-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    assert(tree.learned_index() == nullptr);
+    for (uint64_t key = 1; key <= 5; key++) assert(tree.Insert(key, key));
+    tree.EnableLearnedIndex(1);
+    // the insertions below stay in the trained segments: the index is only
+    // refreshed on a level 3 rebalance (see the level 2 refresh above).
+    for (uint64_t key = 6; key <= 10; key++) assert(tree.Insert(key, key));
+    uint64_t value;
+    for (uint64_t key = 1; key <= 10; key++) {
+      assert(tree.Get(key, &value) && (value == key));
+    }
+    assert(!tree.Get(11, &value));
+    std::cout << tree.learned_index()->hit_count() << " hits "
+      << tree.learned_index()->miss_count() << " misses\n";
+    assert(tree.learned_index()->hit_count() > 0);
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cola.h"
+#include "memory_hierarchy.h"
+#include "pma.h"
+
+using namespace cobtree;
+
+void print_stats(const MemoryHierarchy& hierarchy) {
+  for (uint64_t level = 0; level < hierarchy.level_count(); level++) {
+    std::cout << hierarchy.option(level).name << " ("
+      << hierarchy.option(level).block_size << "B/"
+      << hierarchy.option(level).capacity << "B): "
+      << hierarchy.stats(level).access_count << " accesses, "
+      << hierarchy.stats(level).transfer_count << " transfers\n";
+  }
+}
+
+int main(){
+  std::cout << "--------------parse-----------------\n";
+  std::vector<MemoryLevelOption> options;
+  assert(!MemoryHierarchy::ParseLevels("64", &options));
+  assert(!MemoryHierarchy::ParseLevels("64:32,", &options));
+  assert(!MemoryHierarchy::ParseLevels("a:b", &options));
+  assert(options.empty());
+  assert(MemoryHierarchy::ParseLevels("64:256,256:1024", &options));
+  assert(options.size() == 2);
+  assert((options[1].block_size == 256) && (options[1].capacity == 1024));
+
+  std::cout << "--------------levels-----------------\n";
+  {
+    // four blocks in each level.
+    MemoryHierarchy hierarchy{options};
+    hierarchy.Access("a", 0, 64);
+    assert(hierarchy.stats(0).transfer_count == 1);
+    assert(hierarchy.stats(1).transfer_count == 1);
+    // a hit in the first level does not reach the second.
+    hierarchy.Access("a", 8, 16);
+    assert(hierarchy.stats(0).transfer_count == 1);
+    assert(hierarchy.stats(1).access_count == 1);
+    // a miss in the first level hits the larger block of the second.
+    hierarchy.Access("a", 64, 64);
+    assert(hierarchy.stats(0).transfer_count == 2);
+    assert(hierarchy.stats(1).transfer_count == 1);
+    // the same offset of another device is another block.
+    hierarchy.Access("b", 0, 64);
+    assert(hierarchy.stats(0).transfer_count == 3);
+    assert(hierarchy.stats(1).transfer_count == 2);
+
+    // a sequential scan transfers every block of each level once.
+    hierarchy.ResetStats();
+    hierarchy.Access("c", 0, 4096);
+    print_stats(hierarchy);
+    assert(hierarchy.stats(0).transfer_count == 4096 / 64);
+    assert(hierarchy.stats(1).transfer_count == 4096 / 256);
+  }
+
+  std::cout << "--------------lru-----------------\n";
+  {
+    MemoryHierarchy hierarchy{{MemoryLevelOption{"L1", 64, 256}}};
+    for (uint64_t block : {0, 1, 2, 3, 0, 4}) {
+      hierarchy.Access("a", block * 64, 64);
+    }
+    assert(hierarchy.stats(0).transfer_count == 5);
+    // block 0 was used again, block 1 is the one evicted.
+    hierarchy.Access("a", 0, 64);
+    assert(hierarchy.stats(0).transfer_count == 5);
+    hierarchy.Access("a", 64, 64);
+    assert(hierarchy.stats(0).transfer_count == 6);
+  }
+
+  std::cout << "--------------engines-----------------\n";
+  {
+    assert(MemoryHierarchy::ParseLevels("64:32768,64:1048576,4096:4194304",
+      &options));
+    MemoryHierarchy hierarchy{options};
+    Cache cache{40*1024};
+    cache.set_block_size_for_stats(4096);
+    cache.set_memory_hierarchy(&hierarchy);
+
+    // every pma segment access goes through the hierarchy, also when the
+    // segment is in the cache.
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    PMA pma{"pma", 16, 4096, density, &cache};
+    auto segment_len = pma.segment_size() * 16;
+    pma.Get(0);
+    pma.Get(0);
+    assert(hierarchy.stats(0).access_count == 2 * ((segment_len - 1) / 64 + 1));
+    assert(hierarchy.stats(0).transfer_count == (segment_len - 1) / 64 + 1);
+
+    hierarchy.ResetStats();
+    Cola cola{"cola", 10000, &cache};
+    for (uint64_t key = 1; key <= 5000; key++) {
+      auto success = cola.Insert(key, key);
+      assert(success);
+    }
+    for (uint64_t key = 1; key <= 5000; key++) {
+      uint64_t value;
+      auto found = cola.Get(key, &value);
+      assert(found && (value == key));
+    }
+    print_stats(hierarchy);
+    assert(hierarchy.stats(0).transfer_count > 0);
+    // the larger levels hold every block the smaller ones hold.
+    assert(hierarchy.stats(1).transfer_count
+      <= hierarchy.stats(0).transfer_count);
+    assert(hierarchy.stats(2).transfer_count
+      <= hierarchy.stats(1).transfer_count);
+
+    cache.set_memory_hierarchy(nullptr);
+    hierarchy.ResetStats();
+    pma.Get(1);
+    assert(hierarchy.stats(0).access_count == 0);
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "cobtree.h"
+#include "perf_counters.h"
+
+using namespace cobtree;
+
+int main(){
+  std::cout << "--------------counters-----------------\n";
+  auto group = PerfCounterGroup::ThisThread();
+  assert(group == PerfCounterGroup::ThisThread());
+  // the counters may not be permitted here, the probes still run.
+  std::cout << "hardware counters " << (group->ok() ? "open" : "unavailable")
+    << "\n";
+  {
+    PerfCounts begin;
+    PerfCounts end;
+    assert(group->Read(&begin) == group->ok());
+    volatile uint64_t sum = 0;
+    for (uint64_t i = 0; i < 1000000; i++) sum += i;
+    assert(group->Read(&end) == group->ok());
+    for (int event = 0; event < kPerfEventCount; event++) {
+      std::cout << PerfCounterGroup::EventName(PerfEvent(event)) << " "
+        << end.value[event] - begin.value[event] << "\n";
+    }
+    if (group->available(kPerfInstruction)) {
+      assert(end.value[kPerfInstruction] - begin.value[kPerfInstruction]
+        >= 1000000);
+    } else {
+      assert(end.value[kPerfInstruction] == 0);
+    }
+  }
+
+  std::cout << "--------------probes-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{1024*1024};
+    cache.set_block_size_for_stats(4096);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    PerfProbeStats stats;
+    for (uint64_t key = 1; key <= 4; key++) assert(tree.Insert(key, key));
+    assert(stats.call_count(kProbeCoBtreeInsert) == 0);
+
+    cache.set_perf_stats(&stats);
+    for (uint64_t key = 5; key <= 8; key++) assert(tree.Insert(key, key));
+    uint64_t value;
+    assert(tree.Get(5, &value) && (value == 5));
+    cache.set_perf_stats(nullptr);
+    assert(tree.Get(6, &value));
+
+    assert(stats.call_count(kProbeCoBtreeInsert) == 4);
+    assert(stats.call_count(kProbeCoBtreeGet) == 1);
+    // every tree operation descends the vEB tree once.
+    assert(stats.call_count(kProbeVEBTreeGet) == 5);
+    if (group->available(kPerfInstruction)) {
+      assert(stats.count(kProbeCoBtreeInsert, kPerfInstruction)
+        >= stats.count(kProbeVEBTreeGet, kPerfInstruction));
+    }
+    std::stringstream dump;
+    stats.Dump(&dump);
+    std::cout << dump.str();
+    assert(dump.str().find("cobtree-insert") != std::string::npos);
+    stats.Reset();
+    assert(stats.call_count(kProbeCoBtreeInsert) == 0);
+  }
+  return 0;
+}
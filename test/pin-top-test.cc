@@ -0,0 +1,111 @@
+#include <iostream>
+#include <string>
+#include "cobtree.h"
+#include "vebtree.h"
+
+using namespace cobtree;
+
+int main(){
+  std::cout << "--------------pinned region-----------------\n";
+  {
+    Cache cache{8*256};
+    cache.set_block_size_for_stats(256);
+    cache.AccessRange("dev", 0, 2*256);
+    auto transfers = cache.recorded_block_transfer();
+    cache.ReservePinned(2*256);
+    assert(cache.pinned_capacity() == 2*256);
+    // a block in the FIFO moves to the pinned region, a new one is read.
+    assert(cache.PinBlock("dev", 0));
+    assert(cache.recorded_block_transfer() == transfers);
+    assert(cache.PinBlock("other", 3));
+    assert(cache.recorded_block_transfer() == transfers + 1);
+    assert(cache.PinBlock("dev", 0));
+    assert(!cache.PinBlock("dev", 1));
+    assert(cache.pinned_block_count() == 2);
+    assert(cache.Resident("dev", 0, 256));
+    assert(cache.Resident("other", 3*256, 256));
+
+    // the FIFO churns, the pinned blocks stay.
+    cache.AccessRange("cold", 0, 20*256);
+    assert(cache.Resident("dev", 0, 256));
+    assert(!cache.Resident("dev", 256, 256));
+    assert(cache.Resident("other", 3*256, 256));
+
+    cache.UnpinBlock("dev", 0);
+    assert(!cache.Resident("dev", 0, 256));
+    assert(cache.PinBlock("dev", 1));
+    cache.UnpinDevice("dev");
+    assert(cache.pinned_block_count() == 1);
+    cache.ReservePinned(0);
+    assert(cache.pinned_block_count() == 0);
+    assert(!cache.Resident("other", 3*256, 256));
+  }
+
+  std::cout << "--------------vebtree top-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{16*256};
+    cache.set_block_size_for_stats(256);
+    vEBTree tree{4, 1024, 1.2, "vebtree", density, &cache};
+    const uint64_t node_size = sizeof(Node) + 4 * sizeof(NodeEntry);
+    cache.ReservePinned(4*256);
+    tree.PinTop(true);
+    assert(tree.pinned_levels() >= 1);
+    for (uint64_t key = 1; key < 20; key++) {
+      assert(tree.Insert(key, key));
+      // the root is kept resident as it moves and the tree grows.
+      assert(tree.pinned_levels() >= 1);
+      assert(cache.pinned_block_count() <= 4);
+      cache.AccessRange("cold", 0, 16*256);
+      auto root_offset = tree.root_address() * node_size;
+      assert(cache.Resident("vebtree", root_offset, node_size));
+    }
+    std::cout << tree.pinned_levels() << " levels pinned in "
+      << cache.pinned_block_count() << " blocks, re-evaluated "
+      << tree.repin_count() << " times\n";
+    // only the insertions that moved the root or a pinned node re-pin, and
+    // the blocks kept match a fresh evaluation.
+    assert(tree.repin_count() < 20);
+    auto levels = tree.pinned_levels();
+    auto blocks = cache.pinned_block_count();
+    tree.PinTop(false);
+    tree.PinTop(true);
+    assert(tree.pinned_levels() == levels);
+    assert(cache.pinned_block_count() == blocks);
+    for (uint64_t key = 1; key < 20; key++) {
+      uint64_t pma_address;
+      assert(tree.Get(key, &pma_address) == key);
+    }
+    tree.PinTop(false);
+    assert(tree.pinned_levels() == 0);
+    assert(cache.pinned_block_count() == 0);
+  }
+
+  std::cout << "--------------cobtree-----------------\n";
+  {
+    PMADensityOption density{0.8, 0.6, 0.2, 0.1};
+    Cache cache{64*256};
+    cache.set_block_size_for_stats(256);
+    CoBtree tree{4, 1024*1024, 1.2, 1.2, 1.2, "cobtree", density, density,
+      density, &cache};
+    tree.PinVEBTreeTop(4*256);
+    for (uint64_t key = 1; key <= 8; key++) assert(tree.Insert(key, key));
+    assert(cache.pinned_block_count() > 0);
+    cache.AccessRange("cold", 0, 64*256);
+    // the descent starts in the pinned blocks: fewer transfers than cold.
+    auto transfers = cache.recorded_block_transfer();
+    uint64_t value;
+    assert(tree.Get(5, &value) && (value == 5));
+    auto pinned_transfers = cache.recorded_block_transfer() - transfers;
+    std::cout << pinned_transfers << " transfers with the top pinned\n";
+    tree.PinVEBTreeTop(0);
+    assert(cache.pinned_block_count() == 0);
+    cache.AccessRange("cold", 0, 64*256);
+    transfers = cache.recorded_block_transfer();
+    assert(tree.Get(5, &value) && (value == 5));
+    std::cout << cache.recorded_block_transfer() - transfers
+      << " transfers without\n";
+    assert(pinned_transfers < cache.recorded_block_transfer() - transfers);
+  }
+  return 0;
+}
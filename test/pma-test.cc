@@ -206,6 +206,29 @@ int main(){
       std::cout << value << "\n";
     }
   }
+
+  std::cout << "--------------view-----------------\n";
+  {
+    // count transfers of 64 bytes, four records.
+    Cache cache2{cache_size};
+    cache2.set_block_size_for_stats(64);
+    PMA pma2{uid+"-2", sizeof(Record), 
+      static_cast<uint64_t>(estimated_record_count*pma_redundancy_factor), 
+      pma_density, &cache2};
+    auto segment_blocks = (pma2.segment_bytes() - 1) / 64 + 1;
+    // only the blocks of the loaded items are transferred.
+    auto view = pma2.GetView(0);
+    view.LoadItem(0);
+    assert(cache2.recorded_block_transfer() == 1);
+    view.LoadItem(3);
+    assert(cache2.recorded_block_transfer() == 1);
+    view.Load(4 * sizeof(Record), 5 * sizeof(Record));
+    assert(cache2.recorded_block_transfer() == 3);
+    // the whole segment pays for the blocks not loaded yet.
+    pma2.Get(0);
+    assert(cache2.recorded_block_transfer() == segment_blocks);
+    std::cout << "segment of " << segment_blocks << " blocks\n";
+  }
   
   return 0;
 }
\ No newline at end of file
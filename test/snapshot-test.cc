@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cobtree.h"
+#include "pma.h"
+
+using namespace cobtree;
+
+int main(){
+  // cobtree configuration set up
+  uint64_t veb_fanout = 4;
+  uint64_t estimated_record_count = 1024*1024;
+  double pma_redundancy_factor_l1 = 1.2;
+  double pma_redundancy_factor_l2 = 1.2;
+  double pma_redundancy_factor_l3 = 1.2;
+  PMADensityOption pma_density_l1{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l2{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l3{0.8, 0.6, 0.2, 0.1};
+  const std::string uid{"cobtree"};
+
+  uint64_t cache_size = 1024*1024;
+  Cache cache{cache_size};
+  cache.set_block_size_for_stats(4096);
+
+  std::cout << "--------------copy-on-write rebalance-----------------\n";
+  {
+    PMA pma{"snapshot-pma", sizeof(L3Node), 1024, pma_density_l3, &cache};
+    PMAUpdateContext ctx;
+    // append increasing keys to segment 0 until it rebalances
+    uint64_t key = 0;
+    auto append = [&pma, &ctx, &key]() {
+      L3Node record{key, key};
+      ctx.clear();
+      pma.Add(reinterpret_cast<const char*>(&record), 0, 
+        pma.segment_size() - 1 - pma.Get(0).num_item, &ctx);
+      key++;
+    };
+    for (int i = 0; i < 2; i++) append();
+    auto epoch = pma.PinSnapshot();
+    do {
+      append();
+    } while (ctx.updated_segment.empty());
+    assert(pma.Get(1).num_item > 0);
+    assert(pma.retained_bytes() > 0);
+    // the snapshot still sees the two records in segment 0 only
+    auto segment = pma.GetSnapshotCopy(0, epoch);
+    assert(segment.num_item == 2);
+    auto record = reinterpret_cast<L3Node*>(segment.content.get() 
+      + segment.len) - 1;
+    assert((record[0].key == 0) && (record[-1].key == 1));
+    for (uint64_t i = 1; i < pma.segment_count(); i++) {
+      assert(pma.GetSnapshotCopy(i, epoch).num_item == 0);
+    }
+    pma.ReleaseSnapshot(epoch);
+    assert(pma.retained_bytes() == 0);
+    std::cout << "rebalanced after " << key << " records\n";
+  }
+  CoBtree tree{veb_fanout, estimated_record_count, pma_redundancy_factor_l1, 
+    pma_redundancy_factor_l2, pma_redundancy_factor_l3, uid, pma_density_l1, 
+    pma_density_l2, pma_density_l3, &cache};
+
+  std::cout << "--------------snapshot isolation-----------------\n";
+  for (uint64_t i = 1; i < 8; i++) tree.Insert(i*2, i*10);
+  {
+    auto snapshot = tree.CreateReadSnapshot();
+    // writes after the snapshot: new keys between the old ones and updates
+    for (uint64_t i = 1; i < 6; i++) tree.Insert(i*2+1, i*10+1);
+    tree.Insert(4, 400);
+
+    std::vector<L3Node> records;
+    auto count = tree.Scan(1, UINT64_MAX, &records, snapshot.get());
+    assert(count == 7);
+    for (uint64_t i = 0; i < records.size(); i++) {
+      std::cout << records[i].key << " " << records[i].value << "\n";
+      assert(records[i].key == (i+1)*2);
+      assert(records[i].value == (i+1)*10);
+    }
+
+    // the current view sees every write
+    records.clear();
+    count = tree.Scan(4, 9, &records);
+    assert(count == 6);
+    assert(records.front().key == 4);
+    assert(records.front().value == 400);
+    assert(records.back().key == 9);
+  }
+
+  std::cout << "--------------concurrent writer-----------------\n";
+  {
+    auto snapshot = tree.CreateReadSnapshot();
+    std::vector<L3Node> expected;
+    tree.Scan(0, UINT64_MAX, &expected, snapshot.get());
+    std::thread writer([&tree]() {
+      for (uint64_t i = 1; i < 8; i++) tree.Insert(i*2, i*100);
+    });
+    for (int round = 0; round < 50; round++) {
+      std::vector<L3Node> records;
+      tree.Scan(0, UINT64_MAX, &records, snapshot.get());
+      assert(records.size() == expected.size());
+      for (uint64_t i = 0; i < records.size(); i++) {
+        assert(records[i].key == expected[i].key);
+        assert(records[i].value == expected[i].value);
+      }
+    }
+    writer.join();
+    std::cout << "records in snapshot: " << expected.size() << "\n";
+  }
+  uint64_t ret;
+  assert(tree.Get(14, &ret) && (ret == 700));
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cobtree.h"
+
+using namespace cobtree;
+
+int main(){
+  // cobtree configuration set up
+  uint64_t veb_fanout = 4;
+  uint64_t estimated_record_count = 1024*1024;
+  double pma_redundancy_factor_l1 = 1.2;
+  double pma_redundancy_factor_l2 = 1.2;
+  double pma_redundancy_factor_l3 = 1.2;
+  PMADensityOption pma_density_l1{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l2{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l3{0.8, 0.6, 0.2, 0.1};
+  const std::string uid{"cobtree"};
+
+  // set up cache
+  uint64_t cache_size = 1024*1024;
+  Cache cache{cache_size};
+  cache.set_block_size_for_stats(4096);
+
+  CoBtree tree{veb_fanout, estimated_record_count, pma_redundancy_factor_l1, 
+    pma_redundancy_factor_l2, pma_redundancy_factor_l3, uid, pma_density_l1, 
+    pma_density_l2, pma_density_l3, &cache};
+
+  // a small log such that overwrites force garbage collection.
+  tree.EnableValueLog(16*1024);
+
+  std::cout << "--------------put-----------------\n";
+  uint64_t num_round = 200;
+  for (uint64_t round = 0; round < num_round; round++) {
+    for (uint64_t key = 1; key <= 10; key++) {
+      std::string value(100 + key*10 + round, 'a' + (key+round) % 26);
+      auto success = tree.Put(key, value);
+      if (!success) { 
+        printf("full!\n"); 
+        return 1; 
+      }
+    }
+  }
+  std::cout << "cost: " << cache.recorded_block_transfer() << "\n";
+
+  std::cout << "--------------Get-----------------\n";
+  for (uint64_t key = 1; key <= 10; key++) {
+    std::string value;
+    auto found = tree.Get(key, &value);
+    assert(found);
+    assert(value == std::string(100 + key*10 + num_round - 1, 
+      'a' + (key + num_round - 1) % 26));
+    std::cout << key << " " << value.size() << "\n";
+  }
+
+  std::cout << "--------------placeholder key-----------------\n";
+  {
+    // key 0 is the tree's own placeholder, not a logged value.
+    std::string value;
+    assert(!tree.Get(0, &value));
+    auto garbage = tree.value_log()->garbage_bytes();
+    assert(!tree.Put(0, "zero"));
+    assert(tree.value_log()->garbage_bytes() == garbage);
+    assert(!tree.Get(0, &value));
+  }
+
+  std::cout << "--------------concurrent put and collection-----------------\n";
+  {
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 2; t++) {
+      threads.emplace_back([&tree, t]() {
+        for (uint64_t round = 0; round < 100; round++) {
+          for (uint64_t key = 1; key <= 10; key++) {
+            assert(tree.Put(key, std::string(100 + key, 'a' + t)));
+          }
+        }
+      });
+    }
+    threads.emplace_back([&tree]() {
+      for (int i = 0; i < 100; i++) tree.CollectValueLogGarbage(1024);
+    });
+    for (auto& thread : threads) thread.join();
+    for (uint64_t key = 1; key <= 10; key++) {
+      std::string value;
+      assert(tree.Get(key, &value));
+      assert(value.size() == 100 + key);
+    }
+    // every overwritten value was counted once: a full pass finds all of 
+    // the garbage.
+    tree.CollectValueLogGarbage(tree.value_log()->used_bytes());
+    std::cout << tree.value_log()->garbage_bytes() << " garbage bytes left\n";
+    assert(tree.value_log()->garbage_bytes() == 0);
+  }
+  return 0;
+}
@@ -48,5 +48,104 @@ int main() {
     assert(value != UINT64_MAX);
     std::cout << value << "\n";
   }
+  {
+    // lookups and leaf walks are reads: level 1 is not marked modified.
+    auto version = tree.pma().version();
+    uint64_t pma_address;
+    tree.Get(1, &pma_address);
+    vEBTreeForwardIterator leaf_it(&tree, pma_address);
+    while (leaf_it.valid()) leaf_it.Next();
+    // so is setting a separator key to the value it already has.
+    tree.Get(3, &pma_address);
+    vEBTreeForwardIterator key_it(&tree, pma_address);
+    tree.UpdateLeafKey(pma_address, key_it.parent_address(), 3);
+    assert(tree.pma().version() == version);
+    // an update in place is a write.
+    assert(tree.Insert(5, 5));
+    assert(tree.pma().version() > version);
+  }
+
+  std::cout << "--------------other fanouts-----------------\n";
+  // the instantiated (4, 8, 16) and the runtime (5) fanouts.
+  static_assert(SubtreeNodeCount(4, 2) == 5, "1 + 4");
+  static_assert(SubtreeNodeCount(8, 4) == 585, "1 + 8 + 64 + 512");
+  for (uint64_t fanout : {4, 5, 8, 16}) {
+    Cache other_cache{cache_size};
+    other_cache.set_block_size_for_stats(4096);
+    vEBTree other{fanout, estimated_record_count, pma_redundancy_factor,
+      uid + std::to_string(fanout), pma_density, &other_cache};
+    for (uint64_t i = 1; i < 20; i++) assert(other.Insert(i * 10, i));
+    for (uint64_t i = 1; i < 20; i++) {
+      uint64_t pma_address;
+      bool match_key;
+      assert(other.Get(i * 10, &pma_address, &match_key) == i);
+      assert(match_key);
+      // in between two leaves: the smaller one.
+      assert(other.Get(i * 10 + 5, &pma_address, &match_key) == i);
+      assert(!match_key);
+    }
+
+    // walk the leaves both ways: the dummy leaf (value 0), then 1 to 19.
+    {
+      uint64_t pma_address;
+      other.Get(0, &pma_address);
+      vEBTreeForwardIterator forward_it(&other, pma_address);
+      for (uint64_t i = 0; i < 20; i++) {
+        assert(forward_it.valid());
+        assert(vEBTree::get_children(forward_it.node())->key == i);
+        forward_it.Next();
+      }
+      assert(!forward_it.valid());
+      other.Get(190, &pma_address);
+      vEBTreeBackwardIterator backward_it(&other, pma_address);
+      for (uint64_t i = 20; i > 0; i--) {
+        assert(backward_it.valid());
+        assert(vEBTree::get_children(backward_it.node())->key == i - 1);
+        backward_it.Prev();
+      }
+      assert(!backward_it.valid());
+    }
+
+    // lower every separator key: the first children propagate theirs up.
+    std::vector<LeafKeyUpdate> updates;
+    for (uint64_t i = 19; i >= 1; i--) {
+      uint64_t pma_address;
+      other.Get(i * 10, &pma_address);
+      vEBTreeForwardIterator leaf_it(&other, pma_address);
+      updates.push_back(LeafKeyUpdate{pma_address, leaf_it.parent_address(),
+        i * 10 - 5});
+    }
+    other.UpdateLeafKeys(updates);
+    for (uint64_t i = 1; i < 20; i++) {
+      uint64_t pma_address;
+      bool match_key;
+      assert(other.Get(i * 10 - 5, &pma_address, &match_key) == i);
+      assert(match_key);
+      assert(other.Get(i * 10 - 6, &pma_address, &match_key) == i - 1);
+      assert(!match_key);
+    }
+  }
+
+  std::cout << "--------------node encoding-----------------\n";
+  // a fanout 4 node fits a cache line.
+  assert(sizeof(Node) + FANOUT * sizeof(NodeEntry) == 56);
+  NodeEntry entry;
+  assert(entry.empty());
+  entry.addr = 12345;
+  assert(entry.addr == 12345);
+  entry.addr = UINT64_MAX;
+  assert(entry.addr == UINT64_MAX);
+  // a subtree copy stores addresses as offsets from the copied root. a node
+  // split copies the top part of the new node, whose nodes can sit above 
+  // it: the offset wraps below 0 and must come back unchanged when the 
+  // subtree is inserted at its new address.
+  const uint64_t copied_root = 100;
+  const uint64_t above_root = 103;
+  entry.addr = copied_root - above_root;
+  assert(uint64_t(entry.addr) == copied_root - above_root);
+  assert(200 - entry.addr == 203);
+  Node node;
+  node.parent_addr = copied_root - above_root;
+  assert(200 - node.parent_addr == 203);
   return 0;
 }
\ No newline at end of file
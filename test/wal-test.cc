@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "cobtree.h"
+
+using namespace cobtree;
+
+int main(){
+  // cobtree configuration set up
+  uint64_t veb_fanout = 4;
+  uint64_t estimated_record_count = 1024*1024;
+  double pma_redundancy_factor_l1 = 1.2;
+  double pma_redundancy_factor_l2 = 1.2;
+  double pma_redundancy_factor_l3 = 1.2;
+  PMADensityOption pma_density_l1{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l2{0.8, 0.6, 0.2, 0.1};
+  PMADensityOption pma_density_l3{0.8, 0.6, 0.2, 0.1};
+  const std::string uid{"cobtree"};
+  const std::string wal_path{"wal-test.log"};
+  const std::string image_path{"wal-test.img"};
+  ::unlink(wal_path.c_str());
+
+  uint64_t cache_size = 1024*1024;
+
+  std::cout << "--------------group commit-----------------\n";
+  {
+    WriteAheadLog wal{"wal-test-group.log"};
+    assert(wal.ok());
+    uint64_t num_thread = 8;
+    uint64_t num_commit = 200;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < num_thread; t++) {
+      threads.emplace_back([&wal, t, num_commit]() {
+        for (uint64_t i = 0; i < num_commit; i++) {
+          auto lsn = wal.Append(kWALInsert, t, i);
+          auto success = wal.Commit(lsn);
+          assert(success);
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    std::cout << "commits: " << num_thread * num_commit 
+      << " fsync: " << wal.sync_count() << "\n";
+    assert(wal.last_lsn() == num_thread * num_commit);
+  }
+  ::unlink("wal-test-group.log");
+
+  std::cout << "--------------insertion-----------------\n";
+  {
+    // a fresh cache per tree instance, since both trees use the same uid.
+    Cache cache{cache_size};
+    cache.set_block_size_for_stats(4096);
+    CoBtree tree{veb_fanout, estimated_record_count, pma_redundancy_factor_l1, 
+      pma_redundancy_factor_l2, pma_redundancy_factor_l3, uid, pma_density_l1, 
+      pma_density_l2, pma_density_l3, &cache};
+    WriteAheadLog wal{wal_path};
+    assert(wal.ok());
+    tree.AttachWriteAheadLog(&wal, image_path, 0);
+    for (uint64_t i = 1; i < 8; i++) tree.Insert(i, i*10);
+    auto success = tree.Checkpoint(image_path);
+    assert(success);
+    // the tail after the checkpoint
+    for (uint64_t i = 8; i < 12; i++) tree.Insert(i, i*10);
+    tree.Insert(1, 100);
+  }
+
+  std::cout << "--------------recovery-----------------\n";
+  {
+    // a fresh cache per tree instance, since both trees use the same uid.
+    Cache cache{cache_size};
+    cache.set_block_size_for_stats(4096);
+    auto tree = CoBtree::Open(image_path, uid, &cache);
+    assert(tree);
+    WriteAheadLog wal{wal_path};
+    assert(wal.ok());
+    tree->AttachWriteAheadLog(&wal, image_path, 0);
+    auto replayed = tree->Recover();
+    // the four inserts and the update after the checkpoint
+    assert(replayed == 5);
+    for (uint64_t i = 1; i < 12; i++) {
+      uint64_t ret;
+      auto found = tree->Get(i, &ret);
+      assert(found);
+      assert(ret == ((i == 1) ? 100 : i*10));
+      std::cout << i << " " << ret << "\n";
+    }
+  }
+  ::unlink(wal_path.c_str());
+  ::unlink((image_path + ".0").c_str());
+  ::unlink((image_path + ".1").c_str());
+
+  std::cout << "--------------checkpoint over an old snapshot-----------------\n";
+  {
+    const std::string reuse_path{"wal-test-reuse.img"};
+    {
+      Cache cache{cache_size};
+      cache.set_block_size_for_stats(4096);
+      CoBtree tree{veb_fanout, estimated_record_count, 
+        pma_redundancy_factor_l1, pma_redundancy_factor_l2, 
+        pma_redundancy_factor_l3, uid, pma_density_l1, pma_density_l2, 
+        pma_density_l3, &cache};
+      assert(tree.Insert(2, 20));
+      for (uint64_t value = 100; value <= 102; value++) {
+        assert(tree.Insert(1, value));
+        assert(tree.Checkpoint(reuse_path));
+      }
+    }
+    {
+      // a new tree writes its first checkpoint over both slots' files.
+      Cache cache{cache_size};
+      cache.set_block_size_for_stats(4096);
+      CoBtree tree{veb_fanout, estimated_record_count, 
+        pma_redundancy_factor_l1, pma_redundancy_factor_l2, 
+        pma_redundancy_factor_l3, uid, pma_density_l1, pma_density_l2, 
+        pma_density_l3, &cache};
+      assert(tree.Insert(1, 999));
+      assert(tree.Checkpoint(reuse_path));
+    }
+    {
+      Cache cache{cache_size};
+      cache.set_block_size_for_stats(4096);
+      auto tree = CoBtree::Open(reuse_path, uid, &cache);
+      assert(tree);
+      uint64_t ret;
+      assert(tree->Get(1, &ret) && (ret == 999));
+      assert(!tree->Get(2, &ret));
+    }
+    ::unlink((reuse_path + ".0").c_str());
+    ::unlink((reuse_path + ".1").c_str());
+  }
+  return 0;
+}